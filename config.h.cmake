@@ -9,7 +9,10 @@
 #cmakedefine HAVE_LIBEXECINFO
 #cmakedefine HAVE_CXXABI_H
 #cmakedefine HAVE_NICE
+#cmakedefine HAVE_POSIX_SPAWN
+#cmakedefine HAVE_EPOLL
 #cmakedefine HAVE_EDITLINE
+#cmakedefine HAVE_ZLIB
 
 #cmakedefine ICINGA2_UNITY_BUILD
 
@@ -20,6 +20,7 @@
 #include "cli/clicommand.hpp"
 #include "config/configcompilercontext.hpp"
 #include "config/configcompiler.hpp"
+#include "config/configcache.hpp"
 #include "config/configitembuilder.hpp"
 #include "base/application.hpp"
 #include "base/logger.hpp"
@@ -259,6 +260,18 @@ int Main(void)
 		}
 	}
 
+	/* Only evaluated once at startup, i.e. this can only be set using -D. */
+	Value use_workstealing = ScriptGlobal::Get("UseWorkStealing", &Empty);
+
+	if (!use_workstealing.IsEmpty() && static_cast<bool>(use_workstealing))
+		Application::GetTP().SetWorkStealing(true);
+
+	/* Like UseWorkStealing this can only be set using -D. */
+	Value use_configcache = ScriptGlobal::Get("UseConfigCache", &Empty);
+
+	if (!use_configcache.IsEmpty() && static_cast<bool>(use_configcache))
+		ConfigCache::SetCacheDir(Application::GetLocalStateDir() + "/cache/icinga2/config");
+
 	Application::DeclareStatePath(Application::GetLocalStateDir() + "/lib/icinga2/icinga2.state");
 	Application::DeclareObjectsPath(Application::GetLocalStateDir() + "/cache/icinga2/icinga2.debug");
 	Application::DeclareVarsPath(Application::GetLocalStateDir() + "/cache/icinga2/icinga2.vars");
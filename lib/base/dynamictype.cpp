@@ -125,6 +125,25 @@ DynamicObject::Ptr DynamicType::GetObject(const String& name) const
 	return nt->second;
 }
 
+/**
+ * Returns all objects whose name starts with the specified prefix.
+ */
+std::vector<DynamicObject::Ptr> DynamicType::GetObjectsByPrefix(const String& prefix) const
+{
+	std::vector<DynamicObject::Ptr> objects;
+
+	ObjectLock olock(this);
+
+	for (DynamicType::ObjectMap::const_iterator it = m_ObjectMap.lower_bound(prefix); it != m_ObjectMap.end(); it++) {
+		if (it->first.SubStr(0, prefix.GetLength()) != prefix)
+			break;
+
+		objects.push_back(it->second);
+	}
+
+	return objects;
+}
+
 boost::mutex& DynamicType::GetStaticMutex(void)
 {
 	static boost::mutex mutex;
@@ -44,6 +44,7 @@ public:
 	static DynamicType::Ptr GetByName(const String& name);
 
 	DynamicObject::Ptr GetObject(const String& name) const;
+	std::vector<DynamicObject::Ptr> GetObjectsByPrefix(const String& prefix) const;
 
 	void RegisterObject(const DynamicObject::Ptr& object);
 
@@ -19,6 +19,7 @@
 
 #include "base/netstring.hpp"
 #include "base/debug.hpp"
+#include "base/convert.hpp"
 #include <sstream>
 
 using namespace icinga;
@@ -109,9 +110,22 @@ StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, Stri
  */
 void NetString::WriteStringToStream(const Stream::Ptr& stream, const String& str)
 {
-	std::ostringstream msgbuf;
-	msgbuf << str.GetLength() << ":" << str << ",";
+	String msg;
+	WriteStringToBuffer(msg, str);
 
-	String msg = msgbuf.str();
 	stream->Write(msg.CStr(), msg.GetLength());
 }
+
+/**
+ * Appends data to a buffer using the netstring format.
+ *
+ * @param buffer The buffer.
+ * @param str The String that is to be written.
+ */
+void NetString::WriteStringToBuffer(String& buffer, const String& str)
+{
+	buffer += Convert::ToString(str.GetLength());
+	buffer += ":";
+	buffer += str;
+	buffer += ",";
+}
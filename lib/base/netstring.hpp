@@ -40,6 +40,7 @@ class I2_BASE_API NetString
 public:
 	static StreamReadStatus ReadStringFromStream(const Stream::Ptr& stream, String *message, StreamReadContext& context, bool may_wait = false);
 	static void WriteStringToStream(const Stream::Ptr& stream, const String& message);
+	static void WriteStringToBuffer(String& buffer, const String& message);
 
 private:
 	NetString(void);
@@ -30,10 +30,19 @@
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/thread/once.hpp>
+#include <set>
 
 #ifndef _WIN32
 #	include <execvpe.h>
 #	include <poll.h>
+#	ifdef HAVE_POSIX_SPAWN
+#		include <spawn.h>
+#	endif /* HAVE_POSIX_SPAWN */
+#	ifdef HAVE_EPOLL
+#		include <sys/epoll.h>
+#		include <sys/timerfd.h>
+#		include <sys/syscall.h>
+#	endif /* HAVE_EPOLL */
 
 #	ifndef __APPLE__
 extern char **environ;
@@ -52,7 +61,13 @@ static std::map<Process::ProcessHandle, Process::Ptr> l_Processes[IOTHREADS];
 #ifdef _WIN32
 static HANDLE l_Events[IOTHREADS];
 #else /* _WIN32 */
+#	ifdef HAVE_EPOLL
+static int l_EpollFDs[IOTHREADS];
+static int l_TimerFDs[IOTHREADS];
+static std::set<std::pair<double, Process::ProcessHandle> > l_Deadlines[IOTHREADS];
+#	else /* HAVE_EPOLL */
 static int l_EventFDs[IOTHREADS][2];
+#	endif /* HAVE_EPOLL */
 static std::map<Process::ConsoleHandle, Process::ProcessHandle> l_FDs[IOTHREADS];
 #endif /* _WIN32 */
 static boost::once_flag l_OnceFlag = BOOST_ONCE_INIT;
@@ -61,13 +76,44 @@ INITIALIZE_ONCE(&Process::StaticInitialize);
 
 Process::Process(const Process::Arguments& arguments, const Dictionary::Ptr& extraEnvironment)
 	: m_Arguments(arguments), m_ExtraEnvironment(extraEnvironment), m_Timeout(600)
-{ }
+{
+#ifdef HAVE_EPOLL
+	m_PidFD = -1;
+#endif /* HAVE_EPOLL */
+}
 
 void Process::StaticInitialize(void)
 {
 	for (int tid = 0; tid < IOTHREADS; tid++) {
 #ifdef _WIN32
 		l_Events[tid] = CreateEvent(NULL, TRUE, FALSE, NULL);
+#elif defined(HAVE_EPOLL)
+		l_EpollFDs[tid] = epoll_create1(EPOLL_CLOEXEC);
+
+		if (l_EpollFDs[tid] < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("epoll_create1")
+			    << boost::errinfo_errno(errno));
+		}
+
+		l_TimerFDs[tid] = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+		if (l_TimerFDs[tid] < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("timerfd_create")
+			    << boost::errinfo_errno(errno));
+		}
+
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = l_TimerFDs[tid];
+
+		if (epoll_ctl(l_EpollFDs[tid], EPOLL_CTL_ADD, l_TimerFDs[tid], &event) < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("epoll_ctl")
+			    << boost::errinfo_errno(errno));
+		}
 #else /* _WIN32 */
 #	ifdef HAVE_PIPE2
 		if (pipe2(l_EventFDs[tid], O_CLOEXEC) < 0) {
@@ -148,6 +194,162 @@ double Process::GetTimeout(void) const
 	return m_Timeout;
 }
 
+#ifdef HAVE_EPOLL
+/**
+ * Arms the IO thread's timerfd for the earliest process deadline.
+ * Must be called with l_ProcessMutex[tid] held.
+ */
+static void ArmDeadlineTimer(int tid)
+{
+	itimerspec its;
+	memset(&its, 0, sizeof(its));
+
+	if (!l_Deadlines[tid].empty()) {
+		double delta = l_Deadlines[tid].begin()->first - Utility::GetTime();
+
+		/* An all-zero it_value would disarm the timer. */
+		if (delta < 0.001)
+			delta = 0.001;
+
+		its.it_value.tv_sec = static_cast<time_t>(delta);
+		its.it_value.tv_nsec = static_cast<long>((delta - its.it_value.tv_sec) * 1000 * 1000 * 1000);
+	}
+
+	if (timerfd_settime(l_TimerFDs[tid], 0, &its, NULL) < 0)
+		Log(LogCritical, "base", "Could not arm timer FD.");
+}
+
+/* Output pipes are registered edge-triggered when the process is started and
+ * stay registered until it has been reaped. Timeouts are handled using a
+ * timerfd which is armed for the earliest deadline. */
+void Process::IOThreadProc(int tid)
+{
+	epoll_event events[128];
+
+	Utility::SetThreadName("ProcessIO");
+
+	for (;;) {
+		int rc = epoll_wait(l_EpollFDs[tid], events, sizeof(events) / sizeof(events[0]), -1);
+
+		if (rc < 0)
+			continue;
+
+		boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+
+		for (int i = 0; i < rc; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == l_TimerFDs[tid]) {
+				uint64_t expirations;
+				if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+					Log(LogCritical, "base", "Read from timer FD failed.");
+
+				continue;
+			}
+
+			std::map<ConsoleHandle, ProcessHandle>::iterator it2 = l_FDs[tid].find(fd);
+
+			if (it2 == l_FDs[tid].end())
+				continue; /* The process was removed earlier in this batch. */
+
+			std::map<ProcessHandle, Process::Ptr>::iterator it = l_Processes[tid].find(it2->second);
+
+			if (it == l_Processes[tid].end())
+				continue; /* This should never happen. */
+
+			Process::Ptr process = it->second;
+
+			if (!process->DoEvents())
+				process->Unregister();
+		}
+
+		double now = Utility::GetTime();
+		std::vector<Process::Ptr> expired;
+
+		typedef std::pair<double, ProcessHandle> kv_pair;
+		BOOST_FOREACH(const kv_pair& kv, l_Deadlines[tid]) {
+			if (kv.first >= now)
+				break;
+
+			std::map<ProcessHandle, Process::Ptr>::iterator it = l_Processes[tid].find(kv.second);
+
+			if (it != l_Processes[tid].end())
+				expired.push_back(it->second);
+		}
+
+		BOOST_FOREACH(const Process::Ptr& process, expired) {
+			if (!process->DoEvents())
+				process->Unregister();
+		}
+
+		ArmDeadlineTimer(tid);
+	}
+}
+
+/**
+ * Removes the process from its IO thread once it has been reaped.
+ * Must be called with l_ProcessMutex[tid] held.
+ */
+void Process::Unregister(void)
+{
+	int tid = GetTID();
+
+	(void)epoll_ctl(l_EpollFDs[tid], EPOLL_CTL_DEL, m_FD, NULL);
+	l_FDs[tid].erase(m_FD);
+	(void)close(m_FD);
+
+	if (m_PidFD != -1) {
+		(void)epoll_ctl(l_EpollFDs[tid], EPOLL_CTL_DEL, m_PidFD, NULL);
+		l_FDs[tid].erase(m_PidFD);
+		(void)close(m_PidFD);
+	}
+
+	if (m_Timeout != 0)
+		l_Deadlines[tid].erase(std::make_pair(m_Result.ExecutionStart + m_Timeout, m_Process));
+
+	/* This may drop the last reference to the process. */
+	l_Processes[tid].erase(m_Process);
+}
+
+/**
+ * Waits for the process to exit using a pidfd rather than blocking the IO
+ * thread in waitpid(). Must be called with l_ProcessMutex[tid] held.
+ *
+ * @returns true if the IO thread is notified once the process has exited.
+ */
+bool Process::WatchExit(void)
+{
+	if (m_PidFD != -1)
+		return true;
+
+#ifdef SYS_pidfd_open
+	int fd = syscall(SYS_pidfd_open, m_Process, 0);
+
+	/* pidfd_open() requires Linux 5.3 or later. */
+	if (fd < 0)
+		return false;
+
+	int tid = GetTID();
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+
+	if (epoll_ctl(l_EpollFDs[tid], EPOLL_CTL_ADD, fd, &event) < 0) {
+		(void)close(fd);
+		return false;
+	}
+
+	m_PidFD = fd;
+	l_FDs[tid][fd] = m_Process;
+
+	return true;
+#else /* SYS_pidfd_open */
+	return false;
+#endif /* SYS_pidfd_open */
+}
+#else /* HAVE_EPOLL */
 void Process::IOThreadProc(int tid)
 {
 #ifdef _WIN32
@@ -280,6 +482,7 @@ void Process::IOThreadProc(int tid)
 		}
 	}
 }
+#endif /* HAVE_EPOLL */
 
 String Process::PrettyPrintArguments(const Process::Arguments& arguments)
 {
@@ -290,6 +493,104 @@ String Process::PrettyPrintArguments(const Process::Arguments& arguments)
 #endif /* _WIN32 */
 }
 
+#ifndef _WIN32
+/**
+ * Starts a child process using fork() or vfork().
+ *
+ * @returns The child's PID, or -1 (with errno set) on failure.
+ */
+static pid_t ForkProcess(char **argv, char **envp, int fds[2])
+{
+	pid_t pid;
+
+#ifdef HAVE_VFORK
+	Value use_vfork = ScriptGlobal::Get("UseVfork");
+
+	if (use_vfork.IsEmpty() || static_cast<bool>(use_vfork))
+		pid = vfork();
+	else
+		pid = fork();
+#else /* HAVE_VFORK */
+	pid = fork();
+#endif /* HAVE_VFORK */
+
+	if (pid == 0) {
+		// child process
+
+		if (setsid() < 0) {
+			perror("setsid() failed");
+			_exit(128);
+		}
+
+		if (dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[1], STDERR_FILENO) < 0) {
+			perror("dup2() failed");
+			_exit(128);
+		}
+
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+
+#ifdef HAVE_NICE
+		if (nice(5) < 0)
+			Log(LogWarning, "base", "Failed to renice child process.");
+#endif /* HAVE_NICE */
+
+		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
+			char errmsg[512];
+			strcpy(errmsg, "execvpe(");
+			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
+			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
+			errmsg[sizeof(errmsg) - 1] = '\0';
+			perror(errmsg);
+			_exit(128);
+		}
+
+		_exit(128);
+	}
+
+	return pid;
+}
+
+#ifdef HAVE_POSIX_SPAWN
+/**
+ * Starts a child process using posix_spawnp(). Unlike fork() this doesn't
+ * have to copy the daemon's page tables, so the cost of starting a plugin
+ * does not depend on the daemon's memory size.
+ *
+ * @returns The child's PID, or -1 (with errno set) on failure.
+ */
+static pid_t SpawnProcess(char **argv, char **envp, int fds[2])
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+
+	/* Put the child into its own process group so that we can kill all
+	 * of its children when the timeout expires. */
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+
+	pid_t pid;
+	int rc = posix_spawnp(&pid, argv[0], &actions, &attr, argv, envp);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (rc != 0) {
+		errno = rc;
+		return -1;
+	}
+
+	return pid;
+}
+#endif /* HAVE_POSIX_SPAWN */
+
+#endif /* _WIN32 */
+
 void Process::Run(const boost::function<void(const ProcessResult&)>& callback)
 {
 	boost::call_once(l_OnceFlag, &Process::ThreadInitialize);
@@ -510,63 +811,19 @@ void Process::Run(const boost::function<void(const ProcessResult&)>& callback)
 
 	m_ExtraEnvironment.reset();
 
-#ifdef HAVE_VFORK
-	Value use_vfork = ScriptGlobal::Get("UseVfork");
+#ifdef HAVE_POSIX_SPAWN
+	Value use_posix_spawn = ScriptGlobal::Get("UsePosixSpawn");
+	bool spawn = !use_posix_spawn.IsEmpty() && static_cast<bool>(use_posix_spawn);
 
-	if (use_vfork.IsEmpty() || static_cast<bool>(use_vfork))
-		m_Process = vfork();
+	if (spawn)
+		m_Process = SpawnProcess(argv, envp, fds);
 	else
-		m_Process = fork();
-#else /* HAVE_VFORK */
-	m_Process = fork();
-#endif /* HAVE_VFORK */
-
-	if (m_Process < 0) {
-		BOOST_THROW_EXCEPTION(posix_error()
-			<< boost::errinfo_api_function("fork")
-			<< boost::errinfo_errno(errno));
-	}
-
-	if (m_Process == 0) {
-		// child process
-
-		if (setsid() < 0) {
-			perror("setsid() failed");
-			_exit(128);
-		}
-
-		if (dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[1], STDERR_FILENO) < 0) {
-			perror("dup2() failed");
-			_exit(128);
-		}
-
-		(void)close(fds[0]);
-		(void)close(fds[1]);
-
-#ifdef HAVE_NICE
-		if (nice(5) < 0)
-			Log(LogWarning, "base", "Failed to renice child process.");
-#endif /* HAVE_NICE */
-
-		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
-			char errmsg[512];
-			strcpy(errmsg, "execvpe(");
-			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
-			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
-			errmsg[sizeof(errmsg) - 1] = '\0';
-			perror(errmsg);
-			_exit(128);
-		}
-
-		_exit(128);
-	}
+#endif /* HAVE_POSIX_SPAWN */
+		m_Process = ForkProcess(argv, envp, fds);
 
 	// parent process
 
-	m_PID = m_Process;
-
-	Log(LogNotice, "Process")
-	    << "Running command " << PrettyPrintArguments(m_Arguments) <<": PID " << m_PID;
+	int error = errno;
 
 	// free arguments
 	for (int i = 0; argv[i] != NULL; i++)
@@ -582,6 +839,35 @@ void Process::Run(const boost::function<void(const ProcessResult&)>& callback)
 
 	(void)close(fds[1]);
 
+	if (m_Process < 0) {
+		(void)close(fds[0]);
+
+#ifdef HAVE_POSIX_SPAWN
+		if (spawn) {
+			/* posix_spawnp() reports exec failures to the parent, treat
+			 * them like a plugin which couldn't be executed. */
+			m_Result.PID = 0;
+			m_Result.ExecutionEnd = Utility::GetTime();
+			m_Result.ExitStatus = 128;
+			m_Result.Output = "Command " + PrettyPrintArguments(m_Arguments) + " failed to execute: " + Utility::FormatErrorNumber(error);
+
+			if (callback)
+				Utility::QueueAsyncCallback(boost::bind(callback, m_Result));
+
+			return;
+		}
+#endif /* HAVE_POSIX_SPAWN */
+
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("fork")
+			<< boost::errinfo_errno(error));
+	}
+
+	m_PID = m_Process;
+
+	Log(LogNotice, "Process")
+	    << "Running command " << PrettyPrintArguments(m_Arguments) <<": PID " << m_PID;
+
 	Utility::SetNonBlocking(fds[0]);
 
 	m_FD = fds[0];
@@ -597,11 +883,32 @@ void Process::Run(const boost::function<void(const ProcessResult&)>& callback)
 #ifndef _WIN32
 		l_FDs[tid][m_FD] = m_Process;
 #endif /* _WIN32 */
+
+#ifdef HAVE_EPOLL
+		if (m_Timeout != 0) {
+			std::pair<double, ProcessHandle> deadline = std::make_pair(m_Result.ExecutionStart + m_Timeout, m_Process);
+			l_Deadlines[tid].insert(deadline);
+
+			if (*l_Deadlines[tid].begin() == deadline)
+				ArmDeadlineTimer(tid);
+		}
+
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN | EPOLLET;
+		event.data.fd = m_FD;
+
+		if (epoll_ctl(l_EpollFDs[tid], EPOLL_CTL_ADD, m_FD, &event) < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+			    << boost::errinfo_api_function("epoll_ctl")
+			    << boost::errinfo_errno(errno));
+		}
+#endif /* HAVE_EPOLL */
 	}
 
 #ifdef _WIN32
 	SetEvent(l_Events[tid]);
-#else /* _WIN32 */
+#elif !defined(HAVE_EPOLL)
 	if (write(l_EventFDs[tid][1], "T", 1) < 0 && errno != EINTR && errno != EAGAIN)
 		Log(LogCritical, "base", "Write to event FD failed.");
 #endif /* _WIN32 */
@@ -669,7 +976,24 @@ bool Process::DoEvents(void)
 	    << "PID " << m_PID << " (" << PrettyPrintArguments(m_Arguments) << ") terminated with exit code " << exitcode;
 #else /* _WIN32 */
 	int status, exitcode;
+#ifdef HAVE_EPOLL
+	pid_t pid = 0;
+
+	/* The process may close its output before it exits. */
+	if (!is_timeout) {
+		pid = waitpid(m_Process, &status, WNOHANG);
+
+		if (pid == 0 && WatchExit())
+			return true;
+	}
+
+	if (pid == 0)
+		pid = waitpid(m_Process, &status, 0);
+
+	if (pid != m_Process) {
+#else /* HAVE_EPOLL */
 	if (waitpid(m_Process, &status, 0) != m_Process) {
+#endif /* HAVE_EPOLL */
 		BOOST_THROW_EXCEPTION(posix_error()
 			<< boost::errinfo_api_function("waitpid")
 			<< boost::errinfo_errno(errno));
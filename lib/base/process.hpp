@@ -92,6 +92,9 @@ private:
 	ProcessHandle m_Process;
 	pid_t m_PID;
 	ConsoleHandle m_FD;
+#ifdef HAVE_EPOLL
+	int m_PidFD;
+#endif /* HAVE_EPOLL */
 
 	std::ostringstream m_OutputStream;
 	boost::function<void (const ProcessResult&)> m_Callback;
@@ -100,6 +103,10 @@ private:
 	static void IOThreadProc(int tid);
 	bool DoEvents(void);
 	int GetTID(void) const;
+#ifdef HAVE_EPOLL
+	bool WatchExit(void);
+	void Unregister(void);
+#endif /* HAVE_EPOLL */
 };
 
 }
@@ -0,0 +1,193 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+
+using namespace icinga;
+
+void SocketEventEngineEpoll::InitializeThread(int tid)
+{
+	m_PollFDs[tid] = epoll_create1(EPOLL_CLOEXEC);
+
+	if (m_PollFDs[tid] < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("epoll_create1")
+		    << boost::errinfo_errno(errno));
+	}
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.data.fd = m_EventFDs[tid][0];
+	event.events = EPOLLIN;
+
+	if (epoll_ctl(m_PollFDs[tid], EPOLL_CTL_ADD, m_EventFDs[tid][0], &event) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("epoll_ctl")
+		    << boost::errinfo_errno(errno));
+	}
+}
+
+int SocketEventEngineEpoll::PollToEpoll(int events)
+{
+	int result = 0;
+
+	if (events & POLLIN)
+		result |= EPOLLIN;
+
+	if (events & POLLOUT)
+		result |= EPOLLOUT;
+
+	return result;
+}
+
+int SocketEventEngineEpoll::EpollToPoll(int events)
+{
+	int result = 0;
+
+	if (events & EPOLLIN)
+		result |= POLLIN;
+
+	if (events & EPOLLOUT)
+		result |= POLLOUT;
+
+	if (events & EPOLLHUP)
+		result |= POLLHUP;
+
+	if (events & EPOLLERR)
+		result |= POLLERR;
+
+	return result;
+}
+
+void SocketEventEngineEpoll::ThreadProc(int tid)
+{
+	Utility::SetThreadName("SocketIO");
+
+	for (;;) {
+		epoll_event pevents[64];
+
+		int ready = epoll_wait(m_PollFDs[tid], pevents, sizeof(pevents) / sizeof(pevents[0]), -1);
+
+		/* Sockets are registered level-triggered, so discarded events are reported again. */
+		if (HandleWakeUp(tid))
+			continue;
+
+		for (int i = 0; i < ready; i++) {
+			if (pevents[i].data.fd == m_EventFDs[tid][0]) {
+				char buffer[512];
+				if (recv(m_EventFDs[tid][0], buffer, sizeof(buffer), 0) < 0)
+					Log(LogCritical, "SocketEvents", "Read from event FD failed.");
+
+				continue;
+			}
+
+			DispatchEvent(tid, pevents[i].data.fd, EpollToPoll(pevents[i].events));
+		}
+	}
+}
+
+void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObject)
+{
+	int tid = se->m_ID % SOCKET_IOTHREADS;
+
+	boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+	VERIFY(se->m_FD != INVALID_SOCKET);
+
+	SocketEventDescriptor desc;
+	desc.Events = 0;
+	desc.EventInterface = se;
+	desc.LifesupportObject = lifesupportObject;
+
+	VERIFY(m_Sockets[tid].find(se->m_FD) == m_Sockets[tid].end());
+
+	m_Sockets[tid][se->m_FD] = desc;
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.data.fd = se->m_FD;
+	event.events = 0;
+
+	if (epoll_ctl(m_PollFDs[tid], EPOLL_CTL_ADD, se->m_FD, &event) < 0) {
+		m_Sockets[tid].erase(se->m_FD);
+
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("epoll_ctl")
+		    << boost::errinfo_errno(errno));
+	}
+}
+
+void SocketEventEngineEpoll::Unregister(SocketEvents *se)
+{
+	int tid = se->m_ID % SOCKET_IOTHREADS;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		if (se->m_FD == INVALID_SOCKET)
+			return;
+
+		m_Sockets[tid].erase(se->m_FD);
+
+		(void) epoll_ctl(m_PollFDs[tid], EPOLL_CTL_DEL, se->m_FD, NULL);
+
+		se->m_FD = INVALID_SOCKET;
+	}
+
+	/* Make sure the I/O thread isn't still dispatching events for this socket. */
+	WakeUpThread(tid, true);
+}
+
+void SocketEventEngineEpoll::ChangeEvents(SocketEvents *se, int events)
+{
+	int tid = se->m_ID % SOCKET_IOTHREADS;
+
+	boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+	if (se->m_FD == INVALID_SOCKET)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
+
+	std::map<SOCKET, SocketEventDescriptor>::iterator it = m_Sockets[tid].find(se->m_FD);
+
+	if (it == m_Sockets[tid].end())
+		return;
+
+	if (it->second.Events == events)
+		return;
+
+	it->second.Events = events;
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.data.fd = se->m_FD;
+	event.events = PollToEpoll(events);
+
+	if (epoll_ctl(m_PollFDs[tid], EPOLL_CTL_MOD, se->m_FD, &event) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("epoll_ctl")
+		    << boost::errinfo_errno(errno));
+	}
+}
+#endif /* HAVE_EPOLL */
+
@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include <boost/foreach.hpp>
+
+using namespace icinga;
+
+void SocketEventEnginePoll::InitializeThread(int tid)
+{
+	SocketEventDescriptor sed;
+	sed.Events = POLLIN;
+
+	m_Sockets[tid][m_EventFDs[tid][0]] = sed;
+}
+
+void SocketEventEnginePoll::ThreadProc(int tid)
+{
+	Utility::SetThreadName("SocketIO");
+
+	for (;;) {
+		pollfd *pfds;
+		int pfdcount;
+
+		typedef std::map<SOCKET, SocketEventDescriptor>::value_type SocketDesc;
+
+		{
+			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+			pfdcount = m_Sockets[tid].size();
+			pfds = new pollfd[pfdcount];
+
+			int i = 0;
+
+			BOOST_FOREACH(const SocketDesc& desc, m_Sockets[tid]) {
+				pfds[i].fd = desc.first;
+				pfds[i].events = desc.second.Events;
+				pfds[i].revents = 0;
+
+				i++;
+			}
+		}
+
+#ifdef _WIN32
+		(void) WSAPoll(pfds, pfdcount, -1);
+#else /* _WIN32 */
+		(void) poll(pfds, pfdcount, -1);
+#endif /* _WIN32 */
+
+		if (HandleWakeUp(tid)) {
+			delete [] pfds;
+			continue;
+		}
+
+		for (int i = 0; i < pfdcount; i++) {
+			if ((pfds[i].revents & (POLLIN | POLLOUT | POLLHUP | POLLERR)) == 0)
+				continue;
+
+			if (pfds[i].fd == m_EventFDs[tid][0]) {
+				char buffer[512];
+				if (recv(m_EventFDs[tid][0], buffer, sizeof(buffer), 0) < 0)
+					Log(LogCritical, "SocketEvents", "Read from event FD failed.");
+
+				continue;
+			}
+
+			DispatchEvent(tid, pfds[i].fd, pfds[i].revents);
+		}
+
+		delete [] pfds;
+	}
+}
+
+void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject)
+{
+	int tid = se->m_ID % SOCKET_IOTHREADS;
+
+	boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+	VERIFY(se->m_FD != INVALID_SOCKET);
+
+	SocketEventDescriptor desc;
+	desc.Events = 0;
+	desc.EventInterface = se;
+	desc.LifesupportObject = lifesupportObject;
+
+	VERIFY(m_Sockets[tid].find(se->m_FD) == m_Sockets[tid].end());
+
+	m_Sockets[tid][se->m_FD] = desc;
+
+	/* There's no need to wake up the I/O thread here. */
+}
+
+void SocketEventEnginePoll::Unregister(SocketEvents *se)
+{
+	int tid = se->m_ID % SOCKET_IOTHREADS;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		if (se->m_FD == INVALID_SOCKET)
+			return;
+
+		m_Sockets[tid].erase(se->m_FD);
+		se->m_FD = INVALID_SOCKET;
+	}
+
+	WakeUpThread(tid, true);
+}
+
+void SocketEventEnginePoll::ChangeEvents(SocketEvents *se, int events)
+{
+	int tid = se->m_ID % SOCKET_IOTHREADS;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		if (se->m_FD == INVALID_SOCKET)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
+
+		std::map<SOCKET, SocketEventDescriptor>::iterator it = m_Sockets[tid].find(se->m_FD);
+
+		if (it == m_Sockets[tid].end())
+			return;
+
+		it->second.Events = events;
+	}
+
+	WakeUpThread(tid);
+}
+
@@ -20,160 +20,139 @@
 #include "base/socketevents.hpp"
 #include "base/exception.hpp"
 #include "base/logger.hpp"
+#include "base/scriptglobal.hpp"
 #include <boost/thread/once.hpp>
-#include <boost/foreach.hpp>
-#include <map>
-
-#ifndef _WIN32
-#	include <poll.h>
-#endif /* _WIN32 */
+#include <boost/bind.hpp>
 
 using namespace icinga;
 
-struct SocketEventDescriptor
-{
-	int Events;
-	SocketEvents *EventInterface;
-	Object *LifesupportObject;
+static boost::once_flag l_SocketIOOnceFlag = BOOST_ONCE_INIT;
+static SocketEventEngine *l_SocketIOEngine;
+static boost::mutex l_SocketIOIDMutex;
 
-	SocketEventDescriptor(void)
-		: Events(0), EventInterface(NULL), LifesupportObject(NULL)
-	{ }
-};
+int SocketEvents::m_NextID = 0;
 
-static boost::thread l_SocketIOThread;
-static boost::once_flag l_SocketIOOnceFlag = BOOST_ONCE_INIT;
-static SOCKET l_SocketIOEventFDs[2];
-static boost::mutex l_SocketIOMutex;
-static boost::condition_variable l_SocketIOCV;
-static bool l_SocketIOFDChanged;
-static std::map<SOCKET, SocketEventDescriptor> l_SocketIOSockets;
+SocketEventEngine::~SocketEventEngine(void)
+{ }
 
-void SocketEvents::InitializeThread(void)
+void SocketEventEngine::Start(void)
 {
-	Socket::SocketPair(l_SocketIOEventFDs);
+	for (int tid = 0; tid < SOCKET_IOTHREADS; tid++) {
+		Socket::SocketPair(m_EventFDs[tid]);
 
-	Utility::SetNonBlockingSocket(l_SocketIOEventFDs[0]);
-	Utility::SetNonBlockingSocket(l_SocketIOEventFDs[1]);
+		Utility::SetNonBlockingSocket(m_EventFDs[tid][0]);
+		Utility::SetNonBlockingSocket(m_EventFDs[tid][1]);
 
 #ifndef _WIN32
-	Utility::SetCloExec(l_SocketIOEventFDs[0]);
-	Utility::SetCloExec(l_SocketIOEventFDs[1]);
+		Utility::SetCloExec(m_EventFDs[tid][0]);
+		Utility::SetCloExec(m_EventFDs[tid][1]);
 #endif /* _WIN32 */
 
-	SocketEventDescriptor sed;
-	sed.Events = POLLIN;
+		m_FDChanged[tid] = false;
 
-	l_SocketIOSockets[l_SocketIOEventFDs[0]] = sed;
+		InitializeThread(tid);
 
-	l_SocketIOThread = boost::thread(&SocketEvents::ThreadProc);
+		m_Threads[tid] = boost::thread(boost::bind(&SocketEventEngine::ThreadProc, this, tid));
+	}
 }
 
-void SocketEvents::ThreadProc(void)
+void SocketEventEngine::WakeUpThread(int sid, bool wait)
 {
-	Utility::SetThreadName("SocketIO");
-
-	for (;;) {
-		pollfd *pfds;
-		int pfdcount;
+	int tid = sid % SOCKET_IOTHREADS;
 
-		typedef std::map<SOCKET, SocketEventDescriptor>::value_type SocketDesc;
-
-		{
-			boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-			pfdcount = l_SocketIOSockets.size();
-			pfds  = new pollfd[pfdcount];
-
-			int i = 0;
-
-			BOOST_FOREACH(const SocketDesc& desc, l_SocketIOSockets) {
-				pfds[i].fd = desc.first;
-				pfds[i].events = desc.second.Events;
-				pfds[i].revents = 0;
-
-				i++;
-			}
-		}
+	if (wait) {
+		if (boost::this_thread::get_id() != m_Threads[tid].get_id()) {
+			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-#ifdef _WIN32
-		(void) WSAPoll(pfds, pfdcount, -1);
-#else /* _WIN32 */
-		(void) poll(pfds, pfdcount, -1);
-#endif /* _WIN32 */
+			m_FDChanged[tid] = true;
 
-		{
-			boost::mutex::scoped_lock lock(l_SocketIOMutex);
+			(void) send(m_EventFDs[tid][1], "T", 1, 0);
 
-			if (l_SocketIOFDChanged) {
-				l_SocketIOFDChanged = false;
-				l_SocketIOCV.notify_all();
-				delete [] pfds;
-				continue;
-			}
+			while (m_FDChanged[tid])
+				m_CV[tid].wait(lock);
 		}
+	} else {
+		(void) send(m_EventFDs[tid][1], "T", 1, 0);
+	}
+}
 
-		for (int i = 0; i < pfdcount; i++) {
-			if ((pfds[i].revents & (POLLIN | POLLOUT | POLLHUP | POLLERR)) == 0)
-				continue;
+/**
+ * Acknowledges a pending WakeUpThread() call which is waiting for the I/O
+ * thread. Events which were returned before the acknowledgement may refer
+ * to sockets which have been unregistered in the meantime and have to be
+ * discarded by the caller.
+ *
+ * @param tid The I/O thread's ID.
+ * @returns true if the caller must discard the current set of events.
+ */
+bool SocketEventEngine::HandleWakeUp(int tid)
+{
+	boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-			if (pfds[i].fd == l_SocketIOEventFDs[0]) {
-				char buffer[512];
-				if (recv(l_SocketIOEventFDs[0], buffer, sizeof(buffer), 0) < 0)
-					Log(LogCritical, "SocketEvents", "Read from event FD failed.");
+	if (!m_FDChanged[tid])
+		return false;
 
-				continue;
-			}
+	m_FDChanged[tid] = false;
+	m_CV[tid].notify_all();
 
-			SocketEventDescriptor desc;
-			Object::Ptr ltref;
+	return true;
+}
 
-			{
-				boost::mutex::scoped_lock lock(l_SocketIOMutex);
+void SocketEventEngine::DispatchEvent(int tid, SOCKET fd, int revents)
+{
+	SocketEventDescriptor desc;
+	Object::Ptr ltref;
 
-				std::map<SOCKET, SocketEventDescriptor>::const_iterator it = l_SocketIOSockets.find(pfds[i].fd);
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-				if (it == l_SocketIOSockets.end())
-					continue;
+		std::map<SOCKET, SocketEventDescriptor>::const_iterator it = m_Sockets[tid].find(fd);
 
-				desc = it->second;
+		if (it == m_Sockets[tid].end())
+			return;
 
-				/* We must hold a ref-counted reference to the event object to keep it alive. */
-				ltref = desc.LifesupportObject;
-				VERIFY(ltref);
-			}
+		desc = it->second;
 
-			try {
-				desc.EventInterface->OnEvent(pfds[i].revents);
-			} catch (const std::exception& ex) {
-				Log(LogCritical, "SocketEvents")
-				    << "Exception thrown in socket I/O handler:\n"
-				    << DiagnosticInformation(ex);
-			} catch (...) {
-				Log(LogCritical, "SocketEvents", "Exception of unknown type thrown in socket I/O handler.");
-			}
-		}
+		/* We must hold a ref-counted reference to the event object to keep it alive. */
+		ltref = desc.LifesupportObject;
+		VERIFY(ltref);
+	}
 
-		delete [] pfds;
+	try {
+		desc.EventInterface->OnEvent(revents);
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "SocketEvents")
+		    << "Exception thrown in socket I/O handler:\n"
+		    << DiagnosticInformation(ex);
+	} catch (...) {
+		Log(LogCritical, "SocketEvents", "Exception of unknown type thrown in socket I/O handler.");
 	}
 }
 
-void SocketEvents::WakeUpThread(bool wait)
+void SocketEvents::InitializeEngine(void)
 {
-	if (wait) {
-		if (boost::this_thread::get_id() != l_SocketIOThread.get_id()) {
-			boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-			l_SocketIOFDChanged = true;
-
-			(void) send(l_SocketIOEventFDs[1], "T", 1, 0);
-
-			while (l_SocketIOFDChanged)
-				l_SocketIOCV.wait(lock);
-		}
-	} else {
-		(void) send(l_SocketIOEventFDs[1], "T", 1, 0);
+	String eventEngine = ScriptGlobal::Get("EventEngine", &Empty);
+
+	if (eventEngine.IsEmpty())
+#ifdef HAVE_EPOLL
+		eventEngine = "epoll";
+#else /* HAVE_EPOLL */
+		eventEngine = "poll";
+#endif /* HAVE_EPOLL */
+
+	if (eventEngine == "poll")
+		l_SocketIOEngine = new SocketEventEnginePoll();
+#ifdef HAVE_EPOLL
+	else if (eventEngine == "epoll")
+		l_SocketIOEngine = new SocketEventEngineEpoll();
+#endif /* HAVE_EPOLL */
+	else {
+		Log(LogWarning, "SocketEvents")
+		    << "Unknown event engine '" << eventEngine << "'. Falling back to 'poll'.";
+		l_SocketIOEngine = new SocketEventEnginePoll();
 	}
+
+	l_SocketIOEngine->Start();
 }
 
 /**
@@ -182,7 +161,13 @@ void SocketEvents::WakeUpThread(bool wait)
 SocketEvents::SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject)
 	: m_FD(socket->GetFD())
 {
-	boost::call_once(l_SocketIOOnceFlag, &SocketEvents::InitializeThread);
+	boost::call_once(l_SocketIOOnceFlag, &SocketEvents::InitializeEngine);
+
+	{
+		boost::mutex::scoped_lock lock(l_SocketIOIDMutex);
+		m_ID = m_NextID;
+		m_NextID = (m_NextID + 1) % SOCKET_IOTHREADS;
+	}
 
 	Register(lifesupportObject);
 }
@@ -194,54 +179,17 @@ SocketEvents::~SocketEvents(void)
 
 void SocketEvents::Register(Object *lifesupportObject)
 {
-	boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-	VERIFY(m_FD != INVALID_SOCKET);
-
-	SocketEventDescriptor desc;
-	desc.Events = 0;
-	desc.EventInterface = this;
-	desc.LifesupportObject = lifesupportObject;
-
-	VERIFY(l_SocketIOSockets.find(m_FD) == l_SocketIOSockets.end());
-
-	l_SocketIOSockets[m_FD] = desc;
-
-	/* There's no need to wake up the I/O thread here. */
+	l_SocketIOEngine->Register(this, lifesupportObject);
 }
 
 void SocketEvents::Unregister(void)
 {
-	{
-		boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-		if (m_FD == INVALID_SOCKET)
-			return;
-
-		l_SocketIOSockets.erase(m_FD);
-		m_FD = INVALID_SOCKET;
-	}
-
-	WakeUpThread(true);
+	l_SocketIOEngine->Unregister(this);
 }
 
 void SocketEvents::ChangeEvents(int events)
 {
-	{
-		boost::mutex::scoped_lock lock(l_SocketIOMutex);
-
-		if (m_FD == INVALID_SOCKET)
-			BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
-
-		std::map<SOCKET, SocketEventDescriptor>::iterator it = l_SocketIOSockets.find(m_FD);
-
-		if (it == l_SocketIOSockets.end())
-			return;
-
-		it->second.Events = events;
-	}
-
-	WakeUpThread();
+	l_SocketIOEngine->ChangeEvents(this, events);
 }
 
 void SocketEvents::OnEvent(int revents)
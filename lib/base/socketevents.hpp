@@ -22,6 +22,14 @@
 
 #include "base/i2-base.hpp"
 #include "base/socket.hpp"
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <map>
+
+#ifndef _WIN32
+#	include <poll.h>
+#endif /* _WIN32 */
 
 namespace icinga
 {
@@ -46,17 +54,106 @@ protected:
 	SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject);
 
 private:
+	int m_ID;
 	SOCKET m_FD;
 
-	static void InitializeThread(void);
-	static void ThreadProc(void);
-
-	static void WakeUpThread(bool wait = false);
+	static int m_NextID;
 
-	int GetPollEvents(void) const;
+	static void InitializeEngine(void);
 
 	void Register(Object *lifesupportObject);
+
+	friend class SocketEventEngine;
+	friend class SocketEventEnginePoll;
+	friend class SocketEventEngineEpoll;
+};
+
+#define SOCKET_IOTHREADS 8
+
+struct SocketEventDescriptor
+{
+	int Events;
+	SocketEvents *EventInterface;
+	Object *LifesupportObject;
+
+	SocketEventDescriptor(void)
+		: Events(0), EventInterface(NULL), LifesupportObject(NULL)
+	{ }
+};
+
+/**
+ * Dispatches socket events to SocketEvents objects. Each socket is pinned
+ * to one of SOCKET_IOTHREADS I/O threads for its whole lifetime.
+ *
+ * @ingroup base
+ */
+class I2_BASE_API SocketEventEngine
+{
+public:
+	virtual ~SocketEventEngine(void);
+
+	void Start(void);
+
+	void WakeUpThread(int sid, bool wait = false);
+
+protected:
+	virtual void InitializeThread(int tid) = 0;
+	virtual void ThreadProc(int tid) = 0;
+	virtual void Register(SocketEvents *se, Object *lifesupportObject) = 0;
+	virtual void Unregister(SocketEvents *se) = 0;
+	virtual void ChangeEvents(SocketEvents *se, int events) = 0;
+
+	bool HandleWakeUp(int tid);
+	void DispatchEvent(int tid, SOCKET fd, int revents);
+
+	boost::thread m_Threads[SOCKET_IOTHREADS];
+	SOCKET m_EventFDs[SOCKET_IOTHREADS][2];
+	bool m_FDChanged[SOCKET_IOTHREADS];
+	boost::mutex m_EventMutex[SOCKET_IOTHREADS];
+	boost::condition_variable m_CV[SOCKET_IOTHREADS];
+	std::map<SOCKET, SocketEventDescriptor> m_Sockets[SOCKET_IOTHREADS];
+
+	friend class SocketEvents;
+};
+
+/**
+ * poll()-based socket event engine.
+ *
+ * @ingroup base
+ */
+class I2_BASE_API SocketEventEnginePoll : public SocketEventEngine
+{
+protected:
+	virtual void InitializeThread(int tid);
+	virtual void ThreadProc(int tid);
+	virtual void Register(SocketEvents *se, Object *lifesupportObject);
+	virtual void Unregister(SocketEvents *se);
+	virtual void ChangeEvents(SocketEvents *se, int events);
+};
+
+#ifdef HAVE_EPOLL
+/**
+ * epoll-based socket event engine. Interest changes are applied using
+ * epoll_ctl() and do not require waking up the I/O thread.
+ *
+ * @ingroup base
+ */
+class I2_BASE_API SocketEventEngineEpoll : public SocketEventEngine
+{
+protected:
+	virtual void InitializeThread(int tid);
+	virtual void ThreadProc(int tid);
+	virtual void Register(SocketEvents *se, Object *lifesupportObject);
+	virtual void Unregister(SocketEvents *se);
+	virtual void ChangeEvents(SocketEvents *se, int events);
+
+private:
+	SOCKET m_PollFDs[SOCKET_IOTHREADS];
+
+	static int PollToEpoll(int events);
+	static int EpollToPoll(int events);
 };
+#endif /* HAVE_EPOLL */
 
 }
 
@@ -29,9 +29,11 @@
 using namespace icinga;
 
 int ThreadPool::m_NextID = 1;
+boost::thread_specific_ptr<ThreadPool::StealingWorker *> ThreadPool::m_CurrentWorker;
 
 ThreadPool::ThreadPool(size_t max_threads)
-	: m_ID(m_NextID++), m_MaxThreads(max_threads), m_Stopped(false)
+	: m_ID(m_NextID++), m_MaxThreads(max_threads), m_Stopped(false),
+	  m_StealingWorkerCount(0)
 {
 	if (m_MaxThreads != UINT_MAX && m_MaxThreads < sizeof(m_Queues) / sizeof(m_Queues[0]))
 		m_MaxThreads = sizeof(m_Queues) / sizeof(m_Queues[0]);
@@ -49,6 +51,8 @@ void ThreadPool::Start(void)
 	for (size_t i = 0; i < sizeof(m_Queues) / sizeof(m_Queues[0]); i++)
 		m_Queues[i].SpawnWorker(m_ThreadGroup);
 
+	SpawnStealingWorkers();
+
 	m_MgmtThread = boost::thread(boost::bind(&ThreadPool::ManagerThreadProc, this));
 }
 
@@ -69,6 +73,12 @@ void ThreadPool::Stop(void)
 		m_Queues[i].CV.notify_all();
 	}
 
+	for (size_t i = 0; i < m_StealingWorkerCount; i++) {
+		boost::mutex::scoped_lock lock(m_StealingWorkers[i].Mutex);
+		m_StealingWorkers[i].Stopped = true;
+		m_StealingWorkers[i].CV.notify_all();
+	}
+
 	m_ThreadGroup.join_all();
 	m_ThreadGroup.~thread_group();
 	new (&m_ThreadGroup) boost::thread_group();
@@ -76,9 +86,85 @@ void ThreadPool::Stop(void)
 	for (size_t i = 0; i < sizeof(m_Queues) / sizeof(m_Queues[0]); i++)
 		m_Queues[i].Stopped = false;
 
+	for (size_t i = 0; i < m_StealingWorkerCount; i++)
+		m_StealingWorkers[i].Stopped = false;
+
 	m_Stopped = false;
 }
 
+/**
+ * Enables work stealing. New work items are posted to per-worker deques
+ * instead of the shared queues from then on. Work items which are already
+ * queued are still processed.
+ *
+ * The number of stealing workers is fixed once work stealing has been
+ * enabled and it can't be disabled again, which lets Post() check the mode
+ * without taking a lock.
+ *
+ * @param enabled Whether to use work stealing.
+ */
+void ThreadPool::SetWorkStealing(bool enabled)
+{
+	boost::mutex::scoped_lock lock(m_MgmtMutex);
+
+	if (enabled == (m_StealingWorkerCount > 0))
+		return;
+
+	if (!enabled)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Work stealing can't be disabled once it has been enabled."));
+
+	size_t count = Application::GetConcurrency() * 2;
+
+	if (count < QUEUECOUNT)
+		count = QUEUECOUNT;
+
+	if (count > m_MaxThreads)
+		count = m_MaxThreads;
+
+	if (count > MAXSTEALINGWORKERS)
+		count = MAXSTEALINGWORKERS;
+
+	for (size_t i = 0; i < count; i++)
+		m_StealingWorkers[i].Pool = this;
+
+	/* Workers are only started while the pool is running, otherwise
+	 * Start() takes care of that. */
+	if (m_MgmtThread.joinable()) {
+		for (size_t i = 0; i < count; i++)
+			m_ThreadGroup.create_thread(boost::bind(&ThreadPool::StealingWorker::ThreadProc, boost::ref(m_StealingWorkers[i])));
+	}
+
+	m_StealingWorkerCount = count;
+}
+
+bool ThreadPool::GetWorkStealing(void) const
+{
+	return m_StealingWorkerCount > 0;
+}
+
+void ThreadPool::SpawnStealingWorkers(void)
+{
+	for (size_t i = 0; i < m_StealingWorkerCount; i++)
+		m_ThreadGroup.create_thread(boost::bind(&ThreadPool::StealingWorker::ThreadProc, boost::ref(m_StealingWorkers[i])));
+}
+
+/**
+ * Runs a work item and logs any exceptions it throws.
+ */
+void ThreadPool::RunWorkItem(const WorkItem& wi)
+{
+	try {
+		if (wi.Callback)
+			wi.Callback();
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "ThreadPool")
+		    << "Exception thrown in event handler:\n"
+		    << DiagnosticInformation(ex);
+	} catch (...) {
+		Log(LogCritical, "ThreadPool", "Exception of unknown type thrown in event handler.");
+	}
+}
+
 /**
  * Waits for work items and processes them.
  */
@@ -125,16 +211,7 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 #	endif /* RUSAGE_THREAD */
 #endif /* I2_DEBUG */
 
-		try {
-			if (wi.Callback)
-				wi.Callback();
-		} catch (const std::exception& ex) {
-			Log(LogCritical, "ThreadPool")
-			    << "Exception thrown in event handler:\n"
-			    << DiagnosticInformation(ex);
-		} catch (...) {
-			Log(LogCritical, "ThreadPool", "Exception of unknown type thrown in event handler.");
-		}
+		RunWorkItem(wi);
 
 		double et = Utility::GetTime();
 		double latency = st - wi.Timestamp;
@@ -181,6 +258,150 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 	Zombie = false;
 }
 
+/**
+ * Processes work items from the worker's own deque and steals work items
+ * from other workers when the deque is empty.
+ */
+void ThreadPool::StealingWorker::ThreadProc(void)
+{
+	std::ostringstream idbuf;
+	idbuf << "TP #" << Pool->m_ID << " SW #" << (this - Pool->m_StealingWorkers);
+	Utility::SetThreadName(idbuf.str());
+
+	m_CurrentWorker.reset(new StealingWorker *(this));
+
+	/* Idle workers back off exponentially (up to 100ms) before
+	 * trying to steal again unless they're woken up. */
+	int backoff = 1;
+
+	for (;;) {
+		WorkItem wi;
+		bool found = false;
+
+		{
+			boost::mutex::scoped_lock lock(Mutex);
+
+			if (!Items.empty()) {
+				wi = Items.front();
+				Items.pop_front();
+				found = true;
+			} else if (Stopped)
+				break;
+		}
+
+		if (!found)
+			found = Pool->StealWorkItem(*this, wi);
+
+		if (found) {
+			RunWorkItem(wi);
+			backoff = 1;
+			continue;
+		}
+
+		{
+			boost::mutex::scoped_lock lock(Mutex);
+
+			if (!Items.empty() || Stopped)
+				continue;
+
+			Sleeping = true;
+			CV.timed_wait(lock, boost::posix_time::milliseconds(backoff));
+			Sleeping = false;
+		}
+
+		if (backoff < 100)
+			backoff *= 2;
+	}
+}
+
+/**
+ * Tries to steal a work item from another worker, starting with a random victim.
+ *
+ * @param thief The worker which is looking for work.
+ * @param wi Receives the work item.
+ * @returns true if a work item was stolen, false otherwise.
+ */
+bool ThreadPool::StealWorkItem(const StealingWorker& thief, WorkItem& wi)
+{
+	size_t start = Utility::Random() % m_StealingWorkerCount;
+
+	for (size_t i = 0; i < m_StealingWorkerCount; i++) {
+		StealingWorker& victim = m_StealingWorkers[(start + i) % m_StealingWorkerCount];
+
+		if (&victim == &thief)
+			continue;
+
+		boost::mutex::scoped_try_lock lock(victim.Mutex);
+
+		if (!lock || victim.Items.empty())
+			continue;
+
+		wi = victim.Items.back();
+		victim.Items.pop_back();
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Wakes up a random sleeping worker so it can steal work items.
+ */
+void ThreadPool::WakeStealingWorker(const StealingWorker& except, size_t count)
+{
+	for (int i = 0; i < 4; i++) {
+		StealingWorker& worker = m_StealingWorkers[Utility::Random() % count];
+
+		if (&worker == &except)
+			continue;
+
+		boost::mutex::scoped_try_lock lock(worker.Mutex);
+
+		if (lock && worker.Sleeping) {
+			worker.CV.notify_one();
+			break;
+		}
+	}
+}
+
+/**
+ * Appends a work item to the deque of the current worker thread. Work items
+ * posted from other threads are added to a random worker's deque.
+ */
+bool ThreadPool::PostStealing(const WorkItem& wi, size_t count)
+{
+	StealingWorker **pworker = m_CurrentWorker.get();
+	StealingWorker *worker;
+
+	if (pworker && (*pworker)->Pool == this)
+		worker = *pworker;
+	else
+		worker = &m_StealingWorkers[Utility::Random() % count];
+
+	bool busy;
+
+	{
+		boost::mutex::scoped_lock lock(worker->Mutex);
+
+		if (worker->Stopped)
+			return false;
+
+		worker->Items.push_back(wi);
+
+		busy = !worker->Sleeping;
+
+		if (!busy)
+			worker->CV.notify_one();
+	}
+
+	/* The worker is busy; let another worker steal the item. */
+	if (busy)
+		WakeStealingWorker(*worker, count);
+
+	return true;
+}
+
 /**
  * Appends a work item to the work queue. Work items will be processed in FIFO order.
  *
@@ -194,6 +415,14 @@ bool ThreadPool::Post(const ThreadPool::WorkFunction& callback, SchedulerPolicy
 	wi.Callback = callback;
 	wi.Timestamp = Utility::GetTime();
 
+	/* Low-latency work items are usually long-running (e.g. client
+	 * handlers) and would block a stealing worker, so they still go to the
+	 * shared queues which spawn additional threads for them. */
+	size_t stealingWorkers = m_StealingWorkerCount;
+
+	if (stealingWorkers > 0 && policy != LowLatencyScheduler)
+		return PostStealing(wi, stealingWorkers);
+
 	Queue& queue = m_Queues[Utility::Random() % (sizeof(m_Queues) / sizeof(m_Queues[0]))];
 
 	{
@@ -305,6 +534,11 @@ void ThreadPool::ManagerThreadProc(void)
 			total_utilization += utilization;
 		}
 
+		for (size_t i = 0; i < m_StealingWorkerCount; i++) {
+			boost::mutex::scoped_lock lock(m_StealingWorkers[i].Mutex);
+			total_pending += m_StealingWorkers[i].Items.size();
+		}
+
 		double now = Utility::GetTime();
 
 		if (lastStats < now - 15) {
@@ -25,12 +25,14 @@
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
 #include <deque>
 
 namespace icinga
 {
 
 #define QUEUECOUNT 4U
+#define MAXSTEALINGWORKERS 64U
 
 enum SchedulerPolicy
 {
@@ -56,6 +58,9 @@ public:
 
 	bool Post(const WorkFunction& callback, SchedulerPolicy policy = DefaultScheduler);
 
+	void SetWorkStealing(bool enabled);
+	bool GetWorkStealing(void) const;
+
 private:
 	enum ThreadState
 	{
@@ -114,6 +119,30 @@ private:
 		void KillWorker(boost::thread_group& group);
 	};
 
+	/**
+	 * A worker thread with its own work item deque. Work items are posted
+	 * to the deque of the posting worker (or a random worker for external
+	 * threads); idle workers steal items from other workers' deques.
+	 */
+	struct StealingWorker
+	{
+		ThreadPool *Pool;
+
+		boost::mutex Mutex;
+		boost::condition_variable CV;
+
+		std::deque<WorkItem> Items;
+
+		bool Sleeping;
+		bool Stopped;
+
+		StealingWorker(void)
+			: Pool(NULL), Sleeping(false), Stopped(false)
+		{ }
+
+		void ThreadProc(void);
+	};
+
 	int m_ID;
 	static int m_NextID;
 
@@ -128,7 +157,21 @@ private:
 
 	Queue m_Queues[QUEUECOUNT];
 
+	/* The worker count is set once when work stealing is enabled and never
+	 * changes afterwards, so it may be read without holding a lock. */
+	size_t m_StealingWorkerCount;
+	StealingWorker m_StealingWorkers[MAXSTEALINGWORKERS];
+
+	static boost::thread_specific_ptr<StealingWorker *> m_CurrentWorker;
+
 	void ManagerThreadProc(void);
+
+	void SpawnStealingWorkers(void);
+	bool PostStealing(const WorkItem& wi, size_t count);
+	bool StealWorkItem(const StealingWorker& thief, WorkItem& wi);
+	void WakeStealingWorker(const StealingWorker& except, size_t count);
+
+	static void RunWorkItem(const WorkItem& wi);
 };
 
 }
@@ -20,36 +20,372 @@
 #include "base/timer.hpp"
 #include "base/debug.hpp"
 #include "base/utility.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/logger.hpp"
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/key_extractors.hpp>
+#include <algorithm>
+#include <iterator>
 
 using namespace icinga;
 
-typedef boost::multi_index_container<
-	Timer::Holder,
-	boost::multi_index::indexed_by<
-		boost::multi_index::ordered_unique<boost::multi_index::const_mem_fun<Timer::Holder, Timer *, &Timer::Holder::GetObject> >,
-		boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<Timer::Holder, double, &Timer::Holder::GetNextUnlocked> >
-	>
-> TimerSet;
+namespace icinga
+{
+
+/**
+ * Interface for timer scheduling backends. All methods must be called
+ * while holding l_TimerMutex.
+ *
+ * @ingroup base
+ */
+class TimerQueue
+{
+public:
+	virtual ~TimerQueue(void)
+	{ }
+
+	virtual void Insert(Timer *timer) = 0;
+	virtual void Remove(Timer *timer) = 0;
+	virtual bool IsEmpty(void) const = 0;
+
+	/**
+	 * Retrieves the timer which should be called next.
+	 *
+	 * @param now The current time.
+	 * @param next Is set to the time when the returned timer is due or - if
+	 *	       no timer is returned - when the queue should be checked again.
+	 * @returns The timer, or NULL if no timer is due yet.
+	 */
+	virtual Timer *GetNextTimer(double now, double *next) = 0;
+
+	virtual void GetTimers(std::vector<Timer *>& timers) const = 0;
+};
+
+/**
+ * Timer backend which keeps all timers in an ordered set.
+ *
+ * @ingroup base
+ */
+class OrderedTimerQueue : public TimerQueue
+{
+public:
+	virtual void Insert(Timer *timer)
+	{
+		m_Timers.insert(timer);
+	}
+
+	virtual void Remove(Timer *timer)
+	{
+		m_Timers.erase(timer);
+	}
+
+	virtual bool IsEmpty(void) const
+	{
+		return m_Timers.empty();
+	}
+
+	virtual Timer *GetNextTimer(double, double *next)
+	{
+		NextTimerView& idx = boost::get<1>(m_Timers);
+
+		NextTimerView::iterator it = idx.begin();
+
+		*next = it->GetNextUnlocked();
+		return *it;
+	}
+
+	virtual void GetTimers(std::vector<Timer *>& timers) const
+	{
+		BOOST_FOREACH(const Timer::Holder& holder, m_Timers) {
+			timers.push_back(holder.GetObject());
+		}
+	}
+
+private:
+	typedef boost::multi_index_container<
+		Timer::Holder,
+		boost::multi_index::indexed_by<
+			boost::multi_index::ordered_unique<boost::multi_index::const_mem_fun<Timer::Holder, Timer *, &Timer::Holder::GetObject> >,
+			boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<Timer::Holder, double, &Timer::Holder::GetNextUnlocked> >
+		>
+	> TimerSet;
+
+	typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
+
+	TimerSet m_Timers;
+};
+
+/**
+ * Timer backend which uses a hierarchical timing wheel. Inserting and
+ * removing timers takes constant time. Timers are bucketed with a resolution
+ * of 10 milliseconds.
+ *
+ * @ingroup base
+ */
+class TimingWheel : public TimerQueue
+{
+public:
+	TimingWheel(void)
+		: m_CurrentTick(TimeToTick(Utility::GetTime())), m_Count(0)
+	{ }
+
+	virtual void Insert(Timer *timer)
+	{
+		/* Skip ahead if the wheel is empty, there's nothing to advance over. */
+		if (m_Count == 0)
+			m_CurrentTick = TimeToTick(Utility::GetTime());
+
+		AddTimer(timer);
+	}
+
+	virtual void Remove(Timer *timer)
+	{
+		if (!timer->m_Bucket)
+			return;
+
+		timer->m_Bucket->erase(timer->m_BucketIterator);
+		timer->m_Bucket = NULL;
+
+		m_Count--;
+	}
+
+	virtual bool IsEmpty(void) const
+	{
+		return m_Count == 0;
+	}
+
+	virtual Timer *GetNextTimer(double now, double *next)
+	{
+		boost::uint64_t nowTick = TimeToTick(now);
+
+		while (m_Due.empty() && m_CurrentTick <= nowTick)
+			Advance(now);
+
+		if (!m_Due.empty()) {
+			Timer *timer = m_Due.front();
+			*next = timer->m_Next;
+			return timer;
+		}
+
+		/* Find the next non-empty bucket. We need to stop when the first
+		 * level wraps around because that's when the upper levels cascade. */
+		boost::uint64_t tick = m_CurrentTick;
+
+		while ((tick & (FirstLevelSize - 1)) != 0 && m_Buckets[0][tick & (FirstLevelSize - 1)].empty())
+			tick++;
+
+		*next = tick * Resolution;
+		return NULL;
+	}
+
+	virtual void GetTimers(std::vector<Timer *>& timers) const
+	{
+		std::copy(m_Due.begin(), m_Due.end(), std::back_inserter(timers));
+
+		for (int level = 0; level < LevelCount; level++) {
+			for (int i = 0; i < GetLevelSize(level); i++) {
+				const std::list<Timer *>& bucket = m_Buckets[level][i];
+				std::copy(bucket.begin(), bucket.end(), std::back_inserter(timers));
+			}
+		}
+	}
+
+private:
+	static const double Resolution;
+
+	enum {
+		LevelCount = 4,
+		FirstLevelBits = 8,
+		FirstLevelSize = 1 << FirstLevelBits,
+		LevelBits = 6,
+		LevelSize = 1 << LevelBits
+	};
+
+	std::list<Timer *> m_Buckets[LevelCount][FirstLevelSize];
+	std::list<Timer *> m_Due;
+	boost::uint64_t m_CurrentTick;
+	size_t m_Count;
+
+	static inline boost::uint64_t TimeToTick(double ts)
+	{
+		if (ts < 0)
+			return 0;
+
+		return static_cast<boost::uint64_t>(ts / Resolution);
+	}
+
+	static inline int GetLevelSize(int level)
+	{
+		return (level == 0) ? FirstLevelSize : LevelSize;
+	}
+
+	static inline int GetLevelShift(int level)
+	{
+		return (level == 0) ? 0 : FirstLevelBits + (level - 1) * LevelBits;
+	}
+
+	/**
+	 * Determines the bucket for a timer which expires at the specified tick.
+	 * Timers which are too far in the future for the last level are put in
+	 * its furthest bucket and re-sorted when that bucket is cascaded.
+	 */
+	std::list<Timer *> *GetBucket(boost::uint64_t tick)
+	{
+		if (tick < m_CurrentTick)
+			return &m_Due;
+
+		boost::uint64_t delta = tick - m_CurrentTick;
+
+		for (int level = 0; level < LevelCount; level++) {
+			int shift = GetLevelShift(level);
+
+			if (delta < (static_cast<boost::uint64_t>(GetLevelSize(level)) << shift))
+				return &m_Buckets[level][(tick >> shift) & (GetLevelSize(level) - 1)];
+		}
+
+		int shift = GetLevelShift(LevelCount - 1);
+		tick = m_CurrentTick + (static_cast<boost::uint64_t>(LevelSize - 1) << shift);
+		return &m_Buckets[LevelCount - 1][(tick >> shift) & (LevelSize - 1)];
+	}
+
+	void AddTimer(Timer *timer)
+	{
+		ASSERT(!timer->m_Bucket);
+
+		std::list<Timer *> *bucket = GetBucket(TimeToTick(timer->m_Next));
+
+		timer->m_Bucket = bucket;
+		timer->m_BucketIterator = bucket->insert(bucket->end(), timer);
+
+		m_Count++;
+	}
+
+	/**
+	 * Moves all timers from the specified bucket to the lower levels.
+	 *
+	 * @returns The index of the bucket.
+	 */
+	int Cascade(int level)
+	{
+		int index = (m_CurrentTick >> GetLevelShift(level)) & (GetLevelSize(level) - 1);
+
+		std::list<Timer *> timers;
+		timers.swap(m_Buckets[level][index]);
+
+		BOOST_FOREACH(Timer *timer, timers) {
+			timer->m_Bucket = NULL;
+			m_Count--;
+
+			AddTimer(timer);
+		}
+
+		return index;
+	}
+
+	/**
+	 * Processes the bucket for the current tick and moves its timers
+	 * to the list of due timers.
+	 */
+	void Advance(double now)
+	{
+		int index = m_CurrentTick & (FirstLevelSize - 1);
+
+		if (index == 0) {
+			for (int level = 1; level < LevelCount; level++) {
+				if (Cascade(level) != 0)
+					break;
+			}
+		}
+
+		std::list<Timer *> timers;
+		timers.swap(m_Buckets[0][index]);
+
+		m_CurrentTick++;
+
+		BOOST_FOREACH(Timer *timer, timers) {
+			timer->m_Bucket = NULL;
+			m_Count--;
+
+			/* Timers which were clamped to the last level aren't due yet. */
+			if (timer->m_Next > now + Resolution) {
+				AddTimer(timer);
+				continue;
+			}
+
+			timer->m_Bucket = &m_Due;
+			timer->m_BucketIterator = m_Due.insert(m_Due.end(), timer);
+			m_Count++;
+		}
+	}
+};
+
+const double TimingWheel::Resolution = 0.01;
+
+}
 
 static boost::mutex l_TimerMutex;
 static boost::condition_variable l_TimerCV;
 static boost::thread l_TimerThread;
 static bool l_StopTimerThread;
-static TimerSet l_Timers;
+static TimerBackend l_TimerBackend = OrderedTimerBackend;
+static TimerQueue *l_Timers;
+
+static TimerQueue *CreateTimerQueue(TimerBackend backend)
+{
+	if (backend == TimingWheelTimerBackend)
+		return new TimingWheel();
+	else
+		return new OrderedTimerQueue();
+}
+
+/**
+ * Returns the timer queue for the current backend. Must be called
+ * while holding l_TimerMutex.
+ */
+static TimerQueue *GetTimerQueue(void)
+{
+	if (!l_Timers)
+		l_Timers = CreateTimerQueue(l_TimerBackend);
+
+	return l_Timers;
+}
+
+/**
+ * Removes all timers from the current timer queue and replaces it with
+ * an empty queue for the specified backend. Must be called while holding
+ * l_TimerMutex.
+ *
+ * @param backend The backend.
+ * @param timers Receives the timers which were in the old queue.
+ */
+static void ResetTimerQueue(TimerBackend backend, std::vector<Timer *>& timers)
+{
+	TimerQueue *queue = GetTimerQueue();
+
+	queue->GetTimers(timers);
+
+	BOOST_FOREACH(Timer *timer, timers) {
+		queue->Remove(timer);
+	}
+
+	delete queue;
+
+	l_Timers = CreateTimerQueue(backend);
+	l_TimerBackend = backend;
+}
 
 /**
  * Constructor for the Timer class.
  */
 Timer::Timer(void)
-	: m_Interval(0), m_Next(0), m_Started(false), m_Running(false)
+	: m_Interval(0), m_Next(0), m_Started(false), m_Running(false), m_Bucket(NULL)
 { }
 
 /**
@@ -65,6 +401,16 @@ Timer::~Timer(void)
  */
 void Timer::Initialize(void)
 {
+	String backend = ScriptGlobal::Get("TimerBackend", &Empty);
+
+	if (backend == "wheel")
+		SetBackend(TimingWheelTimerBackend);
+	else if (backend.IsEmpty() || backend == "ordered")
+		SetBackend(OrderedTimerBackend);
+	else
+		Log(LogWarning, "Timer")
+		    << "Unknown timer backend '" << backend << "'. Valid backends are 'ordered' and 'wheel'.";
+
 	boost::mutex::scoped_lock lock(l_TimerMutex);
 	l_StopTimerThread = false;
 	l_TimerThread = boost::thread(&Timer::TimerThreadProc);
@@ -85,6 +431,41 @@ void Timer::Uninitialize(void)
 		l_TimerThread.join();
 }
 
+/**
+ * Selects the scheduling backend for timers. Timers which are already
+ * scheduled are moved to the new backend.
+ *
+ * @param backend The backend.
+ */
+void Timer::SetBackend(TimerBackend backend)
+{
+	boost::mutex::scoped_lock lock(l_TimerMutex);
+
+	if (l_Timers && l_TimerBackend == backend)
+		return;
+
+	std::vector<Timer *> timers;
+	ResetTimerQueue(backend, timers);
+
+	BOOST_FOREACH(Timer *timer, timers) {
+		l_Timers->Insert(timer);
+	}
+
+	/* Notify the worker that the timer queue has changed. */
+	l_TimerCV.notify_all();
+}
+
+/**
+ * Retrieves the scheduling backend for timers.
+ *
+ * @returns The backend.
+ */
+TimerBackend Timer::GetBackend(void)
+{
+	boost::mutex::scoped_lock lock(l_TimerMutex);
+	return l_TimerBackend;
+}
+
 /**
  * Calls this timer.
  */
@@ -157,7 +538,7 @@ void Timer::Stop(bool wait)
 	boost::mutex::scoped_lock lock(l_TimerMutex);
 
 	m_Started = false;
-	l_Timers.erase(this);
+	GetTimerQueue()->Remove(this);
 
 	/* Notify the worker thread that we've disabled a timer. */
 	l_TimerCV.notify_all();
@@ -199,8 +580,9 @@ void Timer::InternalReschedule(bool completed, double next)
 
 	if (m_Started && !m_Running) {
 		/* Remove and re-add the timer to update the index. */
-		l_Timers.erase(this);
-		l_Timers.insert(this);
+		TimerQueue *queue = GetTimerQueue();
+		queue->Remove(this);
+		queue->Insert(this);
 
 		/* Notify the worker that we've rescheduled a timer. */
 		l_TimerCV.notify_all();
@@ -232,22 +614,17 @@ void Timer::AdjustTimers(double adjustment)
 
 	double now = Utility::GetTime();
 
-	typedef boost::multi_index::nth_index<TimerSet, 1>::type TimerView;
-	TimerView& idx = boost::get<1>(l_Timers);
-
+	/* Rebuild the queue so that backends which track the current
+	 * time (i.e. the timing wheel) start over at the new time. */
 	std::vector<Timer *> timers;
+	ResetTimerQueue(l_TimerBackend, timers);
 
-	BOOST_FOREACH(Timer *timer, idx) {
+	BOOST_FOREACH(Timer *timer, timers) {
 		if (std::fabs(now - (timer->m_Next + adjustment)) <
-		    std::fabs(now - timer->m_Next)) {
+		    std::fabs(now - timer->m_Next))
 			timer->m_Next += adjustment;
-			timers.push_back(timer);
-		}
-	}
 
-	BOOST_FOREACH(Timer *timer, timers) {
-		l_Timers.erase(timer);
-		l_Timers.insert(timer);
+		l_Timers->Insert(timer);
 	}
 
 	/* Notify the worker that we've rescheduled some timers. */
@@ -264,24 +641,24 @@ void Timer::TimerThreadProc(void)
 	for (;;) {
 		boost::mutex::scoped_lock lock(l_TimerMutex);
 
-		typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
-		NextTimerView& idx = boost::get<1>(l_Timers);
-
 		/* Wait until there is at least one timer. */
-		while (idx.empty() && !l_StopTimerThread)
+		while (GetTimerQueue()->IsEmpty() && !l_StopTimerThread)
 			l_TimerCV.wait(lock);
 
 		if (l_StopTimerThread)
 			break;
 
-		NextTimerView::iterator it = idx.begin();
-		Timer *timer = *it;
+		TimerQueue *queue = GetTimerQueue();
+
+		double now = Utility::GetTime();
+		double next;
+		Timer *timer = queue->GetNextTimer(now, &next);
 
-		double wait = timer->m_Next - Utility::GetTime();
+		double wait = next - now;
 
-		if (wait > 0.01) {
+		if (!timer || wait > 0.01) {
 			/* Wait for the next timer. */
-			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(wait * 1000));
+			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(wait * 1000 + 1));
 
 			continue;
 		}
@@ -290,7 +667,7 @@ void Timer::TimerThreadProc(void)
 
 		/* Remove the timer from the list so it doesn't get called again
 		 * until the current call is completed. */
-		l_Timers.erase(timer);
+		queue->Remove(timer);
 
 		timer->m_Running = true;
 
@@ -23,9 +23,23 @@
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
 #include <boost/signals2.hpp>
+#include <list>
 
 namespace icinga {
 
+/**
+ * Scheduling backends for timers.
+ *
+ * @ingroup base
+ */
+enum TimerBackend
+{
+	OrderedTimerBackend, /**< An ordered set of timers, O(log n) reschedules. */
+	TimingWheelTimerBackend /**< A hierarchical timing wheel, O(1) reschedules. */
+};
+
+class TimingWheel;
+
 /**
  * A timer that periodically triggers an event.
  *
@@ -44,6 +58,9 @@ public:
 
 	static void AdjustTimers(double adjustment);
 
+	static void SetBackend(TimerBackend backend);
+	static TimerBackend GetBackend(void);
+
 	void Start(void);
 	void Stop(bool wait = false);
 
@@ -82,6 +99,8 @@ private:
 	double m_Next; /**< When the next event should happen. */
 	bool m_Started; /**< Whether the timer is enabled. */
 	bool m_Running; /**< Whether the timer proc is currently running. */
+	std::list<Timer *> *m_Bucket; /**< The timing wheel bucket this timer is in. */
+	std::list<Timer *>::iterator m_BucketIterator; /**< The timer's position in the bucket. */
 
 	void Call();
 	void InternalReschedule(bool completed, double next = -1);
@@ -92,6 +111,7 @@ private:
 	static void Uninitialize(void);
 
 	friend class Application;
+	friend class TimingWheel;
 };
 
 }
@@ -159,15 +159,19 @@ void TlsStream::OnEvent(int revents)
 			} while (SSL_pending(m_SSL.get()));
 
 			break;
-		case TlsActionWrite:
-			count = m_SendQ->Peek(buffer, sizeof(buffer));
+		case TlsActionWrite: {
+			/* Fill up a whole TLS record rather than writing one read buffer at a time. */
+			char wbuffer[16 * 1024];
 
-			rc = SSL_write(m_SSL.get(), buffer, count);
+			count = m_SendQ->Peek(wbuffer, sizeof(wbuffer));
+
+			rc = SSL_write(m_SSL.get(), wbuffer, count);
 
 			if (rc > 0)
 				m_SendQ->Read(NULL, rc, true);
 
 			break;
+		}
 		case TlsActionHandshake:
 			rc = SSL_do_handshake(m_SSL.get());
 
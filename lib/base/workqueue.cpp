@@ -130,6 +130,24 @@ void WorkQueue::SetExceptionCallback(const ExceptionCallback& callback)
 	m_ExceptionCallback = callback;
 }
 
+/**
+ * Records an exception for this work queue. Tasks which process several
+ * items can use this to report a failure for each item and continue with
+ * the remaining items.
+ */
+void WorkQueue::AddException(const boost::exception_ptr& exp)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (!m_ExceptionCallback)
+			m_Exceptions.push_back(exp);
+	}
+
+	if (m_ExceptionCallback)
+		m_ExceptionCallback(exp);
+}
+
 /**
  * Checks whether any exceptions have occurred while executing tasks for this
  * work queue. When a custom exception callback is set this method will always
@@ -211,15 +229,7 @@ void WorkQueue::WorkerThreadProc(void)
 		try {
 			task();
 		} catch (const std::exception&) {
-			lock.lock();
-
-			if (!m_ExceptionCallback)
-				m_Exceptions.push_back(boost::current_exception());
-
-			lock.unlock();
-
-			if (m_ExceptionCallback)
-				m_ExceptionCallback(boost::current_exception());
+			AddException(boost::current_exception());
 		}
 
 		/* clear the task so whatever other resources it holds are released
@@ -56,6 +56,7 @@ public:
 
 	void SetExceptionCallback(const ExceptionCallback& callback);
 
+	void AddException(const boost::exception_ptr& exp);
 	bool HasExceptions(void) const;
 	std::vector<boost::exception_ptr> GetExceptions(void) const;
 	void ReportExceptions(const String& facility) const;
@@ -31,6 +31,8 @@
 #include "base/convert.hpp"
 #include "base/statsfunction.hpp"
 #include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
 
 using namespace icinga;
 
@@ -50,22 +52,57 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 		stats->Set("idle", idle);
 		stats->Set("pending", pending);
 
-		nodes->Set(checker->GetName(), stats);
-
 		String perfdata_prefix = "checkercomponent_" + checker->GetName() + "_";
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "idle", Convert::ToDouble(idle)));
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "pending", Convert::ToDouble(pending)));
+
+		Array::Ptr shards = new Array();
+
+		for (std::vector<boost::shared_ptr<Shard> >::size_type i = 0; i < checker->m_Shards.size(); i++) {
+			Shard& shard = *checker->m_Shards[i];
+
+			unsigned long shard_idle, shard_pending, shard_dispatched;
+
+			{
+				boost::mutex::scoped_lock lock(shard.Mutex);
+				shard_idle = shard.IdleCheckables.size();
+				shard_pending = shard.PendingCheckables.size();
+				shard_dispatched = shard.ChecksDispatched;
+			}
+
+			Dictionary::Ptr shard_stats = new Dictionary();
+			shard_stats->Set("idle", shard_idle);
+			shard_stats->Set("pending", shard_pending);
+			shard_stats->Set("dispatched", shard_dispatched);
+			shards->Add(shard_stats);
+
+			String shard_prefix = perfdata_prefix + "shard" + Convert::ToString(i) + "_";
+			perfdata->Add(new PerfdataValue(shard_prefix + "idle", Convert::ToDouble(shard_idle)));
+			perfdata->Add(new PerfdataValue(shard_prefix + "pending", Convert::ToDouble(shard_pending)));
+			perfdata->Add(new PerfdataValue(shard_prefix + "dispatched", Convert::ToDouble(shard_dispatched), true));
+		}
+
+		stats->Set("shards", shards);
+
+		nodes->Set(checker->GetName(), stats);
 	}
 
 	status->Set("checkercomponent", nodes);
 }
 
 CheckerComponent::CheckerComponent(void)
-    : m_Stopped(false)
 { }
 
 void CheckerComponent::OnConfigLoaded(void)
 {
+	int count = GetConcurrentSchedulers();
+
+	if (count <= 0)
+		count = Application::GetConcurrency();
+
+	for (int i = 0; i < count; i++)
+		m_Shards.push_back(boost::make_shared<Shard>());
+
 	DynamicObject::OnStarted.connect(bind(&CheckerComponent::ObjectHandler, this, _1));
 	DynamicObject::OnStopped.connect(bind(&CheckerComponent::ObjectHandler, this, _1));
 	DynamicObject::OnPaused.connect(bind(&CheckerComponent::ObjectHandler, this, _1));
@@ -78,7 +115,10 @@ void CheckerComponent::Start(void)
 {
 	DynamicObject::Start();
 
-	m_Thread = boost::thread(boost::bind(&CheckerComponent::CheckThreadProc, this));
+	for (std::vector<boost::shared_ptr<Shard> >::size_type i = 0; i < m_Shards.size(); i++) {
+		Shard& shard = *m_Shards[i];
+		shard.Thread = boost::thread(boost::bind(&CheckerComponent::CheckThreadProc, this, boost::ref(shard), i));
+	}
 
 	m_ResultTimer = new Timer();
 	m_ResultTimer->SetInterval(5);
@@ -90,32 +130,46 @@ void CheckerComponent::Stop(void)
 {
 	Log(LogInformation, "CheckerComponent", "Checker stopped.");
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-		m_Stopped = true;
-		m_CV.notify_all();
+	BOOST_FOREACH(const boost::shared_ptr<Shard>& shard, m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		shard->Stopped = true;
+		shard->CV.notify_all();
 	}
 
 	m_ResultTimer->Stop();
-	m_Thread.join();
+
+	BOOST_FOREACH(const boost::shared_ptr<Shard>& shard, m_Shards) {
+		shard->Thread.join();
+	}
 
 	DynamicObject::Stop();
 }
 
-void CheckerComponent::CheckThreadProc(void)
+/**
+ * Returns the scheduler shard which is responsible for the specified checkable.
+ *
+ * @threadsafety Always.
+ */
+CheckerComponent::Shard& CheckerComponent::GetShard(const Checkable::Ptr& checkable) const
+{
+	size_t hash = boost::hash_value(checkable->GetName().GetData());
+	return *m_Shards[hash % m_Shards.size()];
+}
+
+void CheckerComponent::CheckThreadProc(Shard& shard, int id)
 {
-	Utility::SetThreadName("Check Scheduler");
+	Utility::SetThreadName("Check Scheduler #" + Convert::ToString(id));
 
-	boost::mutex::scoped_lock lock(m_Mutex);
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
 	for (;;) {
 		typedef boost::multi_index::nth_index<CheckableSet, 1>::type CheckTimeView;
-		CheckTimeView& idx = boost::get<1>(m_IdleCheckables);
+		CheckTimeView& idx = boost::get<1>(shard.IdleCheckables);
 
-		while (idx.begin() == idx.end() && !m_Stopped)
-			m_CV.wait(lock);
+		while (idx.begin() == idx.end() && !shard.Stopped)
+			shard.CV.wait(lock);
 
-		if (m_Stopped)
+		if (shard.Stopped)
 			break;
 
 		CheckTimeView::iterator it = idx.begin();
@@ -125,12 +179,12 @@ void CheckerComponent::CheckThreadProc(void)
 
 		if (wait > 0) {
 			/* Wait for the next check. */
-			m_CV.timed_wait(lock, boost::posix_time::milliseconds(wait * 1000));
+			shard.CV.timed_wait(lock, boost::posix_time::milliseconds(wait * 1000));
 
 			continue;
 		}
 
-		m_IdleCheckables.erase(checkable);
+		shard.IdleCheckables.erase(checkable);
 
 		bool forced = checkable->GetForceNextCheck();
 		bool check = true;
@@ -168,7 +222,7 @@ void CheckerComponent::CheckThreadProc(void)
 
 		/* reschedule the checkable if checks are disabled */
 		if (!check) {
-			m_IdleCheckables.insert(checkable);
+			shard.IdleCheckables.insert(checkable);
 			lock.unlock();
 
 			checkable->UpdateNextCheck();
@@ -178,7 +232,8 @@ void CheckerComponent::CheckThreadProc(void)
 			continue;
 		}
 
-		m_PendingCheckables.insert(checkable);
+		shard.PendingCheckables.insert(checkable);
+		shard.ChecksDispatched++;
 
 		lock.unlock();
 
@@ -219,20 +274,21 @@ void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 	}
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		Shard& shard = GetShard(checkable);
+		boost::mutex::scoped_lock lock(shard.Mutex);
 
 		/* remove the object from the list of pending objects; if it's not in the
 		 * list this was a manual (i.e. forced) check and we must not re-add the
 		 * object to the list because it's already there. */
 		CheckerComponent::CheckableSet::iterator it;
-		it = m_PendingCheckables.find(checkable);
-		if (it != m_PendingCheckables.end()) {
-			m_PendingCheckables.erase(it);
+		it = shard.PendingCheckables.find(checkable);
+		if (it != shard.PendingCheckables.end()) {
+			shard.PendingCheckables.erase(it);
 
 			if (checkable->IsActive())
-				m_IdleCheckables.insert(checkable);
+				shard.IdleCheckables.insert(checkable);
 
-			m_CV.notify_all();
+			shard.CV.notify_all();
 		}
 	}
 
@@ -244,12 +300,8 @@ void CheckerComponent::ResultTimerHandler(void)
 {
 	std::ostringstream msgbuf;
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-
-		msgbuf << "Pending checkables: " << m_PendingCheckables.size() << "; Idle checkables: " << m_IdleCheckables.size() << "; Checks/s: "
-		    << (CIB::GetActiveHostChecksStatistics(5) + CIB::GetActiveServiceChecksStatistics(5)) / 5.0;
-	}
+	msgbuf << "Pending checkables: " << GetPendingCheckables() << "; Idle checkables: " << GetIdleCheckables() << "; Checks/s: "
+	    << (CIB::GetActiveHostChecksStatistics(5) + CIB::GetActiveServiceChecksStatistics(5)) / 5.0;
 
 	Log(LogNotice, "CheckerComponent", msgbuf.str());
 }
@@ -265,29 +317,31 @@ void CheckerComponent::ObjectHandler(const DynamicObject::Ptr& object)
 	bool same_zone = (!zone || Zone::GetLocalZone() == zone);
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		Shard& shard = GetShard(checkable);
+		boost::mutex::scoped_lock lock(shard.Mutex);
 
 		if (object->IsActive() && !object->IsPaused() && same_zone) {
-			if (m_PendingCheckables.find(checkable) != m_PendingCheckables.end())
+			if (shard.PendingCheckables.find(checkable) != shard.PendingCheckables.end())
 				return;
 
-			m_IdleCheckables.insert(checkable);
+			shard.IdleCheckables.insert(checkable);
 		} else {
-			m_IdleCheckables.erase(checkable);
-			m_PendingCheckables.erase(checkable);
+			shard.IdleCheckables.erase(checkable);
+			shard.PendingCheckables.erase(checkable);
 		}
 
-		m_CV.notify_all();
+		shard.CV.notify_all();
 	}
 }
 
 void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	Shard& shard = GetShard(checkable);
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
 	/* remove and re-insert the object from the set in order to force an index update */
 	typedef boost::multi_index::nth_index<CheckableSet, 0>::type CheckableView;
-	CheckableView& idx = boost::get<0>(m_IdleCheckables);
+	CheckableView& idx = boost::get<0>(shard.IdleCheckables);
 
 	CheckableView::iterator it = idx.find(checkable);
 	if (it == idx.end())
@@ -295,19 +349,29 @@ void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 
 	idx.erase(checkable);
 	idx.insert(checkable);
-	m_CV.notify_all();
+	shard.CV.notify_all();
 }
 
 unsigned long CheckerComponent::GetIdleCheckables(void)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
 
-	return m_IdleCheckables.size();
+	BOOST_FOREACH(const boost::shared_ptr<Shard>& shard, m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->IdleCheckables.size();
+	}
+
+	return count;
 }
 
 unsigned long CheckerComponent::GetPendingCheckables(void)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
+
+	BOOST_FOREACH(const boost::shared_ptr<Shard>& shard, m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->PendingCheckables.size();
+	}
 
-	return m_PendingCheckables.size();
+	return count;
 }
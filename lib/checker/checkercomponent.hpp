@@ -28,6 +28,7 @@
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/key_extractors.hpp>
@@ -79,17 +80,34 @@ public:
 	unsigned long GetPendingCheckables(void);
 
 private:
-	boost::mutex m_Mutex;
-	boost::condition_variable m_CV;
-	bool m_Stopped;
-	boost::thread m_Thread;
+	/**
+	 * A scheduler shard. Each shard owns a disjoint subset of the
+	 * checkables (partitioned by name) and runs its own scheduler thread.
+	 */
+	struct Shard
+	{
+		boost::mutex Mutex;
+		boost::condition_variable CV;
+		boost::thread Thread;
+
+		CheckableSet IdleCheckables;
+		CheckableSet PendingCheckables;
 
-	CheckableSet m_IdleCheckables;
-	CheckableSet m_PendingCheckables;
+		unsigned long ChecksDispatched;
+		bool Stopped;
+
+		Shard(void)
+			: ChecksDispatched(0), Stopped(false)
+		{ }
+	};
+
+	std::vector<boost::shared_ptr<Shard> > m_Shards;
 
 	Timer::Ptr m_ResultTimer;
 
-	void CheckThreadProc(void);
+	Shard& GetShard(const Checkable::Ptr& checkable) const;
+
+	void CheckThreadProc(Shard& shard, int id);
 	void ResultTimerHandler(void);
 
 	void ExecuteCheckHelper(const Checkable::Ptr& checkable);
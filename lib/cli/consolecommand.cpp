@@ -19,6 +19,7 @@
 
 #include "cli/consolecommand.hpp"
 #include "config/configcompiler.hpp"
+#include "config/bytecode.hpp"
 #include "base/json.hpp"
 #include "base/console.hpp"
 #include "base/application.hpp"
@@ -267,7 +268,10 @@ incomplete:
 				expr = ConfigCompiler::CompileText(fileName, command, false);
 
 				if (expr) {
-					Value result = expr->Evaluate(l_ScriptFrame);
+					boost::shared_ptr<Expression> cexpr = BytecodeExpression::Compile(boost::shared_ptr<Expression>(expr));
+					expr = NULL;
+
+					Value result = cexpr->Evaluate(l_ScriptFrame);
 					std::cout << ConsoleColorTag(Console_ForegroundCyan);
 					if (!result.IsObject() || result.IsObjectType<Array>() || result.IsObjectType<Dictionary>())
 						std::cout << JsonEncode(result);
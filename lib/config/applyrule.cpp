@@ -18,19 +18,30 @@
  ******************************************************************************/
 
 #include "config/applyrule.hpp"
+#include "config/applyruleindex.hpp"
+#include "config/bytecode.hpp"
 #include "base/logger.hpp"
 #include <boost/foreach.hpp>
-#include <set>
+#include <boost/make_shared.hpp>
 
 using namespace icinga;
 
 ApplyRule::RuleMap ApplyRule::m_Rules;
 ApplyRule::TypeMap ApplyRule::m_Types;
+boost::mutex ApplyRule::m_IndexMutex;
+std::map<std::pair<String, String>, boost::shared_ptr<ApplyRuleIndex> > ApplyRule::m_Indexes;
+
+/* The match sets are owned by the callers of CollectMatches(). */
+static void ReleasePendingMatches(std::set<ApplyRule *> *)
+{ }
+
+boost::thread_specific_ptr<std::set<ApplyRule *> > ApplyRule::m_PendingMatches(&ReleasePendingMatches);
 
 ApplyRule::ApplyRule(const String& targetType, const String& name, const boost::shared_ptr<Expression>& expression,
     const boost::shared_ptr<Expression>& filter, const String& fkvar, const String& fvvar, const boost::shared_ptr<Expression>& fterm,
     const DebugInfo& di, const Dictionary::Ptr& scope)
-	: m_TargetType(targetType), m_Name(name), m_Expression(expression), m_Filter(filter), m_FKVar(fkvar),
+	: m_TargetType(targetType), m_Name(name), m_Expression(expression), m_Filter(filter),
+	  m_CompiledFilter(BytecodeExpression::Compile(filter)), m_FKVar(fkvar),
 	  m_FVVar(fvvar), m_FTerm(fterm), m_DebugInfo(di), m_Scope(scope), m_HasMatches(false)
 { }
 
@@ -84,11 +95,14 @@ void ApplyRule::AddRule(const String& sourceType, const String& targetType, cons
     const String& fvvar, const boost::shared_ptr<Expression>& fterm, const DebugInfo& di, const Dictionary::Ptr& scope)
 {
 	m_Rules[sourceType].push_back(ApplyRule(targetType, name, expression, filter, fkvar, fvvar, fterm, di, scope));
+
+	boost::mutex::scoped_lock lock(m_IndexMutex);
+	m_Indexes.clear();
 }
 
 bool ApplyRule::EvaluateFilter(ScriptFrame& frame) const
 {
-	return Convert::ToBool(m_Filter->Evaluate(frame));
+	return Convert::ToBool(m_CompiledFilter->Evaluate(frame));
 }
 
 void ApplyRule::RegisterType(const String& sourceType, const std::vector<String>& targetTypes)
@@ -131,7 +145,13 @@ std::vector<String> ApplyRule::GetTargetTypes(const String& sourceType)
 
 void ApplyRule::AddMatch(void)
 {
-	m_HasMatches = true;
+	/* CollectMatches() keeps the rules from being written to by all threads */
+	std::set<ApplyRule *> *matches = m_PendingMatches.get();
+
+	if (matches)
+		matches->insert(this);
+	else
+		m_HasMatches = true;
 }
 
 bool ApplyRule::HasMatches(void) const
@@ -149,6 +169,57 @@ std::vector<ApplyRule>& ApplyRule::GetRules(const String& type)
 	return it->second;
 }
 
+/**
+ * Returns the rules for the source type whose filter may match the target
+ * object(s) in 'locals'. An empty target type selects all rules.
+ */
+std::vector<ApplyRule *> ApplyRule::GetCandidateRules(const String& sourceType, const String& targetType, const Dictionary::Ptr& locals)
+{
+	boost::shared_ptr<ApplyRuleIndex> index;
+
+	{
+		boost::mutex::scoped_lock lock(m_IndexMutex);
+
+		boost::shared_ptr<ApplyRuleIndex>& cached = m_Indexes[std::make_pair(sourceType, targetType)];
+
+		if (!cached) {
+			std::vector<ApplyRule *> rules;
+
+			BOOST_FOREACH(ApplyRule& rule, GetRules(sourceType)) {
+				if (targetType.IsEmpty() || rule.GetTargetType() == targetType)
+					rules.push_back(&rule);
+			}
+
+			cached = boost::make_shared<ApplyRuleIndex>(rules, locals->GetKeys());
+
+			Log(LogDebug, "ApplyRule")
+			    << "Indexed " << cached->GetIndexedRuleCount() << " of " << rules.size()
+			    << " apply rules for type '" << sourceType << "'" << (targetType.IsEmpty() ? String() : " on '" + targetType + "'") << ".";
+		}
+
+		index = cached;
+	}
+
+	return index->GetCandidates(locals);
+}
+
+/**
+ * Records the matches for the current thread in the specified set instead
+ * of the rules themselves until CollectMatches() is called with NULL.
+ * The matches need to be passed to CommitMatches() afterwards.
+ */
+void ApplyRule::CollectMatches(std::set<ApplyRule *> *matches)
+{
+	m_PendingMatches.reset(matches);
+}
+
+void ApplyRule::CommitMatches(const std::set<ApplyRule *>& matches)
+{
+	BOOST_FOREACH(ApplyRule *rule, matches) {
+		rule->m_HasMatches = true;
+	}
+}
+
 void ApplyRule::CheckMatches(void)
 {
 	BOOST_FOREACH(const RuleMap::value_type& kv, m_Rules) {
@@ -163,5 +234,8 @@ void ApplyRule::CheckMatches(void)
 void ApplyRule::DiscardRules(void)
 {
 	m_Rules.clear();
+
+	boost::mutex::scoped_lock lock(m_IndexMutex);
+	m_Indexes.clear();
 }
 
@@ -24,10 +24,15 @@
 #include "config/expression.hpp"
 #include "base/debuginfo.hpp"
 #include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <set>
 
 namespace icinga
 {
 
+class ApplyRuleIndex;
+
 /**
  * @ingroup config
  */
@@ -54,12 +59,15 @@ public:
 	static void AddRule(const String& sourceType, const String& targetType, const String& name, const boost::shared_ptr<Expression>& expression,
 	    const boost::shared_ptr<Expression>& filter, const String& fkvar, const String& fvvar, const boost::shared_ptr<Expression>& fterm, const DebugInfo& di, const Dictionary::Ptr& scope);
 	static std::vector<ApplyRule>& GetRules(const String& type);
+	static std::vector<ApplyRule *> GetCandidateRules(const String& sourceType, const String& targetType, const Dictionary::Ptr& locals);
 
 	static void RegisterType(const String& sourceType, const std::vector<String>& targetTypes);
 	static bool IsValidSourceType(const String& sourceType);
 	static bool IsValidTargetType(const String& sourceType, const String& targetType);
 	static std::vector<String> GetTargetTypes(const String& sourceType);
 
+	static void CollectMatches(std::set<ApplyRule *> *matches);
+	static void CommitMatches(const std::set<ApplyRule *>& matches);
 	static void CheckMatches(void);
 	static void DiscardRules(void);
 
@@ -68,6 +76,7 @@ private:
 	String m_Name;
 	boost::shared_ptr<Expression> m_Expression;
 	boost::shared_ptr<Expression> m_Filter;
+	boost::shared_ptr<Expression> m_CompiledFilter;
 	String m_FKVar;
 	String m_FVVar;
 	boost::shared_ptr<Expression> m_FTerm;
@@ -78,6 +87,11 @@ private:
 	static TypeMap m_Types;
 	static RuleMap m_Rules;
 
+	static boost::mutex m_IndexMutex;
+	static std::map<std::pair<String, String>, boost::shared_ptr<ApplyRuleIndex> > m_Indexes;
+
+	static boost::thread_specific_ptr<std::set<ApplyRule *> > m_PendingMatches;
+
 	ApplyRule(const String& targetType, const String& name, const boost::shared_ptr<Expression>& expression,
 	    const boost::shared_ptr<Expression>& filter, const String& fkvar, const String& fvvar, const boost::shared_ptr<Expression>& fterm,
 	    const DebugInfo& di, const Dictionary::Ptr& scope);
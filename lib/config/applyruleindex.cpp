@@ -0,0 +1,304 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/applyruleindex.hpp"
+#include "config/applyrule.hpp"
+#include "base/scriptframe.hpp"
+#include "base/objectlock.hpp"
+#include "base/convert.hpp"
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+
+using namespace icinga;
+
+ApplyRuleIndex::ApplyRuleIndex(const std::vector<ApplyRule *>& rules, const std::vector<String>& variables)
+	: m_Rules(rules)
+{
+	std::set<String> vars(variables.begin(), variables.end());
+
+	for (size_t i = 0; i < m_Rules.size(); i++) {
+		std::vector<ApplyRulePredicate> predicates;
+
+		if (!GetPredicates(m_Rules[i]->GetFilter().get(), vars, predicates)) {
+			m_UnindexedRules.push_back(i);
+			continue;
+		}
+
+		BOOST_FOREACH(const ApplyRulePredicate& predicate, predicates) {
+			PathIndex& pindex = m_Paths[predicate.Path];
+
+			if (!pindex.PathExpression)
+				pindex.PathExpression = predicate.PathExpression;
+
+			if (pindex.Rules.empty() || pindex.Rules.back() != i)
+				pindex.Rules.push_back(i);
+
+			if (predicate.Type == ApplyRulePredicateEqual)
+				pindex.Equal[predicate.Operand].push_back(i);
+			else if (predicate.Type == ApplyRulePredicateContains)
+				pindex.Contains[predicate.Operand].push_back(i);
+			else
+				pindex.Prefix[predicate.Operand].push_back(i);
+		}
+	}
+}
+
+/**
+ * Returns the number of rules which can be looked up in the index.
+ */
+size_t ApplyRuleIndex::GetIndexedRuleCount(void) const
+{
+	return m_Rules.size() - m_UnindexedRules.size();
+}
+
+/**
+ * Extracts predicates from a filter expression. At least one of the
+ * predicates is true for every object the filter matches.
+ *
+ * @returns false if the filter can't be reduced to such predicates.
+ */
+bool ApplyRuleIndex::GetPredicates(Expression *filter, const std::set<String>& variables, std::vector<ApplyRulePredicate>& predicates)
+{
+	if (!filter)
+		return false;
+
+	LogicalOrExpression *oexpr = dynamic_cast<LogicalOrExpression *>(filter);
+
+	if (oexpr) {
+		std::vector<ApplyRulePredicate> lhs, rhs;
+
+		if (!GetPredicates(oexpr->GetOperand1(), variables, lhs) || !GetPredicates(oexpr->GetOperand2(), variables, rhs))
+			return false;
+
+		predicates.insert(predicates.end(), lhs.begin(), lhs.end());
+		predicates.insert(predicates.end(), rhs.begin(), rhs.end());
+
+		return true;
+	}
+
+	LogicalAndExpression *aexpr = dynamic_cast<LogicalAndExpression *>(filter);
+
+	if (aexpr) {
+		/* either side is sufficient, 'assign where' comes first for rules with 'ignore where' */
+		return GetPredicates(aexpr->GetOperand1(), variables, predicates) ||
+		    GetPredicates(aexpr->GetOperand2(), variables, predicates);
+	}
+
+	ApplyRulePredicate predicate;
+
+	EqualExpression *eexpr = dynamic_cast<EqualExpression *>(filter);
+
+	if (eexpr) {
+		Expression *pathExpr = eexpr->GetOperand1();
+		Expression *valueExpr = eexpr->GetOperand2();
+
+		if (dynamic_cast<LiteralExpression *>(pathExpr))
+			std::swap(pathExpr, valueExpr);
+
+		if (!GetPath(pathExpr, variables, &predicate.Path) || !GetStringLiteral(valueExpr, &predicate.Operand))
+			return false;
+
+		predicate.Type = ApplyRulePredicateEqual;
+		predicate.PathExpression = pathExpr;
+		predicates.push_back(predicate);
+
+		return true;
+	}
+
+	InExpression *iexpr = dynamic_cast<InExpression *>(filter);
+
+	if (iexpr) {
+		if (!GetStringLiteral(iexpr->GetOperand1(), &predicate.Operand) || !GetPath(iexpr->GetOperand2(), variables, &predicate.Path))
+			return false;
+
+		predicate.Type = ApplyRulePredicateContains;
+		predicate.PathExpression = iexpr->GetOperand2();
+		predicates.push_back(predicate);
+
+		return true;
+	}
+
+	FunctionCallExpression *fexpr = dynamic_cast<FunctionCallExpression *>(filter);
+
+	if (fexpr) {
+		VariableExpression *fname = dynamic_cast<VariableExpression *>(fexpr->m_FName);
+
+		if (!fname || fname->GetVariable() != "match" || fexpr->m_Args.size() != 2)
+			return false;
+
+		String pattern;
+
+		if (!GetStringLiteral(fexpr->m_Args[0], &pattern) || !GetPath(fexpr->m_Args[1], variables, &predicate.Path))
+			return false;
+
+		/* match() is case-insensitive, the index uses lower-case prefixes */
+		size_t wildcard = pattern.FindFirstOf("*?\\");
+
+		if (wildcard == 0)
+			return false;
+
+		predicate.Type = ApplyRulePredicatePrefix;
+		predicate.PathExpression = fexpr->m_Args[1];
+		predicate.Operand = boost::algorithm::to_lower_copy(pattern.SubStr(0, wildcard).GetData());
+		predicates.push_back(predicate);
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Checks whether the expression is an attribute lookup like host.vars.os
+ * and returns a string representation of the path.
+ */
+bool ApplyRuleIndex::GetPath(Expression *expr, const std::set<String>& variables, String *path)
+{
+	VariableExpression *vexpr = dynamic_cast<VariableExpression *>(expr);
+
+	if (vexpr) {
+		if (variables.find(vexpr->GetVariable()) == variables.end())
+			return false;
+
+		*path = vexpr->GetVariable();
+		return true;
+	}
+
+	IndexerExpression *iexpr = dynamic_cast<IndexerExpression *>(expr);
+
+	if (iexpr) {
+		String index;
+
+		if (!GetStringLiteral(iexpr->GetOperand2(), &index) || !GetPath(iexpr->GetOperand1(), variables, path))
+			return false;
+
+		/* length-prefixed so that keys containing dots can't collide */
+		*path += "." + Convert::ToString(index.GetLength()) + ":" + index;
+		return true;
+	}
+
+	return false;
+}
+
+bool ApplyRuleIndex::GetStringLiteral(Expression *expr, String *value)
+{
+	LiteralExpression *lexpr = dynamic_cast<LiteralExpression *>(expr);
+
+	if (!lexpr)
+		return false;
+
+	Value literal = lexpr->GetValue();
+
+	/* empty strings compare equal to null values */
+	if (!literal.IsString() || static_cast<String>(literal).IsEmpty())
+		return false;
+
+	*value = literal;
+	return true;
+}
+
+void ApplyRuleIndex::MarkRules(const std::vector<size_t>& rules, std::vector<bool>& candidates)
+{
+	BOOST_FOREACH(size_t rule, rules)
+		candidates[rule] = true;
+}
+
+/**
+ * Returns the rules whose filter may match for the specified local
+ * variables (e.g. "host"), in the order they were defined in.
+ */
+std::vector<ApplyRule *> ApplyRuleIndex::GetCandidates(const Dictionary::Ptr& locals) const
+{
+	std::vector<bool> candidates(m_Rules.size(), false);
+
+	MarkRules(m_UnindexedRules, candidates);
+
+	typedef std::pair<String, PathIndex> PathPair;
+	typedef std::pair<String, std::vector<size_t> > RulesPair;
+
+	BOOST_FOREACH(const PathPair& kv, m_Paths) {
+		const PathIndex& pindex = kv.second;
+
+		ScriptFrame frame;
+		locals->CopyTo(frame.Locals);
+
+		Value value;
+
+		try {
+			value = pindex.PathExpression->Evaluate(frame);
+		} catch (const std::exception&) {
+			/* let the filters report the error */
+			MarkRules(pindex.Rules, candidates);
+			continue;
+		}
+
+		if (value.IsString()) {
+			std::map<String, std::vector<size_t> >::const_iterator it = pindex.Equal.find(value);
+
+			if (it != pindex.Equal.end())
+				MarkRules(it->second, candidates);
+		}
+
+		if (!pindex.Contains.empty()) {
+			if (value.IsObjectType<Array>()) {
+				Array::Ptr arr = value;
+
+				ObjectLock olock(arr);
+				BOOST_FOREACH(const Value& item, arr) {
+					if (!item.IsString())
+						continue;
+
+					std::map<String, std::vector<size_t> >::const_iterator it = pindex.Contains.find(item);
+
+					if (it != pindex.Contains.end())
+						MarkRules(it->second, candidates);
+				}
+			} else if (!value.IsEmpty()) {
+				/* the 'in' operator throws an error for these */
+				BOOST_FOREACH(const RulesPair& rp, pindex.Contains)
+					MarkRules(rp.second, candidates);
+			}
+		}
+
+		if (!pindex.Prefix.empty()) {
+			if (value.IsObject()) {
+				BOOST_FOREACH(const RulesPair& rp, pindex.Prefix)
+					MarkRules(rp.second, candidates);
+			} else {
+				String text = boost::algorithm::to_lower_copy(static_cast<String>(value).GetData());
+
+				for (String::SizeType i = 1; i <= text.GetLength(); i++) {
+					std::map<String, std::vector<size_t> >::const_iterator it = pindex.Prefix.find(text.SubStr(0, i));
+
+					if (it != pindex.Prefix.end())
+						MarkRules(it->second, candidates);
+				}
+			}
+		}
+	}
+
+	std::vector<ApplyRule *> rules;
+
+	for (size_t i = 0; i < m_Rules.size(); i++) {
+		if (candidates[i])
+			rules.push_back(m_Rules[i]);
+	}
+
+	return rules;
+}
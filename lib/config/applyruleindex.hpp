@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef APPLYRULEINDEX_H
+#define APPLYRULEINDEX_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <vector>
+#include <map>
+#include <set>
+
+namespace icinga
+{
+
+class ApplyRule;
+
+/**
+ * The kind of condition an apply rule predicate checks.
+ *
+ * @ingroup config
+ */
+enum ApplyRulePredicateType
+{
+	ApplyRulePredicateEqual,
+	ApplyRulePredicateContains,
+	ApplyRulePredicatePrefix
+};
+
+/**
+ * A simple condition which is necessary for an apply rule's filter to
+ * match, e.g. host.vars.os == "Linux".
+ *
+ * @ingroup config
+ */
+struct ApplyRulePredicate
+{
+	ApplyRulePredicateType Type;
+	String Path;
+	Expression *PathExpression;
+	String Operand;
+};
+
+/**
+ * Finds the apply rules which may match an object without evaluating
+ * the filters of all rules.
+ *
+ * Simple predicates are extracted from the assign/ignore filters when the
+ * index is built. The attributes these predicates refer to are evaluated
+ * only once per object; rules whose filter can't be analyzed are always
+ * returned. The candidate rules' filters still have to be evaluated.
+ *
+ * @ingroup config
+ */
+class I2_CONFIG_API ApplyRuleIndex
+{
+public:
+	ApplyRuleIndex(const std::vector<ApplyRule *>& rules, const std::vector<String>& variables);
+
+	std::vector<ApplyRule *> GetCandidates(const Dictionary::Ptr& locals) const;
+
+	size_t GetIndexedRuleCount(void) const;
+
+	static bool GetPredicates(Expression *filter, const std::set<String>& variables, std::vector<ApplyRulePredicate>& predicates);
+
+private:
+	struct PathIndex
+	{
+		Expression *PathExpression;
+		std::map<String, std::vector<size_t> > Equal;
+		std::map<String, std::vector<size_t> > Contains;
+		std::map<String, std::vector<size_t> > Prefix;
+		std::vector<size_t> Rules;
+
+		PathIndex(void)
+			: PathExpression(NULL)
+		{ }
+	};
+
+	std::vector<ApplyRule *> m_Rules;
+	std::vector<size_t> m_UnindexedRules;
+	std::map<String, PathIndex> m_Paths;
+
+	static bool GetPath(Expression *expr, const std::set<String>& variables, String *path);
+	static bool GetStringLiteral(Expression *expr, String *value);
+	static void MarkRules(const std::vector<size_t>& rules, std::vector<bool>& candidates);
+};
+
+}
+
+#endif /* APPLYRULEINDEX_H */
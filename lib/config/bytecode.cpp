@@ -0,0 +1,649 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/bytecode.hpp"
+#include "config/vmops.hpp"
+#include "base/array.hpp"
+#include "base/json.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/exception.hpp"
+#include "base/debug.hpp"
+#include <boost/foreach.hpp>
+#include <boost/exception/errinfo_nested_exception.hpp>
+
+namespace icinga
+{
+
+/**
+ * Lowers an expression tree into the instructions of a BytecodeExpression.
+ *
+ * Compile(expr, dst) stores the expression's value in register dst and
+ * only uses registers above the ones which were allocated when it was
+ * called as temporaries.
+ *
+ * @ingroup config
+ */
+class BytecodeCompiler
+{
+public:
+	BytecodeCompiler(BytecodeExpression *code)
+		: m_Code(code), m_NextRegister(1)
+	{
+		m_Code->m_RegisterCount = 1;
+	}
+
+	void Compile(const Expression *expr, int dst)
+	{
+		const LiteralExpression *lexpr = dynamic_cast<const LiteralExpression *>(expr);
+
+		if (lexpr) {
+			Emit(expr, OpLoadConstant, dst, AddConstant(lexpr->GetValue()));
+			return;
+		}
+
+		const VariableExpression *vexpr = dynamic_cast<const VariableExpression *>(expr);
+
+		if (vexpr) {
+			Emit(expr, OpLoadVariable, dst, AddString(vexpr->GetVariable()));
+			return;
+		}
+
+		const GetScopeExpression *sexpr = dynamic_cast<const GetScopeExpression *>(expr);
+
+		if (sexpr) {
+			Emit(expr, OpLoadScope, dst, sexpr->m_ScopeSpec);
+			return;
+		}
+
+		const IndexerExpression *iexpr = dynamic_cast<const IndexerExpression *>(expr);
+
+		if (iexpr) {
+			Compile(iexpr->GetOperand1(), dst);
+
+			const LiteralExpression *index = dynamic_cast<const LiteralExpression *>(iexpr->GetOperand2());
+
+			if (index) {
+				Emit(expr, OpGetFieldConstant, dst, dst, AddString(index->GetValue()));
+			} else {
+				int reg = AllocateRegisters(1);
+				Compile(iexpr->GetOperand2(), reg);
+				Emit(expr, OpGetField, dst, dst, reg);
+				FreeRegisters(reg);
+			}
+
+			return;
+		}
+
+		if (CompileSet(dynamic_cast<const SetExpression *>(expr), dst))
+			return;
+
+		const DictExpression *dexpr = dynamic_cast<const DictExpression *>(expr);
+
+		/* non-inline dictionaries replace 'this', leave them to the AST */
+		if (dexpr && dexpr->m_Inline) {
+			if (dexpr->m_Expressions.empty())
+				Emit(expr, OpLoadConstant, dst, AddConstant(Empty));
+
+			BOOST_FOREACH(const Expression *aexpr, dexpr->m_Expressions) {
+				Compile(aexpr, dst);
+			}
+
+			return;
+		}
+
+		const ArrayExpression *aexpr = dynamic_cast<const ArrayExpression *>(expr);
+
+		if (aexpr) {
+			int count = aexpr->m_Expressions.size();
+			int first = AllocateRegisters(count);
+
+			for (int i = 0; i < count; i++)
+				Compile(aexpr->m_Expressions[i], first + i);
+
+			Emit(expr, OpNewArray, dst, 0, first, count);
+			FreeRegisters(first);
+
+			return;
+		}
+
+		const ConditionalExpression *cexpr = dynamic_cast<const ConditionalExpression *>(expr);
+
+		if (cexpr) {
+			Compile(cexpr->m_Condition, dst);
+			size_t jfalse = Emit(expr, OpJumpIfFalse, dst, dst);
+
+			Compile(cexpr->m_TrueBranch, dst);
+			size_t jend = Emit(expr, OpJump, dst);
+
+			SetJumpTarget(jfalse);
+
+			if (cexpr->m_FalseBranch)
+				Compile(cexpr->m_FalseBranch, dst);
+			else
+				Emit(expr, OpLoadConstant, dst, AddConstant(Empty));
+
+			SetJumpTarget(jend);
+
+			return;
+		}
+
+		if (CompileCall(dynamic_cast<const FunctionCallExpression *>(expr), dst))
+			return;
+
+		const UnaryExpression *uexpr = dynamic_cast<const UnaryExpression *>(expr);
+
+		if (uexpr) {
+			BytecodeOp op;
+
+			if (dynamic_cast<const NegateExpression *>(expr))
+				op = OpNegate;
+			else if (dynamic_cast<const LogicalNegateExpression *>(expr))
+				op = OpLogicalNegate;
+			else if (dynamic_cast<const ReturnExpression *>(expr))
+				op = OpReturn;
+			else {
+				EmitFallback(expr, dst);
+				return;
+			}
+
+			Compile(uexpr->GetOperand(), dst);
+			Emit(expr, op, dst, dst);
+
+			return;
+		}
+
+		const BinaryExpression *bexpr = dynamic_cast<const BinaryExpression *>(expr);
+
+		if (bexpr) {
+			if (dynamic_cast<const LogicalAndExpression *>(expr) || dynamic_cast<const LogicalOrExpression *>(expr)) {
+				BytecodeOp op = dynamic_cast<const LogicalAndExpression *>(expr) ? OpJumpIfFalse : OpJumpIfTrue;
+
+				Compile(bexpr->GetOperand1(), dst);
+				size_t jump = Emit(expr, op, dst, dst);
+				Compile(bexpr->GetOperand2(), dst);
+				SetJumpTarget(jump);
+
+				return;
+			}
+
+			if (dynamic_cast<const InExpression *>(expr) || dynamic_cast<const NotInExpression *>(expr)) {
+				bool negate = (dynamic_cast<const NotInExpression *>(expr) != NULL);
+
+				/* the right side is checked first, the left side is only evaluated for arrays */
+				int reg = AllocateRegisters(1);
+				Compile(bexpr->GetOperand2(), reg);
+				size_t check = Emit(expr, OpCheckIn, dst, reg, 0, negate ? 1 : 0);
+				Compile(bexpr->GetOperand1(), dst);
+				Emit(expr, negate ? OpNotIn : OpIn, dst, dst, reg);
+				SetJumpTarget(check);
+				FreeRegisters(reg);
+
+				return;
+			}
+
+			BytecodeOp op;
+
+			if (GetBinaryOp(expr, &op)) {
+				Compile(bexpr->GetOperand1(), dst);
+				int reg = AllocateRegisters(1);
+				Compile(bexpr->GetOperand2(), reg);
+				Emit(expr, op, dst, dst, reg);
+				FreeRegisters(reg);
+
+				return;
+			}
+		}
+
+		EmitFallback(expr, dst);
+	}
+
+private:
+	BytecodeExpression *m_Code;
+	int m_NextRegister;
+
+	bool CompileSet(const SetExpression *setexpr, int dst)
+	{
+		if (!setexpr || setexpr->m_Op != OpSetLiteral)
+			return false;
+
+		/* only 'var x = ...' assignments, anything else is handled by the AST */
+		const IndexerExpression *target = dynamic_cast<const IndexerExpression *>(setexpr->GetOperand1());
+
+		if (!target)
+			return false;
+
+		const GetScopeExpression *scope = dynamic_cast<const GetScopeExpression *>(target->GetOperand1());
+		const LiteralExpression *name = dynamic_cast<const LiteralExpression *>(target->GetOperand2());
+
+		if (!scope || scope->m_ScopeSpec != ScopeLocal || !name || !name->GetValue().IsString())
+			return false;
+
+		Compile(setexpr->GetOperand2(), dst);
+		Emit(setexpr, OpSetLocal, dst, AddString(name->GetValue()), dst);
+
+		return true;
+	}
+
+	bool CompileCall(const FunctionCallExpression *fexpr, int dst)
+	{
+		if (!fexpr)
+			return false;
+
+		/* method calls need the reference semantics of IndexerExpression::GetReference() */
+		if (dynamic_cast<const IndexerExpression *>(fexpr->m_FName))
+			return false;
+
+		int callee = AllocateRegisters(2);
+
+		const VariableExpression *vexpr = dynamic_cast<const VariableExpression *>(fexpr->m_FName);
+
+		if (vexpr)
+			Emit(fexpr, OpLoadCallee, callee, AddString(vexpr->GetVariable()));
+		else {
+			Compile(fexpr->m_FName, callee);
+			Emit(fexpr, OpLoadConstant, callee + 1, AddConstant(Empty));
+		}
+
+		int count = fexpr->m_Args.size();
+
+		/* like the AST the arguments are only evaluated once the callee has been checked */
+		Emit(fexpr, OpCheckCall, 0, callee, 0, count);
+
+		int first = AllocateRegisters(count);
+
+		for (int i = 0; i < count; i++)
+			Compile(fexpr->m_Args[i], first + i);
+
+		Emit(fexpr, OpCall, dst, callee, first, count);
+		FreeRegisters(callee);
+
+		return true;
+	}
+
+	static bool GetBinaryOp(const Expression *expr, BytecodeOp *op)
+	{
+		if (dynamic_cast<const AddExpression *>(expr))
+			*op = OpAdd;
+		else if (dynamic_cast<const SubtractExpression *>(expr))
+			*op = OpSubtract;
+		else if (dynamic_cast<const MultiplyExpression *>(expr))
+			*op = OpMultiply;
+		else if (dynamic_cast<const DivideExpression *>(expr))
+			*op = OpDivide;
+		else if (dynamic_cast<const ModuloExpression *>(expr))
+			*op = OpModulo;
+		else if (dynamic_cast<const XorExpression *>(expr))
+			*op = OpXor;
+		else if (dynamic_cast<const BinaryAndExpression *>(expr))
+			*op = OpBinaryAnd;
+		else if (dynamic_cast<const BinaryOrExpression *>(expr))
+			*op = OpBinaryOr;
+		else if (dynamic_cast<const ShiftLeftExpression *>(expr))
+			*op = OpShiftLeft;
+		else if (dynamic_cast<const ShiftRightExpression *>(expr))
+			*op = OpShiftRight;
+		else if (dynamic_cast<const EqualExpression *>(expr))
+			*op = OpEqual;
+		else if (dynamic_cast<const NotEqualExpression *>(expr))
+			*op = OpNotEqual;
+		else if (dynamic_cast<const LessThanExpression *>(expr))
+			*op = OpLessThan;
+		else if (dynamic_cast<const GreaterThanExpression *>(expr))
+			*op = OpGreaterThan;
+		else if (dynamic_cast<const LessThanOrEqualExpression *>(expr))
+			*op = OpLessThanOrEqual;
+		else if (dynamic_cast<const GreaterThanOrEqualExpression *>(expr))
+			*op = OpGreaterThanOrEqual;
+		else
+			return false;
+
+		return true;
+	}
+
+	size_t Emit(const Expression *source, BytecodeOp op, int dst, int src1 = 0, int src2 = 0, int src3 = 0)
+	{
+		BytecodeInstruction ins;
+		ins.Op = op;
+		ins.Dst = dst;
+		ins.Src1 = src1;
+		ins.Src2 = src2;
+		ins.Src3 = src3;
+
+		m_Code->m_Code.push_back(ins);
+		m_Code->m_Sources.push_back(source);
+
+		return m_Code->m_Code.size() - 1;
+	}
+
+	void EmitFallback(const Expression *expr, int dst)
+	{
+		m_Code->m_Fallbacks.push_back(expr);
+		Emit(expr, OpEvaluate, dst, m_Code->m_Fallbacks.size() - 1);
+	}
+
+	void SetJumpTarget(size_t jump)
+	{
+		m_Code->m_Code[jump].Src2 = m_Code->m_Code.size();
+	}
+
+	int AddConstant(const Value& value)
+	{
+		m_Code->m_Constants.push_back(value);
+		return m_Code->m_Constants.size() - 1;
+	}
+
+	int AddString(const String& value)
+	{
+		m_Code->m_Strings.push_back(value);
+		return m_Code->m_Strings.size() - 1;
+	}
+
+	int AllocateRegisters(int count)
+	{
+		int first = m_NextRegister;
+		m_NextRegister += count;
+
+		if (m_NextRegister > m_Code->m_RegisterCount)
+			m_Code->m_RegisterCount = m_NextRegister;
+
+		return first;
+	}
+
+	void FreeRegisters(int first)
+	{
+		m_NextRegister = first;
+	}
+};
+
+}
+
+using namespace icinga;
+
+BytecodeExpression::BytecodeExpression(const boost::shared_ptr<Expression>& expression)
+	: m_Expression(expression), m_RegisterCount(0)
+{ }
+
+/**
+ * Compiles an expression tree into bytecode.
+ *
+ * @param expression The expression.
+ * @returns The compiled expression, or the expression itself if none of
+ *          its nodes can be compiled.
+ */
+boost::shared_ptr<Expression> BytecodeExpression::Compile(const boost::shared_ptr<Expression>& expression)
+{
+	if (!expression)
+		return expression;
+
+	boost::shared_ptr<BytecodeExpression> code(new BytecodeExpression(expression));
+
+	BytecodeCompiler compiler(code.get());
+	compiler.Compile(expression.get(), 0);
+
+	if (code->m_Code.size() == 1 && code->m_Code[0].Op == OpEvaluate)
+		return expression;
+
+	return code;
+}
+
+size_t BytecodeExpression::GetInstructionCount(void) const
+{
+	return m_Code.size();
+}
+
+const DebugInfo& BytecodeExpression::GetDebugInfo(void) const
+{
+	return m_Expression->GetDebugInfo();
+}
+
+ExpressionResult BytecodeExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
+{
+	/* debug hints are only collected for object definitions */
+	if (dhint)
+		return m_Expression->DoEvaluate(frame, dhint);
+
+	Value stackRegs[BYTECODE_STACK_REGISTERS];
+	std::vector<Value> heapRegs;
+	Value *regs = stackRegs;
+
+	if (m_RegisterCount > BYTECODE_STACK_REGISTERS) {
+		heapRegs.resize(m_RegisterCount);
+		regs = &heapRegs[0];
+	}
+
+	size_t pc = 0;
+
+	try {
+		while (pc < m_Code.size()) {
+			const BytecodeInstruction& ins = m_Code[pc];
+			pc++;
+
+			switch (ins.Op) {
+				case OpLoadConstant:
+					regs[ins.Dst] = m_Constants[ins.Src1];
+					break;
+				case OpLoadVariable:
+					regs[ins.Dst] = VMOps::Variable(frame, m_Strings[ins.Src1], m_Sources[pc - 1]->GetDebugInfo());
+					break;
+				case OpLoadScope:
+					if (ins.Src1 == ScopeLocal)
+						regs[ins.Dst] = frame.Locals;
+					else if (ins.Src1 == ScopeThis)
+						regs[ins.Dst] = frame.Self;
+					else
+						regs[ins.Dst] = ScriptGlobal::GetGlobals();
+					break;
+				case OpLoadCallee: {
+					/* see VariableExpression::GetReference() */
+					const String& name = m_Strings[ins.Src1];
+					Value self;
+
+					if (frame.Locals && frame.Locals->Contains(name))
+						self = frame.Locals;
+					else if (frame.Self.IsObject() && frame.Locals != static_cast<Object::Ptr>(frame.Self) && VMOps::HasField(frame.Self, name))
+						self = frame.Self;
+					else if (ScriptGlobal::Exists(name))
+						self = ScriptGlobal::GetGlobals();
+					else
+						self = frame.Self;
+
+					regs[ins.Dst] = VMOps::GetField(self, name, m_Sources[pc - 1]->GetDebugInfo());
+					regs[ins.Dst + 1] = self;
+					break;
+				}
+				case OpGetField: {
+					Value value = VMOps::GetField(regs[ins.Src1], regs[ins.Src2], m_Sources[pc - 1]->GetDebugInfo());
+					regs[ins.Dst] = value;
+					break;
+				}
+				case OpGetFieldConstant: {
+					Value value = VMOps::GetField(regs[ins.Src1], m_Strings[ins.Src2], m_Sources[pc - 1]->GetDebugInfo());
+					regs[ins.Dst] = value;
+					break;
+				}
+				case OpSetLocal:
+					if (frame.Sandboxed)
+						BOOST_THROW_EXCEPTION(ScriptError("Assignments are not allowed in sandbox mode.", m_Sources[pc - 1]->GetDebugInfo()));
+
+					VMOps::SetField(frame.Locals, m_Strings[ins.Src1], regs[ins.Src2], m_Sources[pc - 1]->GetDebugInfo());
+					regs[ins.Dst] = Empty;
+					break;
+				case OpNegate:
+					regs[ins.Dst] = ~(long)regs[ins.Src1];
+					break;
+				case OpLogicalNegate:
+					regs[ins.Dst] = !regs[ins.Src1].ToBool();
+					break;
+				case OpAdd:
+					regs[ins.Dst] = regs[ins.Src1] + regs[ins.Src2];
+					break;
+				case OpSubtract:
+					regs[ins.Dst] = regs[ins.Src1] - regs[ins.Src2];
+					break;
+				case OpMultiply:
+					regs[ins.Dst] = regs[ins.Src1] * regs[ins.Src2];
+					break;
+				case OpDivide:
+					regs[ins.Dst] = regs[ins.Src1] / regs[ins.Src2];
+					break;
+				case OpModulo:
+					regs[ins.Dst] = regs[ins.Src1] % regs[ins.Src2];
+					break;
+				case OpXor:
+					regs[ins.Dst] = regs[ins.Src1] ^ regs[ins.Src2];
+					break;
+				case OpBinaryAnd:
+					regs[ins.Dst] = regs[ins.Src1] & regs[ins.Src2];
+					break;
+				case OpBinaryOr:
+					regs[ins.Dst] = regs[ins.Src1] | regs[ins.Src2];
+					break;
+				case OpShiftLeft:
+					regs[ins.Dst] = regs[ins.Src1] << regs[ins.Src2];
+					break;
+				case OpShiftRight:
+					regs[ins.Dst] = regs[ins.Src1] >> regs[ins.Src2];
+					break;
+				case OpEqual:
+					regs[ins.Dst] = regs[ins.Src1] == regs[ins.Src2];
+					break;
+				case OpNotEqual:
+					regs[ins.Dst] = regs[ins.Src1] != regs[ins.Src2];
+					break;
+				case OpLessThan:
+					regs[ins.Dst] = regs[ins.Src1] < regs[ins.Src2];
+					break;
+				case OpGreaterThan:
+					regs[ins.Dst] = regs[ins.Src1] > regs[ins.Src2];
+					break;
+				case OpLessThanOrEqual:
+					regs[ins.Dst] = regs[ins.Src1] <= regs[ins.Src2];
+					break;
+				case OpGreaterThanOrEqual:
+					regs[ins.Dst] = regs[ins.Src1] >= regs[ins.Src2];
+					break;
+				case OpCheckIn:
+					if (regs[ins.Src1].IsEmpty()) {
+						regs[ins.Dst] = (ins.Src3 != 0);
+						pc = ins.Src2;
+					} else if (!regs[ins.Src1].IsObjectType<Array>())
+						BOOST_THROW_EXCEPTION(ScriptError("Invalid right side argument for 'in' operator: " + JsonEncode(regs[ins.Src1]), m_Sources[pc - 1]->GetDebugInfo()));
+					break;
+				case OpIn: {
+					Array::Ptr arr = regs[ins.Src2];
+					regs[ins.Dst] = arr->Contains(regs[ins.Src1]);
+					break;
+				}
+				case OpNotIn: {
+					Array::Ptr arr = regs[ins.Src2];
+					regs[ins.Dst] = !arr->Contains(regs[ins.Src1]);
+					break;
+				}
+				case OpNewArray: {
+					Array::Ptr result = new Array();
+
+					for (int i = 0; i < ins.Src3; i++)
+						result->Add(regs[ins.Src2 + i]);
+
+					regs[ins.Dst] = result;
+					break;
+				}
+				case OpCheckCall:
+					CheckCall(frame, regs[ins.Src1], ins.Src3, m_Sources[pc - 1]->GetDebugInfo());
+					break;
+				case OpCall:
+					regs[ins.Dst] = Call(frame, regs, ins, m_Sources[pc - 1]->GetDebugInfo());
+					break;
+				case OpJump:
+					pc = ins.Src2;
+					break;
+				case OpJumpIfFalse:
+					if (!regs[ins.Src1].ToBool())
+						pc = ins.Src2;
+					break;
+				case OpJumpIfTrue:
+					if (regs[ins.Src1].ToBool())
+						pc = ins.Src2;
+					break;
+				case OpEvaluate: {
+					ExpressionResult result = m_Fallbacks[ins.Src1]->Evaluate(frame);
+					CHECK_RESULT(result);
+
+					regs[ins.Dst] = result.GetValue();
+					break;
+				}
+				case OpReturn:
+					return ExpressionResult(regs[ins.Src1], ResultReturn);
+				default:
+					VERIFY(!"Invalid opcode.");
+			}
+		}
+	} catch (const ScriptError&) {
+		throw;
+	} catch (const std::exception& ex) {
+		BOOST_THROW_EXCEPTION(ScriptError("Error while evaluating expression: " + String(ex.what()), m_Sources[pc - 1]->GetDebugInfo())
+		    << boost::errinfo_nested_exception(boost::current_exception()));
+	}
+
+	return regs[0];
+}
+
+/**
+ * Checks whether a function or constructor can be called with the specified
+ * number of arguments, see FunctionCallExpression::DoEvaluate().
+ */
+void BytecodeExpression::CheckCall(ScriptFrame& frame, const Value& vfunc, int count, const DebugInfo& debugInfo)
+{
+	if (vfunc.IsObjectType<Type>()) {
+		if (count > 1)
+			BOOST_THROW_EXCEPTION(ScriptError("Too many arguments for constructor.", debugInfo));
+
+		return;
+	}
+
+	if (!vfunc.IsObjectType<Function>())
+		BOOST_THROW_EXCEPTION(ScriptError("Argument is not a callable object.", debugInfo));
+
+	Function::Ptr func = vfunc;
+
+	if (!func->IsSideEffectFree() && frame.Sandboxed)
+		BOOST_THROW_EXCEPTION(ScriptError("Function is not marked as safe for sandbox mode.", debugInfo));
+}
+
+/**
+ * Calls a function or constructor which has been checked by CheckCall().
+ */
+Value BytecodeExpression::Call(ScriptFrame& frame, const Value *regs, const BytecodeInstruction& ins, const DebugInfo& debugInfo)
+{
+	const Value& vfunc = regs[ins.Src1];
+	const Value& self = regs[ins.Src1 + 1];
+
+	if (vfunc.IsObjectType<Type>()) {
+		if (ins.Src3 == 0)
+			return VMOps::ConstructorCall(vfunc, debugInfo);
+		else
+			return VMOps::CopyConstructorCall(vfunc, regs[ins.Src2], debugInfo);
+	}
+
+	Function::Ptr func = vfunc;
+
+	std::vector<Value> arguments(regs + ins.Src2, regs + ins.Src2 + ins.Src3);
+
+	return VMOps::FunctionCall(frame, self, func, arguments);
+}
@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+/* registers up to this count are allocated on the stack */
+#define BYTECODE_STACK_REGISTERS 16
+
+/**
+ * @ingroup config
+ */
+enum BytecodeOp
+{
+	OpLoadConstant,		/**< Dst = constant Src1 */
+	OpLoadVariable,		/**< Dst = variable string Src1 */
+	OpLoadScope,		/**< Dst = scope Src1 */
+	OpLoadCallee,		/**< Dst = function string Src1, Dst + 1 = its "this" value */
+	OpGetField,		/**< Dst = Src1[Src2] */
+	OpGetFieldConstant,	/**< Dst = Src1[string Src2] */
+	OpSetLocal,		/**< locals[string Src1] = Src2, Dst = null */
+	OpNegate,		/**< Dst = ~Src1 */
+	OpLogicalNegate,	/**< Dst = !Src1 */
+	OpAdd,			/**< Dst = Src1 + Src2, the other binary operators work the same way */
+	OpSubtract,
+	OpMultiply,
+	OpDivide,
+	OpModulo,
+	OpXor,
+	OpBinaryAnd,
+	OpBinaryOr,
+	OpShiftLeft,
+	OpShiftRight,
+	OpEqual,
+	OpNotEqual,
+	OpLessThan,
+	OpGreaterThan,
+	OpLessThanOrEqual,
+	OpGreaterThanOrEqual,
+	OpCheckIn,		/**< Dst = Src3 and jump to Src2 if Src1 is null, throws unless Src1 is an array */
+	OpIn,			/**< Dst = Src2 contains Src1 */
+	OpNotIn,		/**< Dst = Src2 doesn't contain Src1 */
+	OpNewArray,		/**< Dst = array of the Src3 registers starting at Src2 */
+	OpCheckCall,		/**< throws unless Src1 can be called with Src3 arguments */
+	OpCall,			/**< Dst = call Src1 with the Src3 arguments starting at Src2 */
+	OpJump,			/**< jump to Src2 */
+	OpJumpIfFalse,		/**< jump to Src2 if Src1 is false */
+	OpJumpIfTrue,		/**< jump to Src2 if Src1 is true */
+	OpEvaluate,		/**< Dst = result of the AST node Src1 */
+	OpReturn		/**< return Src1 */
+};
+
+/**
+ * @ingroup config
+ */
+struct BytecodeInstruction
+{
+	BytecodeOp Op;
+	int Dst;
+	int Src1;
+	int Src2;
+	int Src3;
+};
+
+/**
+ * An expression tree which has been compiled into register-based bytecode.
+ * Nodes the compiler doesn't know about are evaluated as usual by an
+ * OpEvaluate instruction. The node each instruction was generated for is
+ * kept in a side table for error messages.
+ *
+ * @ingroup config
+ */
+class I2_CONFIG_API BytecodeExpression : public Expression
+{
+public:
+	static boost::shared_ptr<Expression> Compile(const boost::shared_ptr<Expression>& expression);
+
+	size_t GetInstructionCount(void) const;
+
+protected:
+	virtual ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const;
+	virtual const DebugInfo& GetDebugInfo(void) const;
+
+private:
+	boost::shared_ptr<Expression> m_Expression;
+	std::vector<BytecodeInstruction> m_Code;
+	std::vector<const Expression *> m_Sources;
+	std::vector<Value> m_Constants;
+	std::vector<String> m_Strings;
+	std::vector<const Expression *> m_Fallbacks;
+	int m_RegisterCount;
+
+	BytecodeExpression(const boost::shared_ptr<Expression>& expression);
+
+	static void CheckCall(ScriptFrame& frame, const Value& vfunc, int count, const DebugInfo& debugInfo);
+	static Value Call(ScriptFrame& frame, const Value *regs, const BytecodeInstruction& ins, const DebugInfo& debugInfo);
+
+	friend class BytecodeCompiler;
+	friend class ConfigCache;
+};
+
+}
+
+#endif /* BYTECODE_H */
@@ -253,8 +253,11 @@ Expression *ConfigCompiler::Compile(void)
 		num++;
 	}
 
-	DictExpression *expr = new DictExpression(dlist);
-	expr->MakeInline();
+	DictExpression *dexpr = new DictExpression(dlist);
+	dexpr->MakeInline();
+
+	Expression *expr = dexpr;
+	OptimizeExpression(expr);
 	return expr;
 }
 
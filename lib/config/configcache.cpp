@@ -0,0 +1,971 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configcache.hpp"
+#include "config/configcompiler.hpp"
+#include "config/bytecode.hpp"
+#include "base/application.hpp"
+#include "base/tlsutility.hpp"
+#include "base/loader.hpp"
+#include "base/utility.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include <boost/foreach.hpp>
+#include <typeinfo>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+
+using namespace icinga;
+
+/* increase this whenever the layout of the cache files changes */
+#define CONFIGCACHE_FORMAT "icinga2-config-cache-1"
+
+String ConfigCache::m_CacheDir;
+
+namespace icinga
+{
+
+enum ConfigCacheNode
+{
+	NodeNull,
+	NodeLiteral,
+	NodeVariable,
+	NodeUnary,
+	NodeBinary,
+	NodeSet,
+	NodeFunctionCall,
+	NodeArray,
+	NodeDict,
+	NodeConditional,
+	NodeWhile,
+	NodeBreak,
+	NodeContinue,
+	NodeGetScope,
+	NodeImport,
+	NodeFunction,
+	NodeApply,
+	NodeObject,
+	NodeFor,
+	NodeInclude
+};
+
+struct ConfigCacheError : public std::runtime_error
+{
+	ConfigCacheError(const String& message)
+		: std::runtime_error(message)
+	{ }
+};
+
+struct ConfigCacheWriter
+{
+	std::string Body;
+	std::map<String, int> StringIndex;
+	std::vector<String> Strings;
+
+	void Write(const void *data, size_t size)
+	{
+		Body.append(static_cast<const char *>(data), size);
+	}
+
+	void WriteInt(int value)
+	{
+		Write(&value, sizeof(value));
+	}
+
+	void WriteBool(bool value)
+	{
+		char ch = value ? 1 : 0;
+		Write(&ch, sizeof(ch));
+	}
+
+	void WriteString(const String& value)
+	{
+		std::map<String, int>::const_iterator it = StringIndex.find(value);
+
+		if (it != StringIndex.end()) {
+			WriteInt(it->second);
+			return;
+		}
+
+		int index = Strings.size();
+		StringIndex[value] = index;
+		Strings.push_back(value);
+		WriteInt(index);
+	}
+
+	void WriteValue(const Value& value)
+	{
+		WriteInt(value.GetType());
+
+		switch (value.GetType()) {
+			case ValueEmpty:
+				break;
+			case ValueNumber: {
+				double number = value;
+				Write(&number, sizeof(number));
+				break;
+			}
+			case ValueBoolean:
+				WriteBool(value.ToBool());
+				break;
+			case ValueString:
+				WriteString(value);
+				break;
+			default:
+				BOOST_THROW_EXCEPTION(ConfigCacheError("Literals of type '" + value.GetTypeName() + "' can't be cached."));
+		}
+	}
+
+	void WriteDebugInfo(const DebugInfo& di)
+	{
+		WriteString(di.Path);
+		WriteInt(di.FirstLine);
+		WriteInt(di.FirstColumn);
+		WriteInt(di.LastLine);
+		WriteInt(di.LastColumn);
+	}
+};
+
+struct ConfigCacheReader
+{
+	const char *Position;
+	const char *End;
+	std::vector<String> Strings;
+
+	ConfigCacheReader(const char *begin, const char *end)
+		: Position(begin), End(end)
+	{ }
+
+	void Read(void *data, size_t size)
+	{
+		if (static_cast<size_t>(End - Position) < size)
+			BOOST_THROW_EXCEPTION(ConfigCacheError("Unexpected end of file."));
+
+		memcpy(data, Position, size);
+		Position += size;
+	}
+
+	int ReadInt(void)
+	{
+		int value;
+		Read(&value, sizeof(value));
+		return value;
+	}
+
+	bool ReadBool(void)
+	{
+		char ch;
+		Read(&ch, sizeof(ch));
+		return ch != 0;
+	}
+
+	String ReadRawString(void)
+	{
+		int length = ReadInt();
+
+		if (length < 0 || End - Position < length)
+			BOOST_THROW_EXCEPTION(ConfigCacheError("Unexpected end of file."));
+
+		String value(Position, Position + length);
+		Position += length;
+		return value;
+	}
+
+	String ReadString(void)
+	{
+		int index = ReadInt();
+
+		if (index < 0 || static_cast<size_t>(index) >= Strings.size())
+			BOOST_THROW_EXCEPTION(ConfigCacheError("Invalid string index."));
+
+		return Strings[index];
+	}
+
+	Value ReadValue(void)
+	{
+		switch (ReadInt()) {
+			case ValueEmpty:
+				return Empty;
+			case ValueNumber: {
+				double number;
+				Read(&number, sizeof(number));
+				return number;
+			}
+			case ValueBoolean:
+				return ReadBool();
+			case ValueString:
+				return ReadString();
+			default:
+				BOOST_THROW_EXCEPTION(ConfigCacheError("Invalid literal type."));
+		}
+	}
+
+	DebugInfo ReadDebugInfo(void)
+	{
+		DebugInfo di;
+		di.Path = ReadString();
+		di.FirstLine = ReadInt();
+		di.FirstColumn = ReadInt();
+		di.LastLine = ReadInt();
+		di.LastColumn = ReadInt();
+		return di;
+	}
+};
+
+}
+
+static void WriteRawString(std::ostream& fp, const String& value)
+{
+	int length = value.GetLength();
+	fp.write(reinterpret_cast<const char *>(&length), sizeof(length));
+	fp.write(value.CStr(), length);
+}
+
+/**
+ * Owns the expressions which have been read for a node until the node
+ * itself has been constructed, so that they're freed when reading the
+ * node fails.
+ */
+struct ConfigCacheGuard
+{
+	std::vector<Expression *> Expressions;
+	std::vector<std::map<String, Expression *> *> ClosedVars;
+
+	~ConfigCacheGuard(void)
+	{
+		BOOST_FOREACH(Expression *expr, Expressions)
+			delete expr;
+
+		typedef std::map<String, Expression *> ClosedVarMap;
+		BOOST_FOREACH(ClosedVarMap *closedVars, ClosedVars) {
+			typedef std::pair<String, Expression *> ClosedVar;
+			BOOST_FOREACH(const ClosedVar& kv, *closedVars)
+				delete kv.second;
+
+			delete closedVars;
+		}
+	}
+
+	Expression *Add(Expression *expr)
+	{
+		Expressions.push_back(expr);
+		return expr;
+	}
+
+	std::map<String, Expression *> *Add(std::map<String, Expression *> *closedVars)
+	{
+		if (closedVars)
+			ClosedVars.push_back(closedVars);
+
+		return closedVars;
+	}
+
+	void Release(void)
+	{
+		Expressions.clear();
+		ClosedVars.clear();
+	}
+};
+
+template<typename T>
+static Expression *NewUnaryExpression(Expression *operand, const DebugInfo& debugInfo)
+{
+	return new T(operand, debugInfo);
+}
+
+template<typename T>
+static Expression *NewBinaryExpression(Expression *operand1, Expression *operand2, const DebugInfo& debugInfo)
+{
+	return new T(operand1, operand2, debugInfo);
+}
+
+struct UnaryNodeType
+{
+	const std::type_info *Type;
+	Expression *(*Factory)(Expression *, const DebugInfo&);
+};
+
+struct BinaryNodeType
+{
+	const std::type_info *Type;
+	Expression *(*Factory)(Expression *, Expression *, const DebugInfo&);
+};
+
+#define UNARY_NODE(name) { &typeid(name), &NewUnaryExpression<name> }
+#define BINARY_NODE(name) { &typeid(name), &NewBinaryExpression<name> }
+
+/* The index in these tables is part of the file format, new entries have to
+ * be added at the end. */
+static const UnaryNodeType l_UnaryNodes[] = {
+	UNARY_NODE(NegateExpression),
+	UNARY_NODE(LogicalNegateExpression),
+	UNARY_NODE(ReturnExpression)
+};
+
+static const BinaryNodeType l_BinaryNodes[] = {
+	BINARY_NODE(AddExpression),
+	BINARY_NODE(SubtractExpression),
+	BINARY_NODE(MultiplyExpression),
+	BINARY_NODE(DivideExpression),
+	BINARY_NODE(ModuloExpression),
+	BINARY_NODE(XorExpression),
+	BINARY_NODE(BinaryAndExpression),
+	BINARY_NODE(BinaryOrExpression),
+	BINARY_NODE(ShiftLeftExpression),
+	BINARY_NODE(ShiftRightExpression),
+	BINARY_NODE(EqualExpression),
+	BINARY_NODE(NotEqualExpression),
+	BINARY_NODE(LessThanExpression),
+	BINARY_NODE(GreaterThanExpression),
+	BINARY_NODE(LessThanOrEqualExpression),
+	BINARY_NODE(GreaterThanOrEqualExpression),
+	BINARY_NODE(InExpression),
+	BINARY_NODE(NotInExpression),
+	BINARY_NODE(LogicalAndExpression),
+	BINARY_NODE(LogicalOrExpression),
+	BINARY_NODE(IndexerExpression)
+};
+
+void ConfigCache::SetCacheDir(const String& dir)
+{
+	m_CacheDir = dir;
+}
+
+/**
+ * Retrieves the directory for the cache files. An empty string means that
+ * the cache is disabled.
+ *
+ * @returns The directory.
+ */
+String ConfigCache::GetCacheDir(void)
+{
+	return m_CacheDir;
+}
+
+/**
+ * Calculates the key a cache file has to match in order to be used for
+ * the specified config file.
+ *
+ * @param path The path of the config file.
+ * @param zone The zone.
+ * @param text The content of the config file.
+ * @returns The key.
+ */
+String ConfigCache::GetKey(const String& path, const String& zone, const String& text)
+{
+	return SHA256(String(CONFIGCACHE_FORMAT "\n") + Application::GetVersion() + "\n" + path + "\n" + zone + "\n" + text);
+}
+
+String ConfigCache::GetCachePath(const String& path, const String& zone)
+{
+	return m_CacheDir + "/" + SHA256(path + "\n" + zone) + ".cache";
+}
+
+/**
+ * Loads the expression tree for a config file from the cache.
+ *
+ * @param path The path of the config file.
+ * @param zone The zone.
+ * @param key The key for the file's current content.
+ * @returns The expression or NULL if there's no usable cache file.
+ */
+Expression *ConfigCache::Load(const String& path, const String& zone, const String& key)
+{
+	String cachePath = GetCachePath(path, zone);
+
+	std::ifstream fp(cachePath.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp)
+		return NULL;
+
+	std::ostringstream databuf;
+	databuf << fp.rdbuf();
+	std::string data = databuf.str();
+
+	ConfigCacheReader reader(data.c_str(), data.c_str() + data.size());
+	std::vector<String> libraries;
+
+	try {
+		if (reader.ReadRawString() != CONFIGCACHE_FORMAT || reader.ReadRawString() != key)
+			return NULL;
+
+		int count = reader.ReadInt();
+
+		for (int i = 0; i < count; i++)
+			libraries.push_back(reader.ReadRawString());
+
+		count = reader.ReadInt();
+
+		for (int i = 0; i < count; i++)
+			reader.Strings.push_back(reader.ReadRawString());
+	} catch (const ConfigCacheError& ex) {
+		Log(LogWarning, "ConfigCache")
+		    << "Ignoring invalid config cache file '" << cachePath << "': " << ex.what();
+		return NULL;
+	}
+
+	BOOST_FOREACH(const String& library, libraries)
+		Loader::LoadExtensionLibrary(library);
+
+	try {
+		Expression *expr = ReadExpression(reader);
+
+		Log(LogDebug, "ConfigCache")
+		    << "Using cached expression tree for config file '" << path << "'";
+
+		return expr;
+	} catch (const ConfigCacheError& ex) {
+		Log(LogWarning, "ConfigCache")
+		    << "Ignoring invalid config cache file '" << cachePath << "': " << ex.what();
+		return NULL;
+	}
+}
+
+/**
+ * Stores the expression tree for a config file in the cache. Errors are
+ * logged and otherwise ignored.
+ *
+ * @param path The path of the config file.
+ * @param zone The zone.
+ * @param key The key for the file's content.
+ * @param libraries The libraries which were loaded by the file.
+ * @param expression The expression.
+ */
+void ConfigCache::Store(const String& path, const String& zone, const String& key,
+    const std::vector<String>& libraries, const Expression *expression)
+{
+	ConfigCacheWriter writer;
+
+	try {
+		WriteExpression(writer, expression);
+	} catch (const ConfigCacheError& ex) {
+		Log(LogDebug, "ConfigCache")
+		    << "Not caching config file '" << path << "': " << ex.what();
+		return;
+	}
+
+	if (!Utility::MkDirP(m_CacheDir, 0750)) {
+		Log(LogNotice, "ConfigCache")
+		    << "Could not create config cache directory '" << m_CacheDir << "'";
+		return;
+	}
+
+	String cachePath = GetCachePath(path, zone);
+	String tempPath = cachePath + "." + Utility::NewUniqueID() + ".tmp";
+
+	std::ofstream fp(tempPath.CStr(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+	WriteRawString(fp, CONFIGCACHE_FORMAT);
+	WriteRawString(fp, key);
+
+	int count = libraries.size();
+	fp.write(reinterpret_cast<const char *>(&count), sizeof(count));
+
+	BOOST_FOREACH(const String& library, libraries)
+		WriteRawString(fp, library);
+
+	count = writer.Strings.size();
+	fp.write(reinterpret_cast<const char *>(&count), sizeof(count));
+
+	BOOST_FOREACH(const String& str, writer.Strings)
+		WriteRawString(fp, str);
+
+	fp.write(writer.Body.c_str(), writer.Body.size());
+	fp.close();
+
+	if (fp.fail()) {
+		Log(LogNotice, "ConfigCache")
+		    << "Could not write config cache file '" << tempPath << "'";
+		(void) unlink(tempPath.CStr());
+		return;
+	}
+
+#ifdef _WIN32
+	_unlink(cachePath.CStr());
+#endif /* _WIN32 */
+
+	if (rename(tempPath.CStr(), cachePath.CStr()) < 0) {
+		Log(LogNotice, "ConfigCache")
+		    << "Could not rename config cache file '" << tempPath << "' to '" << cachePath << "'";
+		(void) unlink(tempPath.CStr());
+	}
+}
+
+void ConfigCache::WriteClosedVars(ConfigCacheWriter& writer, const std::map<String, Expression *> *closedVars)
+{
+	if (!closedVars) {
+		writer.WriteInt(-1);
+		return;
+	}
+
+	writer.WriteInt(closedVars->size());
+
+	typedef std::pair<String, Expression *> ClosedVar;
+	BOOST_FOREACH(const ClosedVar& kv, *closedVars) {
+		writer.WriteString(kv.first);
+		WriteExpression(writer, kv.second);
+	}
+}
+
+std::map<String, Expression *> *ConfigCache::ReadClosedVars(ConfigCacheReader& reader)
+{
+	int count = reader.ReadInt();
+
+	if (count < 0)
+		return NULL;
+
+	ConfigCacheGuard guard;
+	std::map<String, Expression *> *closedVars = guard.Add(new std::map<String, Expression *>());
+
+	for (int i = 0; i < count; i++) {
+		String name = reader.ReadString();
+		Expression *expr = ReadExpression(reader);
+		delete (*closedVars)[name];
+		(*closedVars)[name] = expr;
+	}
+
+	guard.Release();
+
+	return closedVars;
+}
+
+void ConfigCache::WriteExpression(ConfigCacheWriter& writer, const Expression *expression)
+{
+	if (!expression) {
+		writer.WriteInt(NodeNull);
+		return;
+	}
+
+	const std::type_info& type = typeid(*expression);
+	const DebugInfo& di = expression->GetDebugInfo();
+
+	if (type == typeid(LiteralExpression)) {
+		writer.WriteInt(NodeLiteral);
+		writer.WriteValue(static_cast<const LiteralExpression *>(expression)->GetValue());
+		return;
+	}
+
+	if (type == typeid(VariableExpression)) {
+		writer.WriteInt(NodeVariable);
+		writer.WriteString(static_cast<const VariableExpression *>(expression)->GetVariable());
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	for (size_t i = 0; i < sizeof(l_UnaryNodes) / sizeof(l_UnaryNodes[0]); i++) {
+		if (type != *l_UnaryNodes[i].Type)
+			continue;
+
+		writer.WriteInt(NodeUnary);
+		writer.WriteInt(i);
+		WriteExpression(writer, static_cast<const UnaryExpression *>(expression)->GetOperand());
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	for (size_t i = 0; i < sizeof(l_BinaryNodes) / sizeof(l_BinaryNodes[0]); i++) {
+		if (type != *l_BinaryNodes[i].Type)
+			continue;
+
+		const BinaryExpression *bexpr = static_cast<const BinaryExpression *>(expression);
+		writer.WriteInt(NodeBinary);
+		writer.WriteInt(i);
+		WriteExpression(writer, bexpr->GetOperand1());
+		WriteExpression(writer, bexpr->GetOperand2());
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(SetExpression)) {
+		const SetExpression *sexpr = static_cast<const SetExpression *>(expression);
+		writer.WriteInt(NodeSet);
+		writer.WriteInt(sexpr->m_Op);
+		WriteExpression(writer, sexpr->GetOperand1());
+		WriteExpression(writer, sexpr->GetOperand2());
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(FunctionCallExpression)) {
+		const FunctionCallExpression *fexpr = static_cast<const FunctionCallExpression *>(expression);
+		writer.WriteInt(NodeFunctionCall);
+		WriteExpression(writer, fexpr->m_FName);
+		writer.WriteInt(fexpr->m_Args.size());
+
+		BOOST_FOREACH(const Expression *arg, fexpr->m_Args)
+			WriteExpression(writer, arg);
+
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(ArrayExpression)) {
+		const ArrayExpression *aexpr = static_cast<const ArrayExpression *>(expression);
+		writer.WriteInt(NodeArray);
+		writer.WriteInt(aexpr->m_Expressions.size());
+
+		BOOST_FOREACH(const Expression *element, aexpr->m_Expressions)
+			WriteExpression(writer, element);
+
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(DictExpression)) {
+		const DictExpression *dexpr = static_cast<const DictExpression *>(expression);
+		writer.WriteInt(NodeDict);
+		writer.WriteBool(dexpr->m_Inline);
+		writer.WriteInt(dexpr->m_Expressions.size());
+
+		BOOST_FOREACH(const Expression *element, dexpr->m_Expressions)
+			WriteExpression(writer, element);
+
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(ConditionalExpression)) {
+		const ConditionalExpression *cexpr = static_cast<const ConditionalExpression *>(expression);
+		writer.WriteInt(NodeConditional);
+		WriteExpression(writer, cexpr->m_Condition);
+		WriteExpression(writer, cexpr->m_TrueBranch);
+		WriteExpression(writer, cexpr->m_FalseBranch);
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(WhileExpression)) {
+		const WhileExpression *wexpr = static_cast<const WhileExpression *>(expression);
+		writer.WriteInt(NodeWhile);
+		WriteExpression(writer, wexpr->m_Condition);
+		WriteExpression(writer, wexpr->m_LoopBody);
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(BreakExpression)) {
+		writer.WriteInt(NodeBreak);
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(ContinueExpression)) {
+		writer.WriteInt(NodeContinue);
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(GetScopeExpression)) {
+		writer.WriteInt(NodeGetScope);
+		writer.WriteInt(static_cast<const GetScopeExpression *>(expression)->m_ScopeSpec);
+		return;
+	}
+
+	if (type == typeid(ImportExpression)) {
+		writer.WriteInt(NodeImport);
+		WriteExpression(writer, static_cast<const ImportExpression *>(expression)->m_Name);
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(FunctionExpression)) {
+		const FunctionExpression *fexpr = static_cast<const FunctionExpression *>(expression);
+		writer.WriteInt(NodeFunction);
+		writer.WriteInt(fexpr->m_Args.size());
+
+		BOOST_FOREACH(const String& arg, fexpr->m_Args)
+			writer.WriteString(arg);
+
+		WriteClosedVars(writer, fexpr->m_ClosedVars);
+
+		/* The body is compiled again when the function is loaded. */
+		const BytecodeExpression *body = dynamic_cast<const BytecodeExpression *>(fexpr->m_Expression.get());
+
+		if (body)
+			WriteExpression(writer, body->m_Expression.get());
+		else
+			WriteExpression(writer, fexpr->m_Expression.get());
+
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(ApplyExpression)) {
+		const ApplyExpression *aexpr = static_cast<const ApplyExpression *>(expression);
+		writer.WriteInt(NodeApply);
+		writer.WriteString(aexpr->m_Type);
+		writer.WriteString(aexpr->m_Target);
+		WriteExpression(writer, aexpr->m_Name);
+		WriteExpression(writer, aexpr->m_Filter.get());
+		writer.WriteString(aexpr->m_FKVar);
+		writer.WriteString(aexpr->m_FVVar);
+		WriteExpression(writer, aexpr->m_FTerm.get());
+		WriteClosedVars(writer, aexpr->m_ClosedVars);
+		WriteExpression(writer, aexpr->m_Expression.get());
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(ObjectExpression)) {
+		const ObjectExpression *oexpr = static_cast<const ObjectExpression *>(expression);
+		writer.WriteInt(NodeObject);
+		writer.WriteBool(oexpr->m_Abstract);
+		writer.WriteString(oexpr->m_Type);
+		WriteExpression(writer, oexpr->m_Name);
+		WriteExpression(writer, oexpr->m_Filter.get());
+		writer.WriteString(oexpr->m_Zone);
+		WriteClosedVars(writer, oexpr->m_ClosedVars);
+		WriteExpression(writer, oexpr->m_Expression.get());
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(ForExpression)) {
+		const ForExpression *fexpr = static_cast<const ForExpression *>(expression);
+		writer.WriteInt(NodeFor);
+		writer.WriteString(fexpr->m_FKVar);
+		writer.WriteString(fexpr->m_FVVar);
+		WriteExpression(writer, fexpr->m_Value);
+		WriteExpression(writer, fexpr->m_Expression);
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	if (type == typeid(IncludeExpression)) {
+		const IncludeExpression *iexpr = static_cast<const IncludeExpression *>(expression);
+		writer.WriteInt(NodeInclude);
+		writer.WriteString(iexpr->m_RelativeBase);
+		writer.WriteString(iexpr->m_Path);
+		writer.WriteString(iexpr->m_Pattern);
+		writer.WriteBool(iexpr->m_Search);
+		writer.WriteString(iexpr->m_Zone);
+		writer.WriteDebugInfo(di);
+		return;
+	}
+
+	BOOST_THROW_EXCEPTION(ConfigCacheError("Expressions of type '" + Utility::GetTypeName(type) + "' can't be cached."));
+}
+
+Expression *ConfigCache::ReadExpression(ConfigCacheReader& reader)
+{
+	int node = reader.ReadInt();
+
+	switch (node) {
+		case NodeNull:
+			return NULL;
+
+		case NodeLiteral:
+			return MakeLiteral(reader.ReadValue());
+
+		case NodeVariable: {
+			String name = reader.ReadString();
+			return new VariableExpression(name, reader.ReadDebugInfo());
+		}
+
+		case NodeUnary: {
+			int index = reader.ReadInt();
+
+			if (index < 0 || static_cast<size_t>(index) >= sizeof(l_UnaryNodes) / sizeof(l_UnaryNodes[0]))
+				BOOST_THROW_EXCEPTION(ConfigCacheError("Invalid unary expression type."));
+
+			ConfigCacheGuard guard;
+			Expression *operand = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return l_UnaryNodes[index].Factory(operand, di);
+		}
+
+		case NodeBinary: {
+			int index = reader.ReadInt();
+
+			if (index < 0 || static_cast<size_t>(index) >= sizeof(l_BinaryNodes) / sizeof(l_BinaryNodes[0]))
+				BOOST_THROW_EXCEPTION(ConfigCacheError("Invalid binary expression type."));
+
+			ConfigCacheGuard guard;
+			Expression *operand1 = guard.Add(ReadExpression(reader));
+			Expression *operand2 = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return l_BinaryNodes[index].Factory(operand1, operand2, di);
+		}
+
+		case NodeSet: {
+			CombinedSetOp op = static_cast<CombinedSetOp>(reader.ReadInt());
+			ConfigCacheGuard guard;
+			Expression *operand1 = guard.Add(ReadExpression(reader));
+			Expression *operand2 = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new SetExpression(operand1, op, operand2, di);
+		}
+
+		case NodeFunctionCall: {
+			ConfigCacheGuard guard;
+			Expression *fname = guard.Add(ReadExpression(reader));
+			std::vector<Expression *> args;
+			int count = reader.ReadInt();
+
+			for (int i = 0; i < count; i++)
+				args.push_back(guard.Add(ReadExpression(reader)));
+
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new FunctionCallExpression(fname, args, di);
+		}
+
+		case NodeArray:
+		case NodeDict: {
+			bool isInline = (node == NodeDict) ? reader.ReadBool() : false;
+			ConfigCacheGuard guard;
+			std::vector<Expression *> expressions;
+			int count = reader.ReadInt();
+
+			for (int i = 0; i < count; i++)
+				expressions.push_back(guard.Add(ReadExpression(reader)));
+
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+
+			if (node == NodeArray)
+				return new ArrayExpression(expressions, di);
+
+			DictExpression *dexpr = new DictExpression(expressions, di);
+
+			if (isInline)
+				dexpr->MakeInline();
+
+			return dexpr;
+		}
+
+		case NodeConditional: {
+			ConfigCacheGuard guard;
+			Expression *condition = guard.Add(ReadExpression(reader));
+			Expression *trueBranch = guard.Add(ReadExpression(reader));
+			Expression *falseBranch = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new ConditionalExpression(condition, trueBranch, falseBranch, di);
+		}
+
+		case NodeWhile: {
+			ConfigCacheGuard guard;
+			Expression *condition = guard.Add(ReadExpression(reader));
+			Expression *body = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new WhileExpression(condition, body, di);
+		}
+
+		case NodeBreak:
+			return new BreakExpression(reader.ReadDebugInfo());
+
+		case NodeContinue:
+			return new ContinueExpression(reader.ReadDebugInfo());
+
+		case NodeGetScope:
+			return new GetScopeExpression(static_cast<ScopeSpecifier>(reader.ReadInt()));
+
+		case NodeImport: {
+			ConfigCacheGuard guard;
+			Expression *name = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new ImportExpression(name, di);
+		}
+
+		case NodeFunction: {
+			std::vector<String> args;
+			int count = reader.ReadInt();
+
+			for (int i = 0; i < count; i++)
+				args.push_back(reader.ReadString());
+
+			ConfigCacheGuard guard;
+			std::map<String, Expression *> *closedVars = guard.Add(ReadClosedVars(reader));
+			Expression *body = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new FunctionExpression(args, closedVars, body, di);
+		}
+
+		case NodeApply: {
+			String type = reader.ReadString();
+			String target = reader.ReadString();
+			ConfigCacheGuard guard;
+			Expression *name = guard.Add(ReadExpression(reader));
+			Expression *filter = guard.Add(ReadExpression(reader));
+			String fkvar = reader.ReadString();
+			String fvvar = reader.ReadString();
+			Expression *fterm = guard.Add(ReadExpression(reader));
+			std::map<String, Expression *> *closedVars = guard.Add(ReadClosedVars(reader));
+			Expression *expression = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new ApplyExpression(type, target, name, filter, fkvar, fvvar, fterm,
+			    closedVars, expression, di);
+		}
+
+		case NodeObject: {
+			bool abstract = reader.ReadBool();
+			String type = reader.ReadString();
+			ConfigCacheGuard guard;
+			Expression *name = guard.Add(ReadExpression(reader));
+			Expression *filter = guard.Add(ReadExpression(reader));
+			String zone = reader.ReadString();
+			std::map<String, Expression *> *closedVars = guard.Add(ReadClosedVars(reader));
+			Expression *expression = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new ObjectExpression(abstract, type, name, filter, zone,
+			    closedVars, expression, di);
+		}
+
+		case NodeFor: {
+			String fkvar = reader.ReadString();
+			String fvvar = reader.ReadString();
+			ConfigCacheGuard guard;
+			Expression *value = guard.Add(ReadExpression(reader));
+			Expression *expression = guard.Add(ReadExpression(reader));
+			DebugInfo di = reader.ReadDebugInfo();
+			guard.Release();
+			return new ForExpression(fkvar, fvvar, value, expression, di);
+		}
+
+		case NodeInclude: {
+			String relativeBase = reader.ReadString();
+			String path = reader.ReadString();
+			String pattern = reader.ReadString();
+			bool search = reader.ReadBool();
+			String zone = reader.ReadString();
+			DebugInfo di = reader.ReadDebugInfo();
+
+			/* Include directives are resolved again so that added or
+			 * removed files are noticed. */
+			if (pattern.IsEmpty())
+				return ConfigCompiler::IncludeFiles(relativeBase, path, search, zone, di);
+			else
+				return ConfigCompiler::IncludeFilesRecursive(relativeBase, path, pattern, zone, di);
+		}
+
+		default:
+			BOOST_THROW_EXCEPTION(ConfigCacheError("Invalid expression type."));
+	}
+}
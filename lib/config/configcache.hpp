@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+struct ConfigCacheWriter;
+struct ConfigCacheReader;
+
+/**
+ * Persistent cache for compiled config files. Each file's expression tree
+ * is stored in a compact binary form together with a key which covers the
+ * file's content. Include and library directives are stored unresolved
+ * and are processed again when the tree is loaded.
+ *
+ * @ingroup config
+ */
+class I2_CONFIG_API ConfigCache
+{
+public:
+	static void SetCacheDir(const String& dir);
+	static String GetCacheDir(void);
+
+	static String GetKey(const String& path, const String& zone, const String& text);
+
+	static Expression *Load(const String& path, const String& zone, const String& key);
+	static void Store(const String& path, const String& zone, const String& key,
+	    const std::vector<String>& libraries, const Expression *expression);
+
+private:
+	static String m_CacheDir;
+
+	ConfigCache(void);
+
+	static String GetCachePath(const String& path, const String& zone);
+
+	static void WriteExpression(ConfigCacheWriter& writer, const Expression *expression);
+	static Expression *ReadExpression(ConfigCacheReader& reader);
+	static void WriteClosedVars(ConfigCacheWriter& writer, const std::map<String, Expression *> *closedVars);
+	static std::map<String, Expression *> *ReadClosedVars(ConfigCacheReader& reader);
+};
+
+}
+
+#endif /* CONFIGCACHE_H */
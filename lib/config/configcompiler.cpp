@@ -19,12 +19,14 @@
 
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
+#include "config/configcache.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/loader.hpp"
 #include "base/context.hpp"
 #include "base/exception.hpp"
 #include <fstream>
+#include <sstream>
 #include <boost/foreach.hpp>
 
 using namespace icinga;
@@ -40,7 +42,7 @@ std::vector<String> ConfigCompiler::m_IncludeSearchDirs;
  * @param zone The zone.
  */
 ConfigCompiler::ConfigCompiler(const String& path, std::istream *input, const String& zone)
-	: m_Path(path), m_Input(input), m_Zone(zone), m_Eof(false), m_OpenBraces(0), m_IgnoreNewlines(0)
+	: m_Path(path), m_Input(input), m_Zone(zone), m_UseCache(false), m_Eof(false), m_OpenBraces(0), m_IgnoreNewlines(0)
 {
 	InitializeScanner();
 }
@@ -110,13 +112,40 @@ void ConfigCompiler::CollectIncludes(std::vector<Expression *>& expressions, con
  * @param debuginfo Debug information.
  */
 Expression *ConfigCompiler::HandleInclude(const String& include, bool search, const DebugInfo& debuginfo)
+{
+	return IncludeFiles(GetPath(), include, search, m_Zone, debuginfo);
+}
+
+/**
+ * Handles recursive includes.
+ *
+ * @param path The directory path.
+ * @param pattern The file pattern.
+ * @param debuginfo Debug information.
+ */
+Expression *ConfigCompiler::HandleIncludeRecursive(const String& path, const String& pattern, const DebugInfo& debuginfo)
+{
+	return IncludeFilesRecursive(GetPath(), path, pattern, m_Zone, debuginfo);
+}
+
+/**
+ * Compiles the files matched by an include directive.
+ *
+ * @param relativeBase The path of the file which contains the directive.
+ * @param include The path from the include directive.
+ * @param search Whether to search global include dirs.
+ * @param zone The zone.
+ * @param debuginfo Debug information.
+ */
+Expression *ConfigCompiler::IncludeFiles(const String& relativeBase, const String& include, bool search,
+    const String& zone, const DebugInfo& debuginfo)
 {
 	String path;
 
 	if (search || (include.GetLength() > 0 && include[0] == '/'))
 		path = include;
 	else
-		path = Utility::DirName(GetPath()) + "/" + include;
+		path = Utility::DirName(relativeBase) + "/" + include;
 
 	String includePath = path;
 
@@ -133,7 +162,7 @@ Expression *ConfigCompiler::HandleInclude(const String& include, bool search, co
 
 	std::vector<Expression *> expressions;
 
-	if (!Utility::Glob(includePath, boost::bind(&ConfigCompiler::CollectIncludes, boost::ref(expressions), _1, m_Zone), GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
+	if (!Utility::Glob(includePath, boost::bind(&ConfigCompiler::CollectIncludes, boost::ref(expressions), _1, zone), GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
 		std::ostringstream msgbuf;
 		msgbuf << "Include file '" + include + "' does not exist";
 		BOOST_THROW_EXCEPTION(ScriptError(msgbuf.str(), debuginfo));
@@ -141,28 +170,36 @@ Expression *ConfigCompiler::HandleInclude(const String& include, bool search, co
 
 	DictExpression *expr = new DictExpression(expressions);
 	expr->MakeInline();
-	return expr;
+	return new IncludeExpression(relativeBase, include, String(), search, zone, expr, debuginfo);
 }
 
 /**
- * Handles recursive includes.
+ * Compiles the files matched by a recursive include directive.
  *
+ * @param relativeBase The path of the file which contains the directive.
  * @param path The directory path.
  * @param pattern The file pattern.
+ * @param zone The zone.
  * @param debuginfo Debug information.
  */
-Expression *ConfigCompiler::HandleIncludeRecursive(const String& path, const String& pattern, const DebugInfo&)
+Expression *ConfigCompiler::IncludeFilesRecursive(const String& relativeBase, const String& path, const String& pattern,
+    const String& zone, const DebugInfo& debuginfo)
 {
 	String ppath;
 
 	if (path.GetLength() > 0 && path[0] == '/')
 		ppath = path;
 	else
-		ppath = Utility::DirName(GetPath()) + "/" + path;
+		ppath = Utility::DirName(relativeBase) + "/" + path;
 
 	std::vector<Expression *> expressions;
-	Utility::GlobRecursive(ppath, pattern, boost::bind(&ConfigCompiler::CollectIncludes, boost::ref(expressions), _1, m_Zone), GlobFile);
-	return new DictExpression(expressions);
+	Utility::GlobRecursive(ppath, pattern, boost::bind(&ConfigCompiler::CollectIncludes, boost::ref(expressions), _1, zone), GlobFile);
+	return new IncludeExpression(relativeBase, path, pattern, false, zone, new DictExpression(expressions), debuginfo);
+}
+
+ExpressionResult IncludeExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
+{
+	return m_Expression->Evaluate(frame, dhint);
 }
 
 /**
@@ -173,12 +210,45 @@ Expression *ConfigCompiler::HandleIncludeRecursive(const String& path, const Str
 void ConfigCompiler::HandleLibrary(const String& library)
 {
 	Loader::LoadExtensionLibrary(library);
+	m_Libraries.push_back(library);
+}
+
+/**
+ * Compiles the input. Files are loaded from the config cache instead if
+ * they haven't changed since they were last compiled.
+ *
+ * @returns The expression.
+ */
+Expression *ConfigCompiler::CompileInput(void)
+{
+	if (!m_UseCache)
+		return Compile();
+
+	std::ostringstream textbuf;
+	textbuf << m_Input->rdbuf();
+	String text = textbuf.str();
+
+	String key = ConfigCache::GetKey(m_Path, m_Zone, text);
+	Expression *expr = ConfigCache::Load(m_Path, m_Zone, key);
+
+	if (expr)
+		return expr;
+
+	delete m_Input;
+	m_Input = new std::istringstream(text);
+
+	expr = Compile();
+
+	if (expr)
+		ConfigCache::Store(m_Path, m_Zone, key, m_Libraries, expr);
+
+	return expr;
 }
 
 void ConfigCompiler::CompileHelper(void)
 {
 	try {
-		m_Promise.set_value(boost::shared_ptr<Expression>(Compile()));
+		m_Promise.set_value(boost::shared_ptr<Expression>(CompileInput()));
 	} catch (...) {
 		m_Promise.set_exception(boost::current_exception());
 	}
@@ -200,7 +270,11 @@ Expression *ConfigCompiler::CompileStream(const String& path, std::istream *stre
 	stream->exceptions(std::istream::badbit);
 
 	ConfigCompiler* ctx = new ConfigCompiler(path, stream, zone);
+	return CompileContext(ctx, async);
+}
 
+Expression *ConfigCompiler::CompileContext(ConfigCompiler *ctx, bool async)
+{
 	if (async) {
 		boost::shared_future<boost::shared_ptr<Expression> > ftr = boost::shared_future<boost::shared_ptr<Expression> >(ctx->m_Promise.get_future());
 
@@ -210,7 +284,7 @@ Expression *ConfigCompiler::CompileStream(const String& path, std::istream *stre
 		Expression *expr;
 
 		try {
-			expr = ctx->Compile();
+			expr = ctx->CompileInput();
 		} catch (...) {
 			delete ctx;
 			throw;
@@ -243,7 +317,14 @@ Expression *ConfigCompiler::CompileFile(const String& path, bool async, const St
 	Log(LogInformation, "ConfigCompiler")
 	    << "Compiling config file: " << path;
 
-	return CompileStream(path, stream, async, zone);
+	if (ConfigCache::GetCacheDir().IsEmpty())
+		return CompileStream(path, stream, async, zone);
+
+	stream->exceptions(std::istream::badbit);
+
+	ConfigCompiler *ctx = new ConfigCompiler(path, stream, zone);
+	ctx->m_UseCache = true;
+	return CompileContext(ctx, async);
 }
 
 /**
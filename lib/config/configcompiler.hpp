@@ -64,6 +64,40 @@ struct EItemInfo
 	CompilerDebugInfo DebugInfo;
 };
 
+/**
+ * The expressions for the files which were matched by an include
+ * directive. The directive itself is kept for the config cache.
+ *
+ * @ingroup config
+ */
+class I2_CONFIG_API IncludeExpression : public DebuggableExpression
+{
+public:
+	IncludeExpression(const String& relativeBase, const String& path, const String& pattern,
+	    bool search, const String& zone, Expression *expression, const DebugInfo& debugInfo = DebugInfo())
+		: DebuggableExpression(debugInfo), m_RelativeBase(relativeBase), m_Path(path),
+		  m_Pattern(pattern), m_Search(search), m_Zone(zone), m_Expression(expression)
+	{ }
+
+	~IncludeExpression(void)
+	{
+		delete m_Expression;
+	}
+
+protected:
+	virtual ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const;
+
+private:
+	String m_RelativeBase;
+	String m_Path;
+	String m_Pattern;
+	bool m_Search;
+	String m_Zone;
+	Expression *m_Expression;
+
+	friend class ConfigCache;
+};
+
 /**
  * The configuration compiler can be used to compile a configuration file
  * into a number of configuration items.
@@ -96,6 +130,11 @@ public:
 	Expression *HandleIncludeRecursive(const String& path, const String& pattern, const DebugInfo& debuginfo = DebugInfo());
 	void HandleLibrary(const String& library);
 
+	static Expression *IncludeFiles(const String& relativeBase, const String& include, bool search,
+	    const String& zone, const DebugInfo& debuginfo = DebugInfo());
+	static Expression *IncludeFilesRecursive(const String& relativeBase, const String& path, const String& pattern,
+	    const String& zone, const DebugInfo& debuginfo = DebugInfo());
+
 	size_t ReadInput(char *buffer, size_t max_bytes);
 	void *GetScanner(void) const;
 
@@ -105,6 +144,8 @@ private:
 	String m_Path;
 	std::istream *m_Input;
 	String m_Zone;
+	bool m_UseCache;
+	std::vector<String> m_Libraries;
 
 	void *m_Scanner;
 
@@ -113,6 +154,8 @@ private:
 	void InitializeScanner(void);
 	void DestroyScanner(void);
 
+	static Expression *CompileContext(ConfigCompiler *ctx, bool async);
+	Expression *CompileInput(void);
 	void CompileHelper(void);
 
 public:
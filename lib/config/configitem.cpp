@@ -46,6 +46,12 @@ ConfigItem::TypeMap ConfigItem::m_Items;
 ConfigItem::ItemList ConfigItem::m_UnnamedItems;
 ConfigItem::ItemList ConfigItem::m_CommittedItems;
 
+/* The pending item lists are owned by the caller of CreateChildObjectsRange(). */
+static void ReleasePendingItems(std::vector<ConfigItem::Ptr> *)
+{ }
+
+boost::thread_specific_ptr<ConfigItem::ItemList> ConfigItem::m_PendingItems(&ReleasePendingItems);
+
 REGISTER_SCRIPTFUNCTION(commit_objects, &ConfigItem::ScriptCommit);
 
 /**
@@ -260,6 +266,14 @@ void ConfigItem::Register(void)
 	/* If this is a non-abstract object with a composite name
 	 * we register it in m_UnnamedItems instead of m_Items. */
 	if (!m_Abstract && dynamic_cast<NameComposer *>(type.get())) {
+		/* items created by apply rules are collected by CreateChildObjectsRange() */
+		ItemList *pending = m_PendingItems.get();
+
+		if (pending) {
+			pending->push_back(this);
+			return;
+		}
+
 		boost::mutex::scoped_lock lock(m_Mutex);
 		m_UnnamedItems.push_back(this);
 	} else {
@@ -386,16 +400,16 @@ bool ConfigItem::CommitNewItems(WorkQueue& upq)
 			if (upq.HasExceptions())
 				return false;
 
+			ItemList parents;
+
 			BOOST_FOREACH(const String& loadDep, ptype->GetLoadDependencies()) {
 				BOOST_FOREACH(const ConfigItem::Ptr& item, new_items) {
 					if (item->m_Type == loadDep)
-						upq.Enqueue(boost::bind(&DynamicObject::CreateChildObjects, item->m_Object, ptype));
+						parents.push_back(item);
 				}
 			}
 
-			upq.Join();
-
-			if (upq.HasExceptions())
+			if (!CreateChildObjects(upq, parents, ptype))
 				return false;
 
 			if (!CommitNewItems(upq))
@@ -406,6 +420,65 @@ bool ConfigItem::CommitNewItems(WorkQueue& upq)
 	return true;
 }
 
+/**
+ * Evaluates the apply rules for the specified parent items in parallel.
+ * Each range of parents collects the new items and rule matches in its
+ * own buffers, which are merged once all ranges have been processed.
+ */
+bool ConfigItem::CreateChildObjects(WorkQueue& upq, const ItemList& parents, const Type::Ptr& childType)
+{
+	if (parents.empty())
+		return true;
+
+	/* use several ranges per thread to even out hosts with different numbers of services */
+	size_t ranges = std::min(parents.size(), static_cast<size_t>(Application::GetConcurrency()) * 4);
+
+	std::vector<ItemList> newItems(ranges);
+	std::vector<std::set<ApplyRule *> > matches(ranges);
+
+	for (size_t i = 0; i < ranges; i++) {
+		size_t begin = parents.size() * i / ranges;
+		size_t end = parents.size() * (i + 1) / ranges;
+
+		upq.Enqueue(boost::bind(&ConfigItem::CreateChildObjectsRange, boost::ref(upq), boost::cref(parents),
+		    begin, end, childType, boost::ref(newItems[i]), boost::ref(matches[i])));
+	}
+
+	upq.Join();
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		BOOST_FOREACH(const ItemList& items, newItems) {
+			m_UnnamedItems.insert(m_UnnamedItems.end(), items.begin(), items.end());
+		}
+	}
+
+	BOOST_FOREACH(const std::set<ApplyRule *>& rmatches, matches) {
+		ApplyRule::CommitMatches(rmatches);
+	}
+
+	return !upq.HasExceptions();
+}
+
+void ConfigItem::CreateChildObjectsRange(WorkQueue& upq, const ItemList& parents, size_t begin, size_t end,
+    const Type::Ptr& childType, ItemList& newItems, std::set<ApplyRule *>& matches)
+{
+	m_PendingItems.reset(&newItems);
+	ApplyRule::CollectMatches(&matches);
+
+	for (size_t i = begin; i < end; i++) {
+		try {
+			parents[i]->m_Object->CreateChildObjects(childType);
+		} catch (const std::exception&) {
+			upq.AddException(boost::current_exception());
+		}
+	}
+
+	ApplyRule::CollectMatches(NULL);
+	m_PendingItems.release();
+}
+
 bool ConfigItem::CommitItems(void)
 {
 	WorkQueue upq(25000, Application::GetConcurrency());
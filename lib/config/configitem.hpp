@@ -24,10 +24,14 @@
 #include "config/expression.hpp"
 #include "base/dynamicobject.hpp"
 #include "base/workqueue.hpp"
+#include <boost/thread/tss.hpp>
+#include <set>
 
 namespace icinga
 {
 
+class ApplyRule;
+
 /**
  * A configuration item. Non-abstract configuration items can be used to
  * create configuration objects at runtime.
@@ -93,11 +97,15 @@ private:
 	typedef std::vector<ConfigItem::Ptr> ItemList;
 	static ItemList m_UnnamedItems;
 	static ItemList m_CommittedItems;
+	static boost::thread_specific_ptr<ItemList> m_PendingItems;
 
 	static ConfigItem::Ptr GetObjectUnlocked(const String& type,
 	    const String& name);
 
 	static bool CommitNewItems(WorkQueue& upq);
+	static bool CreateChildObjects(WorkQueue& upq, const ItemList& parents, const Type::Ptr& childType);
+	static void CreateChildObjectsRange(WorkQueue& upq, const ItemList& parents, size_t begin, size_t end,
+	    const Type::Ptr& childType, ItemList& newItems, std::set<ApplyRule *>& matches);
 };
 
 }
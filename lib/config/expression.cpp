@@ -20,6 +20,7 @@
 #include "config/expression.hpp"
 #include "config/configitem.hpp"
 #include "config/vmops.hpp"
+#include "config/bytecode.hpp"
 #include "base/array.hpp"
 #include "base/json.hpp"
 #include "base/object.hpp"
@@ -697,6 +698,284 @@ void icinga::BindToScope(Expression *& expr, ScopeSpecifier scopeSpec)
 	}
 }
 
+namespace icinga
+{
+
+/**
+ * Simplifies expression trees after they've been parsed so that the work
+ * isn't repeated every time an object or apply rule is evaluated: operators
+ * whose operands are all literals are replaced with their result, branches
+ * which can never be taken are removed and inline dictionaries are merged
+ * into their parent dictionary.
+ *
+ * @ingroup config
+ */
+class ExpressionOptimizer
+{
+public:
+	static void OptimizeMember(Expression *& expr)
+	{
+		if (!expr)
+			return;
+
+		Expression *result = Optimize(expr);
+
+		if (result != expr) {
+			delete expr;
+			expr = result;
+		}
+	}
+
+	static void OptimizeMember(boost::shared_ptr<Expression>& expr)
+	{
+		if (!expr)
+			return;
+
+		Expression *result = Optimize(expr.get());
+
+		if (result != expr.get())
+			expr.reset(result);
+	}
+
+private:
+	/* Returns the expression which should be used instead of expr. If that's
+	 * a different expression the caller has to delete expr, children which
+	 * are still in use have already been detached from it. */
+	static Expression *Optimize(Expression *expr)
+	{
+		UnaryExpression *uexpr = dynamic_cast<UnaryExpression *>(expr);
+
+		if (uexpr) {
+			OptimizeMember(uexpr->m_Operand);
+
+			if (IsFoldable(expr) && IsLiteral(uexpr->m_Operand))
+				return Fold(expr);
+
+			return expr;
+		}
+
+		BinaryExpression *bexpr = dynamic_cast<BinaryExpression *>(expr);
+
+		if (bexpr) {
+			OptimizeMember(bexpr->m_Operand1);
+			OptimizeMember(bexpr->m_Operand2);
+
+			bool logicalOr = dynamic_cast<LogicalOrExpression *>(expr);
+
+			if ((logicalOr || dynamic_cast<LogicalAndExpression *>(expr)) && IsLiteral(bexpr->m_Operand1)) {
+				Expression *result;
+
+				if (static_cast<LiteralExpression *>(bexpr->m_Operand1)->GetValue().ToBool() == logicalOr) {
+					result = bexpr->m_Operand1;
+					bexpr->m_Operand1 = NULL;
+				} else {
+					result = bexpr->m_Operand2;
+					bexpr->m_Operand2 = NULL;
+				}
+
+				return result;
+			}
+
+			if (IsFoldable(expr) && IsLiteral(bexpr->m_Operand1) && IsLiteral(bexpr->m_Operand2))
+				return Fold(expr);
+
+			return expr;
+		}
+
+		DictExpression *dexpr = dynamic_cast<DictExpression *>(expr);
+
+		if (dexpr) {
+			std::vector<Expression *> expressions;
+
+			for (std::vector<Expression *>::size_type i = 0; i < dexpr->m_Expressions.size(); i++) {
+				Expression *aexpr = dexpr->m_Expressions[i];
+				dexpr->m_Expressions[i] = NULL;
+
+				Expression *result = Optimize(aexpr);
+
+				if (result != aexpr)
+					delete aexpr;
+
+				/* Only the last value of an inline dictionary is used. */
+				bool valueUsed = dexpr->m_Inline && i == dexpr->m_Expressions.size() - 1;
+
+				if (!valueUsed && IsLiteral(result)) {
+					delete result;
+					continue;
+				}
+
+				DictExpression *idexpr = dynamic_cast<DictExpression *>(result);
+
+				if (idexpr && idexpr->m_Inline && (!valueUsed || !idexpr->m_Expressions.empty())) {
+					expressions.insert(expressions.end(), idexpr->m_Expressions.begin(), idexpr->m_Expressions.end());
+					idexpr->m_Expressions.clear();
+					delete idexpr;
+					continue;
+				}
+
+				expressions.push_back(result);
+			}
+
+			dexpr->m_Expressions.swap(expressions);
+
+			return expr;
+		}
+
+		ArrayExpression *aexpr = dynamic_cast<ArrayExpression *>(expr);
+
+		if (aexpr) {
+			BOOST_FOREACH(Expression *& element, aexpr->m_Expressions)
+				OptimizeMember(element);
+
+			return expr;
+		}
+
+		ConditionalExpression *cexpr = dynamic_cast<ConditionalExpression *>(expr);
+
+		if (cexpr) {
+			OptimizeMember(cexpr->m_Condition);
+			OptimizeMember(cexpr->m_TrueBranch);
+			OptimizeMember(cexpr->m_FalseBranch);
+
+			if (!IsLiteral(cexpr->m_Condition))
+				return expr;
+
+			Expression *result;
+
+			if (static_cast<LiteralExpression *>(cexpr->m_Condition)->GetValue().ToBool()) {
+				result = cexpr->m_TrueBranch;
+				cexpr->m_TrueBranch = NULL;
+			} else if (cexpr->m_FalseBranch) {
+				result = cexpr->m_FalseBranch;
+				cexpr->m_FalseBranch = NULL;
+			} else
+				result = MakeLiteral();
+
+			return result;
+		}
+
+		WhileExpression *wexpr = dynamic_cast<WhileExpression *>(expr);
+
+		if (wexpr) {
+			OptimizeMember(wexpr->m_Condition);
+			OptimizeMember(wexpr->m_LoopBody);
+
+			return expr;
+		}
+
+		FunctionCallExpression *fexpr = dynamic_cast<FunctionCallExpression *>(expr);
+
+		if (fexpr) {
+			OptimizeMember(fexpr->m_FName);
+
+			BOOST_FOREACH(Expression *& arg, fexpr->m_Args)
+				OptimizeMember(arg);
+
+			return expr;
+		}
+
+		ImportExpression *iexpr = dynamic_cast<ImportExpression *>(expr);
+
+		if (iexpr) {
+			OptimizeMember(iexpr->m_Name);
+
+			return expr;
+		}
+
+		ForExpression *forexpr = dynamic_cast<ForExpression *>(expr);
+
+		if (forexpr) {
+			OptimizeMember(forexpr->m_Value);
+			OptimizeMember(forexpr->m_Expression);
+
+			return expr;
+		}
+
+		ObjectExpression *oexpr = dynamic_cast<ObjectExpression *>(expr);
+
+		if (oexpr) {
+			OptimizeMember(oexpr->m_Name);
+			OptimizeMember(oexpr->m_Filter);
+			OptimizeMember(oexpr->m_Expression);
+
+			return expr;
+		}
+
+		ApplyExpression *apexpr = dynamic_cast<ApplyExpression *>(expr);
+
+		if (apexpr) {
+			OptimizeMember(apexpr->m_Name);
+			OptimizeMember(apexpr->m_Filter);
+			OptimizeMember(apexpr->m_FTerm);
+			OptimizeMember(apexpr->m_Expression);
+
+			return expr;
+		}
+
+		/* Function bodies are optimized when the FunctionExpression is
+		 * created, everything else is left alone. */
+		return expr;
+	}
+
+	static bool IsLiteral(const Expression *expr)
+	{
+		return dynamic_cast<const LiteralExpression *>(expr);
+	}
+
+	/* Operators which don't have any side effects and whose result only
+	 * depends on their operands. */
+	static bool IsFoldable(const Expression *expr)
+	{
+		return dynamic_cast<const NegateExpression *>(expr) ||
+		    dynamic_cast<const LogicalNegateExpression *>(expr) ||
+		    dynamic_cast<const AddExpression *>(expr) ||
+		    dynamic_cast<const SubtractExpression *>(expr) ||
+		    dynamic_cast<const MultiplyExpression *>(expr) ||
+		    dynamic_cast<const DivideExpression *>(expr) ||
+		    dynamic_cast<const ModuloExpression *>(expr) ||
+		    dynamic_cast<const XorExpression *>(expr) ||
+		    dynamic_cast<const BinaryAndExpression *>(expr) ||
+		    dynamic_cast<const BinaryOrExpression *>(expr) ||
+		    dynamic_cast<const ShiftLeftExpression *>(expr) ||
+		    dynamic_cast<const ShiftRightExpression *>(expr) ||
+		    dynamic_cast<const EqualExpression *>(expr) ||
+		    dynamic_cast<const NotEqualExpression *>(expr) ||
+		    dynamic_cast<const LessThanExpression *>(expr) ||
+		    dynamic_cast<const GreaterThanExpression *>(expr) ||
+		    dynamic_cast<const LessThanOrEqualExpression *>(expr) ||
+		    dynamic_cast<const GreaterThanOrEqualExpression *>(expr) ||
+		    dynamic_cast<const InExpression *>(expr) ||
+		    dynamic_cast<const NotInExpression *>(expr);
+	}
+
+	static Expression *Fold(Expression *expr)
+	{
+		ScriptFrame frame;
+		Value value;
+
+		try {
+			value = expr->DoEvaluate(frame, NULL).GetValue();
+		} catch (const std::exception&) {
+			/* Keep the expression so that the error is reported
+			 * when it's evaluated. */
+			return expr;
+		}
+
+		/* Objects are mutable and have to be created each time. */
+		if (value.IsObject())
+			return expr;
+
+		return MakeLiteral(value);
+	}
+};
+
+}
+
+void icinga::OptimizeExpression(Expression *& expr)
+{
+	ExpressionOptimizer::OptimizeMember(expr);
+}
+
 ExpressionResult ImportExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	if (frame.Sandboxed)
@@ -721,6 +1000,14 @@ ExpressionResult ImportExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhi
 	return Empty;
 }
 
+FunctionExpression::FunctionExpression(const std::vector<String>& args,
+    std::map<String, Expression *> *closedVars, Expression *expression, const DebugInfo& debugInfo)
+	: DebuggableExpression(debugInfo), m_Args(args), m_ClosedVars(closedVars)
+{
+	OptimizeExpression(expression);
+	m_Expression = BytecodeExpression::Compile(boost::shared_ptr<Expression>(expression));
+}
+
 ExpressionResult FunctionExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	return VMOps::NewFunction(frame, m_Args, m_ClosedVars, m_Expression);
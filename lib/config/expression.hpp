@@ -251,6 +251,11 @@ class I2_CONFIG_API LiteralExpression : public Expression
 public:
 	LiteralExpression(const Value& value = Value());
 
+	Value GetValue(void) const
+	{
+		return m_Value;
+	}
+
 protected:
 	virtual ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const;
 
@@ -288,8 +293,15 @@ public:
 		delete m_Operand;
 	}
 
+	Expression *GetOperand(void) const
+	{
+		return m_Operand;
+	}
+
 protected:
 	Expression *m_Operand;
+
+	friend class ExpressionOptimizer;
 };
 
 class I2_CONFIG_API BinaryExpression : public DebuggableExpression
@@ -305,9 +317,21 @@ public:
 		delete m_Operand2;
 	}
 
+	Expression *GetOperand1(void) const
+	{
+		return m_Operand1;
+	}
+
+	Expression *GetOperand2(void) const
+	{
+		return m_Operand2;
+	}
+
 protected:
 	Expression *m_Operand1;
 	Expression *m_Operand2;
+
+	friend class ExpressionOptimizer;
 };
 
 	
@@ -616,6 +640,10 @@ protected:
 
 private:
 	std::vector<Expression *> m_Expressions;
+
+	friend class BytecodeCompiler;
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 	
 class I2_CONFIG_API DictExpression : public DebuggableExpression
@@ -641,6 +669,9 @@ private:
 	bool m_Inline;
 
 	friend I2_CONFIG_API void BindToScope(Expression *& expr, ScopeSpecifier scopeSpec);
+	friend class BytecodeCompiler;
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 	
 class I2_CONFIG_API SetExpression : public BinaryExpression
@@ -657,6 +688,8 @@ private:
 	CombinedSetOp m_Op;
 
 	friend I2_CONFIG_API void BindToScope(Expression *& expr, ScopeSpecifier scopeSpec);
+	friend class BytecodeCompiler;
+	friend class ConfigCache;
 };
 
 class I2_CONFIG_API ConditionalExpression : public DebuggableExpression
@@ -680,6 +713,10 @@ private:
 	Expression *m_Condition;
 	Expression *m_TrueBranch;
 	Expression *m_FalseBranch;
+
+	friend class BytecodeCompiler;
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 
 class I2_CONFIG_API WhileExpression : public DebuggableExpression
@@ -701,6 +738,9 @@ protected:
 private:
 	Expression *m_Condition;
 	Expression *m_LoopBody;
+
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 
 
@@ -749,6 +789,9 @@ protected:
 
 private:
 	ScopeSpecifier m_ScopeSpec;
+
+	friend class BytecodeCompiler;
+	friend class ConfigCache;
 };
 
 class I2_CONFIG_API IndexerExpression : public BinaryExpression
@@ -766,6 +809,7 @@ protected:
 };
 
 I2_CONFIG_API void BindToScope(Expression *& expr, ScopeSpecifier scopeSpec);
+I2_CONFIG_API void OptimizeExpression(Expression *& expr);
 
 class I2_CONFIG_API ImportExpression : public DebuggableExpression
 {
@@ -784,15 +828,16 @@ protected:
 
 private:
 	Expression *m_Name;
+
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 
 class I2_CONFIG_API FunctionExpression : public DebuggableExpression
 {
 public:
 	FunctionExpression(const std::vector<String>& args,
-	    std::map<String, Expression *> *closedVars, Expression *expression, const DebugInfo& debugInfo = DebugInfo())
-		: DebuggableExpression(debugInfo), m_Args(args), m_ClosedVars(closedVars), m_Expression(expression)
-	{ }
+	    std::map<String, Expression *> *closedVars, Expression *expression, const DebugInfo& debugInfo = DebugInfo());
 
 protected:
 	virtual ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const;
@@ -801,6 +846,8 @@ private:
 	std::vector<String> m_Args;
 	std::map<String, Expression *> *m_ClosedVars;
 	boost::shared_ptr<Expression> m_Expression;
+
+	friend class ConfigCache;
 };
 
 class I2_CONFIG_API ApplyExpression : public DebuggableExpression
@@ -833,6 +880,9 @@ private:
 	boost::shared_ptr<Expression> m_FTerm;
 	std::map<String, Expression *> *m_ClosedVars;
 	boost::shared_ptr<Expression> m_Expression;
+
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 
 class I2_CONFIG_API ObjectExpression : public DebuggableExpression
@@ -861,6 +911,9 @@ private:
 	String m_Zone;
 	std::map<String, Expression *> *m_ClosedVars;
 	boost::shared_ptr<Expression> m_Expression;
+
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 	
 class I2_CONFIG_API ForExpression : public DebuggableExpression
@@ -884,6 +937,9 @@ private:
 	String m_FVVar;
 	Expression *m_Value;
 	Expression *m_Expression;
+
+	friend class ExpressionOptimizer;
+	friend class ConfigCache;
 };
 
 }
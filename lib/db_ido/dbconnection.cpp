@@ -29,7 +29,9 @@
 #include "base/utility.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include "base/tlsutility.hpp"
 #include <boost/foreach.hpp>
+#include <boost/algorithm/string/join.hpp>
 
 using namespace icinga;
 
@@ -39,7 +41,7 @@ Timer::Ptr DbConnection::m_ProgramStatusTimer;
 boost::once_flag DbConnection::m_OnceFlag = BOOST_ONCE_INIT;
 
 DbConnection::DbConnection(void)
-	: m_QueryStats(15 * 60)
+	: m_QueryStats(15 * 60), m_CoalescedQueryStats(15 * 60)
 { }
 
 void DbConnection::OnConfigLoaded(void)
@@ -60,7 +62,7 @@ void DbConnection::Start(void)
 {
 	DynamicObject::Start();
 
-	DbObject::OnQuery.connect(boost::bind(&DbConnection::ExecuteQuery, this, _1));
+	DbObject::OnQuery.connect(boost::bind(&DbConnection::QueryHandler, this, _1));
 }
 
 void DbConnection::Resume(void)
@@ -85,6 +87,8 @@ void DbConnection::Pause(void)
 
 	m_CleanUpTimer.reset();
 
+	ClearPendingStatusQueries();
+
 	DbQuery query1;
 	query1.Table = "programstatus";
 	query1.IdColumn = "programstatus_id";
@@ -249,6 +253,8 @@ void DbConnection::CleanUpExecuteQuery(const String&, const String&, double)
 
 void DbConnection::SetObjectID(const DbObject::Ptr& dbobj, const DbReference& dbref)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (dbref.IsValid())
 		m_ObjectIDs[dbobj] = dbref;
 	else
@@ -257,6 +263,8 @@ void DbConnection::SetObjectID(const DbObject::Ptr& dbobj, const DbReference& db
 
 DbReference DbConnection::GetObjectID(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	std::map<DbObject::Ptr, DbReference>::const_iterator it;
 
 	it = m_ObjectIDs.find(dbobj);
@@ -277,6 +285,8 @@ void DbConnection::SetInsertID(const DbType::Ptr& type, const DbReference& objid
 	if (!objid.IsValid())
 		return;
 
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (dbref.IsValid())
 		m_InsertIDs[std::make_pair(type, objid)] = dbref;
 	else
@@ -293,6 +303,8 @@ DbReference DbConnection::GetInsertID(const DbType::Ptr& type, const DbReference
 	if (!objid.IsValid())
 		return DbReference();
 
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	std::map<std::pair<DbType::Ptr, DbReference>, DbReference>::const_iterator it;
 
 	it = m_InsertIDs.find(std::make_pair(type, objid));
@@ -305,6 +317,8 @@ DbReference DbConnection::GetInsertID(const DbType::Ptr& type, const DbReference
 
 void DbConnection::SetNotificationInsertID(const CustomVarObject::Ptr& obj, const DbReference& dbref)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (dbref.IsValid())
 		m_NotificationInsertIDs[obj] = dbref;
 	else
@@ -313,6 +327,8 @@ void DbConnection::SetNotificationInsertID(const CustomVarObject::Ptr& obj, cons
 
 DbReference DbConnection::GetNotificationInsertID(const CustomVarObject::Ptr& obj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	std::map<CustomVarObject::Ptr, DbReference>::const_iterator it;
 
 	it = m_NotificationInsertIDs.find(obj);
@@ -325,6 +341,8 @@ DbReference DbConnection::GetNotificationInsertID(const CustomVarObject::Ptr& ob
 
 void DbConnection::SetObjectActive(const DbObject::Ptr& dbobj, bool active)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (active)
 		m_ActiveObjects.insert(dbobj);
 	else
@@ -333,21 +351,34 @@ void DbConnection::SetObjectActive(const DbObject::Ptr& dbobj, bool active)
 
 bool DbConnection::GetObjectActive(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	return (m_ActiveObjects.find(dbobj) != m_ActiveObjects.end());
 }
 
 void DbConnection::ClearIDCache(void)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	m_ObjectIDs.clear();
 	m_InsertIDs.clear();
 	m_NotificationInsertIDs.clear();
 	m_ActiveObjects.clear();
 	m_ConfigUpdates.clear();
 	m_StatusUpdates.clear();
+	m_ConfigHashes.clear();
+
+	lock.unlock();
+
+	/* Queries which were queued before the connection was reset may
+	 * never be executed, so don't merge any further updates into them. */
+	ClearPendingStatusQueries();
 }
 
 void DbConnection::SetConfigUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (hasupdate)
 		m_ConfigUpdates.insert(dbobj);
 	else
@@ -356,11 +387,15 @@ void DbConnection::SetConfigUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 
 bool DbConnection::GetConfigUpdate(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	return (m_ConfigUpdates.find(dbobj) != m_ConfigUpdates.end());
 }
 
 void DbConnection::SetStatusUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (hasupdate)
 		m_StatusUpdates.insert(dbobj);
 	else
@@ -369,14 +404,136 @@ void DbConnection::SetStatusUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 
 bool DbConnection::GetStatusUpdate(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	return (m_StatusUpdates.find(dbobj) != m_StatusUpdates.end());
 }
 
+void DbConnection::SetConfigHash(const DbObject::Ptr& dbobj, const String& hash)
+{
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
+	if (!hash.IsEmpty())
+		m_ConfigHashes[dbobj] = hash;
+	else
+		m_ConfigHashes.erase(dbobj);
+}
+
+String DbConnection::GetConfigHash(const DbObject::Ptr& dbobj) const
+{
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
+	std::map<DbObject::Ptr, String>::const_iterator it;
+
+	it = m_ConfigHashes.find(dbobj);
+
+	if (it == m_ConfigHashes.end())
+		return Empty;
+
+	return it->second;
+}
+
 void DbConnection::ExecuteQuery(const DbQuery&)
 {
 	/* Default handler does nothing. */
 }
 
+bool DbConnection::CanCoalesceQuery(const DbQuery& query)
+{
+	return query.Category == DbCatState && query.StatusUpdate && query.Object &&
+	    query.Fields && query.Type == (DbQueryInsert | DbQueryUpdate);
+}
+
+/**
+ * Status updates for an object which is already waiting in the query queue
+ * are merged into the pending query instead of being queued again. All other
+ * queries (e.g. history and log entries) are passed on in order.
+ */
+void DbConnection::QueryHandler(const DbQuery& query)
+{
+	/* UpdateObjectConfig() collects the object's config queries first */
+	std::vector<DbQuery> *buffer = m_QueryBuffer.get();
+
+	if (buffer) {
+		buffer->push_back(query);
+		return;
+	}
+
+	if (!CanCoalesceQuery(query)) {
+		ExecuteQuery(query);
+		return;
+	}
+
+	DbQuery pquery = query;
+
+	{
+		boost::mutex::scoped_lock lock(m_PendingStatusMutex);
+
+		std::pair<String, DbObject::Ptr> key = std::make_pair(query.Table, query.Object);
+		std::map<std::pair<String, DbObject::Ptr>, Dictionary::Ptr>::iterator it = m_PendingStatusQueries.find(key);
+
+		if (it != m_PendingStatusQueries.end()) {
+			ObjectLock olock(query.Fields);
+
+			BOOST_FOREACH(const Dictionary::Pair& kv, query.Fields) {
+				it->second->Set(kv.first, kv.second);
+			}
+
+			lock.unlock();
+
+			boost::mutex::scoped_lock slock(m_StatsMutex);
+			m_CoalescedQueryStats.InsertValue(Utility::GetTime(), 1);
+
+			return;
+		}
+
+		/* The fields are shared with other connections, so we need our own copy. */
+		pquery.Fields = query.Fields->ShallowClone();
+		m_PendingStatusQueries[key] = pquery.Fields;
+	}
+
+	ExecuteQuery(pquery);
+}
+
+/**
+ * Must be called by the query queue before a query is executed. Further
+ * status updates for the same object will be queued as a new query.
+ */
+void DbConnection::TakeStatusUpdateQuery(const DbQuery& query)
+{
+	if (!CanCoalesceQuery(query))
+		return;
+
+	boost::mutex::scoped_lock lock(m_PendingStatusMutex);
+
+	std::map<std::pair<String, DbObject::Ptr>, Dictionary::Ptr>::iterator it = m_PendingStatusQueries.find(std::make_pair(query.Table, query.Object));
+
+	if (it != m_PendingStatusQueries.end() && it->second == query.Fields)
+		m_PendingStatusQueries.erase(it);
+}
+
+void DbConnection::ClearPendingStatusQueries(void)
+{
+	boost::mutex::scoped_lock lock(m_PendingStatusMutex);
+	m_PendingStatusQueries.clear();
+}
+
+/**
+ * Checks whether an insert can be combined with other inserts into a
+ * multi-row INSERT statement. This is only the case for history tables
+ * where we don't need the insert ID of the new row.
+ */
+bool DbConnection::IsBatchableInsert(const DbQuery& query)
+{
+	if (query.NotificationObject || query.ConfigUpdate || query.StatusUpdate)
+		return false;
+
+	return query.Table == "statehistory" || query.Table == "logentries" ||
+	    query.Table == "notifications" || query.Table == "contactnotifications" ||
+	    query.Table == "commenthistory" || query.Table == "downtimehistory" ||
+	    query.Table == "flappinghistory" || query.Table == "acknowledgements";
+}
+
 void DbConnection::UpdateAllObjects(void)
 {
 	DynamicType::Ptr type;
@@ -388,20 +545,235 @@ void DbConnection::UpdateAllObjects(void)
 				if (!GetObjectActive(dbobj))
 					ActivateObject(dbobj);
 
-				dbobj->SendConfigUpdate();
+				if (IsIncrementalConfigDump() && dbobj->GetType() != DbType::GetByName("Endpoint"))
+					UpdateObjectConfig(dbobj);
+				else
+					dbobj->SendConfigUpdate();
+
 				dbobj->SendStatusUpdate();
 			}
 		}
 	}
 }
 
+/**
+ * Sends the config queries for an object, unless they are unchanged since
+ * the last config dump. A hash of the queries is stored in the confighashes
+ * table so that unchanged objects can be skipped after a reconnect or a
+ * restart.
+ */
+void DbConnection::UpdateObjectConfig(const DbObject::Ptr& dbobj)
+{
+	std::vector<DbQuery> queries;
+
+	m_QueryBuffer.reset(&queries);
+
+	try {
+		dbobj->SendConfigUpdate();
+	} catch (...) {
+		m_QueryBuffer.release();
+		throw;
+	}
+
+	m_QueryBuffer.release();
+
+	String hash = CalculateConfigHash(queries);
+
+	if (hash == GetConfigHash(dbobj)) {
+		Log(LogDebug, "DbConnection")
+		    << "Config for object '" << dbobj->GetObject()->GetName() << "' is unchanged.";
+		return;
+	}
+
+	/* the child rows are re-inserted by the object's config queries */
+	DeleteObjectChildRows(dbobj);
+
+	BOOST_FOREACH(const DbQuery& query, queries) {
+		QueryHandler(query);
+	}
+
+	DbQuery query;
+	query.Table = "confighashes";
+	query.Type = DbQueryInsert | DbQueryUpdate;
+	query.Category = DbCatConfig;
+	query.Fields = new Dictionary();
+	query.Fields->Set("object_id", dbobj->GetObject());
+	query.Fields->Set("config_hash", hash);
+	query.Fields->Set("instance_id", 0); /* DbConnection class fills in real ID */
+	query.WhereCriteria = new Dictionary();
+	query.WhereCriteria->Set("object_id", dbobj->GetObject());
+	query.Object = dbobj;
+	ExecuteQuery(query);
+
+	SetConfigHash(dbobj, hash);
+}
+
+/**
+ * Removes the child rows and the config hash for an object which no
+ * longer exists in the configuration.
+ */
+void DbConnection::RemoveObjectConfig(const DbObject::Ptr& dbobj)
+{
+	DbReference objid = GetObjectID(dbobj);
+
+	if (!objid.IsValid())
+		return;
+
+	DeleteObjectChildRows(dbobj);
+
+	DbQuery query;
+	query.Table = "confighashes";
+	query.Type = DbQueryDelete;
+	query.Category = DbCatConfig;
+	query.WhereCriteria = new Dictionary();
+	query.WhereCriteria->Set("object_id", static_cast<long>(objid));
+	query.WhereCriteria->Set("instance_id", 0); /* DbConnection class fills in real ID */
+	ExecuteQuery(query);
+
+	SetConfigHash(dbobj, Empty);
+}
+
+void DbConnection::DeleteObjectChildRows(const DbObject::Ptr& dbobj)
+{
+	DbReference objid = GetObjectID(dbobj);
+
+	/* new objects don't have any child rows yet */
+	if (!objid.IsValid())
+		return;
+
+	DbReference insertid = GetInsertID(dbobj);
+
+	struct {
+		String type;
+		String table;
+		String column;
+		bool insert_id;
+		DbQueryCategory category;
+	} tables[] = {
+		{ "Host", "host_parenthosts", "host_id", true, DbCatConfig },
+		{ "Host", "hostdependencies", "dependent_host_object_id", false, DbCatConfig },
+		{ "Host", "host_contacts", "host_id", true, DbCatConfig },
+		{ "Host", "host_contactgroups", "host_id", true, DbCatConfig },
+		{ "Host", "comments", "object_id", false, DbCatComment },
+		{ "Host", "scheduleddowntime", "object_id", false, DbCatDowntime },
+		{ "Service", "servicedependencies", "dependent_service_object_id", false, DbCatConfig },
+		{ "Service", "service_contacts", "service_id", true, DbCatConfig },
+		{ "Service", "service_contactgroups", "service_id", true, DbCatConfig },
+		{ "Service", "comments", "object_id", false, DbCatComment },
+		{ "Service", "scheduleddowntime", "object_id", false, DbCatDowntime },
+		{ "HostGroup", "hostgroup_members", "hostgroup_id", true, DbCatConfig },
+		{ "ServiceGroup", "servicegroup_members", "servicegroup_id", true, DbCatConfig },
+		{ "User", "contact_addresses", "contact_id", true, DbCatConfig },
+		{ "User", "contact_notificationcommands", "contact_id", true, DbCatConfig },
+		{ "", "customvariables", "object_id", false, DbCatConfig },
+		{ "", "customvariablestatus", "object_id", false, DbCatState }
+	};
+
+	for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); i++) {
+		if (!tables[i].type.IsEmpty() && dbobj->GetType() != DbType::GetByName(tables[i].type))
+			continue;
+
+		DbReference ref = tables[i].insert_id ? insertid : objid;
+
+		if (!ref.IsValid())
+			continue;
+
+		DbQuery query;
+		query.Table = tables[i].table;
+		query.Type = DbQueryDelete;
+		query.Category = tables[i].category;
+		query.WhereCriteria = new Dictionary();
+		query.WhereCriteria->Set(tables[i].column, static_cast<long>(ref));
+		query.WhereCriteria->Set("instance_id", 0); /* DbConnection class fills in real ID */
+		ExecuteQuery(query);
+	}
+}
+
+/**
+ * Calculates a hash for the config queries of an object. Queries are
+ * sorted first because some of them are sent in a non-deterministic
+ * order (e.g. host parents).
+ */
+String DbConnection::CalculateConfigHash(const std::vector<DbQuery>& queries)
+{
+	std::vector<String> parts;
+
+	BOOST_FOREACH(const DbQuery& query, queries) {
+		std::ostringstream msgbuf;
+		msgbuf << query.Table << "|" << query.Type << "|" << query.Category;
+
+		Dictionary::Ptr dicts[] = { query.Fields, query.WhereCriteria };
+
+		for (size_t i = 0; i < sizeof(dicts) / sizeof(dicts[0]); i++) {
+			msgbuf << "|";
+
+			if (!dicts[i])
+				continue;
+
+			ObjectLock olock(dicts[i]);
+
+			BOOST_FOREACH(const Dictionary::Pair& kv, dicts[i]) {
+				/* changes for every dump */
+				if (kv.first == "status_update_time")
+					continue;
+
+				msgbuf << kv.first << "=" << SerializeQueryValue(kv.second) << ";";
+			}
+		}
+
+		parts.push_back(msgbuf.str());
+	}
+
+	std::sort(parts.begin(), parts.end());
+
+	return SHA256(boost::algorithm::join(parts, "\n"));
+}
+
+String DbConnection::SerializeQueryValue(const Value& value)
+{
+	if (value.IsObjectType<DbValue>()) {
+		DbValue::Ptr dbvalue = value;
+		return Convert::ToString(dbvalue->GetType()) + ":" + SerializeQueryValue(dbvalue->GetValue());
+	}
+
+	if (value.IsObjectType<DynamicObject>()) {
+		DynamicObject::Ptr object = value;
+		return object->GetType()->GetName() + "!" + object->GetName();
+	}
+
+	return Convert::ToString(value.GetType()) + ":" + Convert::ToString(value);
+}
+
+/**
+ * The confighashes table was added in schema version 1.14.1 (upgrade/2.4.1.sql),
+ * older schemas don't have it and get the full config dump.
+ */
+bool DbConnection::IsIncrementalConfigDump(void) const
+{
+	return Utility::CompareVersion(IDO_CURRENT_SCHEMA_VERSION, GetSchemaVersion()) >= 0;
+}
+
 void DbConnection::PrepareDatabase(void)
 {
 	/*
 	 * only clear tables on reconnect which
 	 * cannot be updated by their existing ids
 	 * for details check https://dev.icinga.org/issues/5565
+	 *
+	 * with an incremental config dump the child rows
+	 * of changed objects are deleted by UpdateObjectConfig()
+	 * and only the endpoints are dumped in full
 	 */
+	if (IsIncrementalConfigDump()) {
+		ClearConfigTable("endpoints");
+		ClearConfigTable("endpointstatus");
+
+		BOOST_FOREACH(const DbType::Ptr& type, DbType::GetAllTypes()) {
+			FillIDCache(type);
+		}
+
+		return;
+	}
 
 	//ClearConfigTable("commands");
 	ClearConfigTable("comments");
@@ -460,3 +832,9 @@ int DbConnection::GetQueryCount(RingBuffer::SizeType span) const
 	boost::mutex::scoped_lock lock(m_StatsMutex);
 	return m_QueryStats.GetValues(span);
 }
+
+int DbConnection::GetCoalescedQueryCount(RingBuffer::SizeType span) const
+{
+	boost::mutex::scoped_lock lock(m_StatsMutex);
+	return m_CoalescedQueryStats.GetValues(span);
+}
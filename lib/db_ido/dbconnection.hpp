@@ -28,8 +28,9 @@
 #include "base/ringbuffer.hpp"
 #include <boost/thread/once.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
 
-#define IDO_CURRENT_SCHEMA_VERSION "1.13.0"
+#define IDO_CURRENT_SCHEMA_VERSION "1.14.1"
 #define IDO_COMPAT_SCHEMA_VERSION "1.12.0"
 
 namespace icinga
@@ -71,7 +72,11 @@ public:
 	void SetStatusUpdate(const DbObject::Ptr& dbobj, bool hasupdate);
 	bool GetStatusUpdate(const DbObject::Ptr& dbobj) const;
 
+	void SetConfigHash(const DbObject::Ptr& dbobj, const String& hash);
+	String GetConfigHash(const DbObject::Ptr& dbobj) const;
+
 	int GetQueryCount(RingBuffer::SizeType span) const;
+	int GetCoalescedQueryCount(RingBuffer::SizeType span) const;
 	virtual int GetPendingQueryCount(void) const = 0;
 
 	virtual void ValidateFailoverTimeout(double value, const ValidationUtils& utils) override;
@@ -91,20 +96,43 @@ protected:
 	virtual void NewTransaction(void) = 0;
 
 	void UpdateAllObjects(void);
+	void UpdateObjectConfig(const DbObject::Ptr& dbobj);
+	void RemoveObjectConfig(const DbObject::Ptr& dbobj);
 
 	void PrepareDatabase(void);
 
+	bool IsIncrementalConfigDump(void) const;
+
 	void IncreaseQueryCount(void);
 
+	void TakeStatusUpdateQuery(const DbQuery& query);
+
+	static bool IsBatchableInsert(const DbQuery& query);
+
 private:
+	mutable boost::mutex m_IDMutex;
 	std::map<DbObject::Ptr, DbReference> m_ObjectIDs;
 	std::map<std::pair<DbType::Ptr, DbReference>, DbReference> m_InsertIDs;
 	std::map<CustomVarObject::Ptr, DbReference> m_NotificationInsertIDs;
 	std::set<DbObject::Ptr> m_ActiveObjects;
 	std::set<DbObject::Ptr> m_ConfigUpdates;
 	std::set<DbObject::Ptr> m_StatusUpdates;
+	std::map<DbObject::Ptr, String> m_ConfigHashes;
 	Timer::Ptr m_CleanUpTimer;
 
+	boost::mutex m_PendingStatusMutex;
+	std::map<std::pair<String, DbObject::Ptr>, Dictionary::Ptr> m_PendingStatusQueries;
+
+	boost::thread_specific_ptr<std::vector<DbQuery> > m_QueryBuffer;
+
+	void QueryHandler(const DbQuery& query);
+	static bool CanCoalesceQuery(const DbQuery& query);
+	void ClearPendingStatusQueries(void);
+
+	void DeleteObjectChildRows(const DbObject::Ptr& dbobj);
+	static String CalculateConfigHash(const std::vector<DbQuery>& queries);
+	static String SerializeQueryValue(const Value& value);
+
 	void CleanUpHandler(void);
 
 	virtual void ClearConfigTable(const String& table) = 0;
@@ -117,6 +145,7 @@ private:
 
 	mutable boost::mutex m_StatsMutex;
 	RingBuffer m_QueryStats;
+	RingBuffer m_CoalescedQueryStats;
 };
 
 struct database_error : virtual std::exception, virtual boost::exception { };
@@ -0,0 +1,504 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "db_ido/dbqueryspool.hpp"
+#include "db_ido/dbobject.hpp"
+#include "db_ido/dbvalue.hpp"
+#include "base/dynamictype.hpp"
+#include "base/json.hpp"
+#include "base/objectlock.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include "base/utility.hpp"
+#include <boost/foreach.hpp>
+#include <algorithm>
+
+using namespace icinga;
+
+DbQuerySpool::DbQuerySpool(const String& path, size_t maxSize)
+	: m_Path(path), m_MaxSize(maxSize), m_ReadOffset(0), m_NextOffset(0), m_WriteOffset(0), m_Length(0), m_Unacknowledged(0), m_DrainStats(15 * 60)
+{ }
+
+DbQuerySpool::~DbQuerySpool(void)
+{
+	Close();
+}
+
+/**
+ * Opens the spool file. Records which were left over from a previous run
+ * are kept and will be read before any new records.
+ */
+void DbQuerySpool::Open(void)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_Stream.is_open())
+		return;
+
+	std::ofstream fp(m_Path.CStr(), std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+	fp.close();
+
+	m_Stream.open(m_Path.CStr(), std::fstream::in | std::fstream::out | std::fstream::binary);
+
+	if (!m_Stream) {
+		m_Stream.clear();
+
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("open")
+		    << boost::errinfo_errno(errno)
+		    << boost::errinfo_file_name(m_Path));
+	}
+
+	std::string line;
+
+	while (std::getline(m_Stream, line)) {
+		/* The last record is incomplete if the file was not closed properly. */
+		if (m_Stream.eof()) {
+			Log(LogWarning, "DbQuerySpool")
+			    << "Discarding incomplete spooled query at the end of '" << m_Path << "'.";
+
+			Compact();
+			Reopen();
+			break;
+		}
+
+		m_WriteOffset += line.size() + 1;
+		m_Length++;
+	}
+
+	m_Stream.clear();
+
+	if (m_Length > 0) {
+		Log(LogInformation, "DbQuerySpool")
+		    << "Found " << m_Length << " spooled queries in '" << m_Path << "'.";
+	}
+}
+
+void DbQuerySpool::Reset(void)
+{
+	m_Stream.close();
+	m_Stream.clear();
+	m_Stream.open(m_Path.CStr(), std::fstream::in | std::fstream::out | std::fstream::trunc | std::fstream::binary);
+
+	m_ReadOffset = 0;
+	m_NextOffset = 0;
+	m_WriteOffset = 0;
+	m_Length = 0;
+	m_Unacknowledged = 0;
+}
+
+/**
+ * Moves the records which have not been acknowledged yet to the beginning of a new
+ * spool file. This also discards anything after the last record. The
+ * stream is closed afterwards.
+ *
+ * Must hold m_Mutex.
+ */
+void DbQuerySpool::Compact(void)
+{
+	String tempFilename = m_Path + ".tmp";
+
+	std::ofstream fp(tempFilename.CStr(), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+	m_Stream.clear();
+	m_Stream.seekg(m_ReadOffset);
+
+	std::streamoff remaining = m_WriteOffset - m_ReadOffset;
+	char buffer[4096];
+
+	while (remaining > 0 && m_Stream) {
+		m_Stream.read(buffer, std::min<std::streamoff>(remaining, sizeof(buffer)));
+		fp.write(buffer, m_Stream.gcount());
+		remaining -= m_Stream.gcount();
+	}
+
+	fp.close();
+
+	m_Stream.close();
+
+#ifdef _WIN32
+	_unlink(m_Path.CStr());
+#endif /* _WIN32 */
+
+	if (rename(tempFilename.CStr(), m_Path.CStr()) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+		    << boost::errinfo_api_function("rename")
+		    << boost::errinfo_errno(errno)
+		    << boost::errinfo_file_name(tempFilename));
+	}
+
+	m_WriteOffset -= m_ReadOffset;
+	m_NextOffset -= m_ReadOffset;
+	m_ReadOffset = 0;
+}
+
+/* must hold m_Mutex */
+void DbQuerySpool::Reopen(void)
+{
+	m_Stream.close();
+	m_Stream.clear();
+	m_Stream.open(m_Path.CStr(), std::fstream::in | std::fstream::out | std::fstream::binary);
+}
+
+/**
+ * Appends a query to the spool.
+ *
+ * @returns false if the spool is full or the query can't be serialized.
+ */
+bool DbQuerySpool::Append(const DbQuery& query)
+{
+	Value record = SerializeQuery(query);
+
+	if (record.IsEmpty())
+		return false;
+
+	String line = JsonEncode(record) + "\n";
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_Stream.is_open())
+		return false;
+
+	/* Reclaim the space used by records which have already been acknowledged. */
+	if (m_WriteOffset + line.GetLength() > m_MaxSize && m_ReadOffset >= static_cast<std::streamoff>(m_MaxSize / 4)) {
+		try {
+			Compact();
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "DbQuerySpool")
+			    << "Could not compact spool file '" << m_Path << "': " << DiagnosticInformation(ex);
+		}
+
+		Reopen();
+	}
+
+	if (!m_Stream.is_open() || m_WriteOffset + line.GetLength() > m_MaxSize)
+		return false;
+
+	m_Stream.clear();
+	m_Stream.seekp(m_WriteOffset);
+	m_Stream.write(line.CStr(), line.GetLength());
+
+	if (!m_Stream)
+		return false;
+
+	m_WriteOffset += line.GetLength();
+	m_Length++;
+
+	return true;
+}
+
+/**
+ * Reads the oldest query from the spool. Queries whose objects no
+ * longer exist are skipped. The query stays in the spool until
+ * Acknowledge() is called; Rollback() makes it available again.
+ *
+ * @returns false if the spool is empty.
+ */
+bool DbQuerySpool::Read(DbQuery *query)
+{
+	for (;;) {
+		std::string line;
+
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+
+			if (m_Length == 0)
+				return false;
+
+			m_Stream.clear();
+			m_Stream.seekg(m_NextOffset);
+
+			if (!std::getline(m_Stream, line)) {
+				Log(LogWarning, "DbQuerySpool")
+				    << "Could not read spooled query from '" << m_Path << "'. Discarding " << m_Length << " queries.";
+				Reset();
+				return false;
+			}
+
+			m_NextOffset += line.size() + 1;
+			m_Length--;
+			m_Unacknowledged++;
+		}
+
+		/* decode the record without blocking Append() */
+		Dictionary::Ptr record;
+
+		try {
+			record = JsonDecode(line);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "DbQuerySpool")
+			    << "Ignoring invalid spooled query: " << DiagnosticInformation(ex);
+			continue;
+		}
+
+		if (record && DeserializeQuery(record, query))
+			return true;
+	}
+}
+
+/**
+ * Removes the queries which were returned by Read() from the spool once
+ * they have been committed to the database.
+ */
+void DbQuerySpool::Acknowledge(void)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_Unacknowledged == 0)
+		return;
+
+	m_DrainStats.InsertValue(Utility::GetTime(), m_Unacknowledged);
+
+	m_ReadOffset = m_NextOffset;
+	m_Unacknowledged = 0;
+
+	if (m_Length == 0)
+		Reset();
+}
+
+/**
+ * Puts the queries which were returned by Read() but not acknowledged
+ * back into the spool, e.g. because the database connection was lost
+ * before they were committed. They are read again in the same order.
+ */
+void DbQuerySpool::Rollback(void)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_NextOffset = m_ReadOffset;
+	m_Length += m_Unacknowledged;
+	m_Unacknowledged = 0;
+}
+
+/**
+ * Closes the spool file. Records which have not been acknowledged yet are
+ * moved to the beginning of the file.
+ */
+void DbQuerySpool::Close(void)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_Stream.is_open())
+		return;
+
+	if (m_ReadOffset > 0)
+		Compact();
+	else
+		m_Stream.close();
+
+	m_ReadOffset = 0;
+	m_NextOffset = 0;
+	m_WriteOffset = 0;
+	m_Length = 0;
+	m_Unacknowledged = 0;
+}
+
+size_t DbQuerySpool::GetLength(void) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	return m_Length;
+}
+
+size_t DbQuerySpool::GetSize(void) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	return m_WriteOffset - m_ReadOffset;
+}
+
+int DbQuerySpool::GetDrainRate(RingBuffer::SizeType span) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	return m_DrainStats.GetValues(span);
+}
+
+Value DbQuerySpool::SerializeQuery(const DbQuery& query)
+{
+	Dictionary::Ptr record = new Dictionary();
+	record->Set("type", query.Type);
+	record->Set("category", query.Category);
+	record->Set("table", query.Table);
+	record->Set("id_column", query.IdColumn);
+	record->Set("config_update", query.ConfigUpdate);
+	record->Set("status_update", query.StatusUpdate);
+
+	if (query.Fields)
+		record->Set("fields", SerializeDictionary(query.Fields));
+
+	if (query.WhereCriteria)
+		record->Set("where", SerializeDictionary(query.WhereCriteria));
+
+	if (query.Object) {
+		DynamicObject::Ptr object = query.Object->GetObject();
+
+		if (!object)
+			return Empty;
+
+		record->Set("object", SerializeValue(object));
+	}
+
+	if (query.NotificationObject)
+		record->Set("notification_object", SerializeValue(query.NotificationObject));
+
+	return record;
+}
+
+bool DbQuerySpool::DeserializeQuery(const Dictionary::Ptr& record, DbQuery *query)
+{
+	DbQuery result;
+	result.Type = record->Get("type");
+	result.Category = static_cast<DbQueryCategory>(static_cast<int>(record->Get("category")));
+	result.Table = record->Get("table");
+	result.IdColumn = record->Get("id_column");
+	result.ConfigUpdate = record->Get("config_update");
+	result.StatusUpdate = record->Get("status_update");
+
+	if (record->Contains("fields") && !DeserializeDictionary(record->Get("fields"), &result.Fields))
+		return false;
+
+	if (record->Contains("where") && !DeserializeDictionary(record->Get("where"), &result.WhereCriteria))
+		return false;
+
+	Value object;
+
+	if (record->Contains("object")) {
+		if (!DeserializeValue(record->Get("object"), &object))
+			return false;
+
+		result.Object = DbObject::GetOrCreateByObject(object);
+
+		if (!result.Object)
+			return false;
+	}
+
+	if (record->Contains("notification_object")) {
+		if (!DeserializeValue(record->Get("notification_object"), &object))
+			return false;
+
+		result.NotificationObject = dynamic_pointer_cast<CustomVarObject>(static_cast<DynamicObject::Ptr>(object));
+
+		if (!result.NotificationObject)
+			return false;
+	}
+
+	*query = result;
+
+	return true;
+}
+
+/**
+ * Object references are stored by type and name. Values which depend on
+ * the time the query is executed are resolved when spooling the query.
+ */
+Value DbQuerySpool::SerializeValue(const Value& value)
+{
+	if (value.IsObjectType<DbValue>()) {
+		DbValue::Ptr dbvalue = value;
+
+		Dictionary::Ptr result = new Dictionary();
+
+		if (dbvalue->GetType() == DbValueTimestampNow) {
+			result->Set("dbvalue_type", DbValueTimestamp);
+			result->Set("value", static_cast<long>(Utility::GetTime()));
+		} else {
+			result->Set("dbvalue_type", dbvalue->GetType());
+			result->Set("value", SerializeValue(dbvalue->GetValue()));
+		}
+
+		return result;
+	}
+
+	if (value.IsObjectType<DynamicObject>()) {
+		DynamicObject::Ptr object = value;
+
+		Dictionary::Ptr result = new Dictionary();
+		result->Set("object_type", object->GetType()->GetName());
+		result->Set("object_name", object->GetName());
+		return result;
+	}
+
+	return value;
+}
+
+bool DbQuerySpool::DeserializeValue(const Value& value, Value *result)
+{
+	if (!value.IsObjectType<Dictionary>()) {
+		*result = value;
+		return true;
+	}
+
+	Dictionary::Ptr dict = value;
+
+	if (dict->Contains("object_type")) {
+		DynamicType::Ptr dtype = DynamicType::GetByName(dict->Get("object_type"));
+
+		if (!dtype)
+			return false;
+
+		DynamicObject::Ptr object = dtype->GetObject(dict->Get("object_name"));
+
+		if (!object)
+			return false;
+
+		*result = object;
+		return true;
+	}
+
+	Value dbvalue;
+
+	if (!DeserializeValue(dict->Get("value"), &dbvalue))
+		return false;
+
+	*result = new DbValue(static_cast<DbValueType>(static_cast<int>(dict->Get("dbvalue_type"))), dbvalue);
+	return true;
+}
+
+Dictionary::Ptr DbQuerySpool::SerializeDictionary(const Dictionary::Ptr& dict)
+{
+	Dictionary::Ptr result = new Dictionary();
+
+	ObjectLock olock(dict);
+
+	BOOST_FOREACH(const Dictionary::Pair& kv, dict) {
+		result->Set(kv.first, SerializeValue(kv.second));
+	}
+
+	return result;
+}
+
+bool DbQuerySpool::DeserializeDictionary(const Value& value, Dictionary::Ptr *result)
+{
+	Dictionary::Ptr dict = value;
+	*result = new Dictionary();
+
+	ObjectLock olock(dict);
+
+	BOOST_FOREACH(const Dictionary::Pair& kv, dict) {
+		Value fvalue;
+
+		if (!DeserializeValue(kv.second, &fvalue))
+			return false;
+
+		(*result)->Set(kv.first, fvalue);
+	}
+
+	return true;
+}
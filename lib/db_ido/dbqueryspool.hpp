@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef DBQUERYSPOOL_H
+#define DBQUERYSPOOL_H
+
+#include "db_ido/i2-db_ido.hpp"
+#include "db_ido/dbquery.hpp"
+#include "base/ringbuffer.hpp"
+#include <boost/thread/mutex.hpp>
+#include <fstream>
+
+namespace icinga
+{
+
+/**
+ * A file-backed FIFO for queries which can't be sent to the database
+ * right away. Queries are appended as JSON records and read back in the
+ * same order and removed once they have been acknowledged. The file is
+ * truncated once all records have been acknowledged and compacted when the
+ * spool runs out of space after enough records have been acknowledged.
+ *
+ * @ingroup ido
+ */
+class I2_DB_IDO_API DbQuerySpool : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(DbQuerySpool);
+
+	DbQuerySpool(const String& path, size_t maxSize);
+	~DbQuerySpool(void);
+
+	void Open(void);
+	void Close(void);
+
+	bool Append(const DbQuery& query);
+	bool Read(DbQuery *query);
+	void Acknowledge(void);
+	void Rollback(void);
+
+	size_t GetLength(void) const;
+	size_t GetSize(void) const;
+	int GetDrainRate(RingBuffer::SizeType span) const;
+
+private:
+	mutable boost::mutex m_Mutex;
+	String m_Path;
+	size_t m_MaxSize;
+	std::fstream m_Stream;
+	std::streamoff m_ReadOffset;
+	std::streamoff m_NextOffset;
+	std::streamoff m_WriteOffset;
+	size_t m_Length;
+	size_t m_Unacknowledged;
+	RingBuffer m_DrainStats;
+
+	void Reset(void);
+	void Compact(void);
+	void Reopen(void);
+
+	static Value SerializeQuery(const DbQuery& query);
+	static bool DeserializeQuery(const Dictionary::Ptr& record, DbQuery *query);
+	static Value SerializeValue(const Value& value);
+	static bool DeserializeValue(const Value& value, Value *result);
+	static Dictionary::Ptr SerializeDictionary(const Dictionary::Ptr& dict);
+	static bool DeserializeDictionary(const Value& value, Dictionary::Ptr *result);
+};
+
+}
+
+#endif /* DBQUERYSPOOL_H */
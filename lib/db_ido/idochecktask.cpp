@@ -122,6 +122,7 @@ void IdoCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckResult
 	perfdata->Add(new PerfdataValue("queries_5mins", conn->GetQueryCount(5 * 60)));
 	perfdata->Add(new PerfdataValue("queries_15mins", conn->GetQueryCount(15 * 60)));
 	perfdata->Add(new PerfdataValue("pending_queries", conn->GetPendingQueryCount()));
+	perfdata->Add(new PerfdataValue("coalesced_queries_1min", conn->GetCoalescedQueryCount(60)));
 	cr->SetPerformanceData(perfdata);
 
 	checkable->ProcessCheckResult(cr);
@@ -32,6 +32,8 @@
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
 #include <boost/tuple/tuple.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/foreach.hpp>
 
 using namespace icinga;
@@ -39,16 +41,21 @@ using namespace icinga;
 REGISTER_TYPE(IdoMysqlConnection);
 REGISTER_STATSFUNCTION(IdoMysqlConnectionStats, &IdoMysqlConnection::StatsFunc);
 
+/* queries are spooled to disk when the query queue grows beyond this */
+#define IDO_SPOOL_THRESHOLD 100000
+
 IdoMysqlConnection::IdoMysqlConnection(void)
-	: m_QueryQueue(500000)
-{ }
+	: m_SpoolDraining(false), m_LastSpoolWarning(0)
+{
+	m_Sessions.push_back(boost::make_shared<IdoMysqlSession>());
+}
 
 void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	Dictionary::Ptr nodes = new Dictionary();
 
 	BOOST_FOREACH(const IdoMysqlConnection::Ptr& idomysqlconnection, DynamicType::GetObjectsByType<IdoMysqlConnection>()) {
-		size_t items = idomysqlconnection->m_QueryQueue.GetLength();
+		size_t items = idomysqlconnection->GetPendingQueryCount();
 
 		Dictionary::Ptr stats = new Dictionary();
 		stats->Set("version", idomysqlconnection->GetSchemaVersion());
@@ -58,18 +65,61 @@ void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		nodes->Set(idomysqlconnection->GetName(), stats);
 
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_query_queue_items", items));
+
+		DbQuerySpool::Ptr spool = idomysqlconnection->m_Spool;
+
+		if (spool) {
+			size_t spoolItems = spool->GetLength();
+			size_t spoolBytes = spool->GetSize();
+			double drainRate = spool->GetDrainRate(60) / 60.0;
+
+			stats->Set("spool_items", spoolItems);
+			stats->Set("spool_bytes", spoolBytes);
+			stats->Set("spool_drain_rate", drainRate);
+
+			perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_spool_items", spoolItems));
+			perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_spool_bytes", spoolBytes));
+			perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_spool_drain_rate", drainRate));
+		}
 	}
 
 	status->Set("idomysqlconnection", nodes);
 }
 
+void IdoMysqlConnection::OnConfigLoaded(void)
+{
+	DbConnection::OnConfigLoaded();
+
+	if (!GetSpoolPath().IsEmpty())
+		m_Spool = new DbQuerySpool(GetSpoolPath(), static_cast<size_t>(GetSpoolMaxSize()) * 1024 * 1024);
+}
+
 void IdoMysqlConnection::Resume(void)
 {
 	DbConnection::Resume();
 
+	if (m_Spool) {
+		try {
+			m_Spool->Open();
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "IdoMysqlConnection")
+			    << "Cannot open spool file '" << GetSpoolPath() << "': " << DiagnosticInformation(ex);
+		}
+	}
+
 	SetConnected(false);
 
-	m_QueryQueue.SetExceptionCallback(boost::bind(&IdoMysqlConnection::ExceptionHandler, this, _1));
+	/* The first session is used for the config dump and everything that isn't
+	 * handled by one of the other sessions. When additional writer connections
+	 * are enabled there's also a session for the cleanup queries. */
+	if (m_Sessions.size() == 1 && GetWriterConnections() > 0) {
+		for (int i = 0; i < GetWriterConnections() + 1; i++)
+			m_Sessions.push_back(boost::make_shared<IdoMysqlSession>());
+	}
+
+	BOOST_FOREACH(const IdoMysqlSession::Ptr& session, m_Sessions) {
+		session->Queue.SetExceptionCallback(boost::bind(&IdoMysqlConnection::ExceptionHandler, this, _1));
+	}
 
 	m_TxTimer = new Timer();
 	m_TxTimer->SetInterval(1);
@@ -91,8 +141,16 @@ void IdoMysqlConnection::Pause(void)
 
 	DbConnection::Pause();
 
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::Disconnect, this));
-	m_QueryQueue.Join();
+	BOOST_FOREACH(const IdoMysqlSession::Ptr& session, m_Sessions) {
+		session->Queue.Enqueue(boost::bind(&IdoMysqlConnection::Disconnect, this));
+	}
+
+	BOOST_FOREACH(const IdoMysqlSession::Ptr& session, m_Sessions) {
+		session->Queue.Join();
+	}
+
+	if (m_Spool)
+		m_Spool->Close();
 }
 
 void IdoMysqlConnection::ExceptionHandler(boost::exception_ptr exp)
@@ -102,47 +160,344 @@ void IdoMysqlConnection::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "IdoMysqlConnection")
 	    << "Exception during database operation: " << DiagnosticInformation(exp);
 
-	if (GetConnected()) {
-		mysql_close(&m_Connection);
+	IdoMysqlSession& session = GetSession();
 
-		SetConnected(false);
-	}
+	if (IsSessionConnected(session))
+		CloseSession(session);
+	else
+		ResetSession(session);
 }
 
 void IdoMysqlConnection::AssertOnWorkQueue(void)
 {
-	ASSERT(m_QueryQueue.IsWorkerThread());
+	ASSERT(GetSession().Queue.IsWorkerThread());
+}
+
+/**
+ * Returns the session for the work queue the caller is running on.
+ */
+IdoMysqlSession& IdoMysqlConnection::GetSession(void)
+{
+	BOOST_FOREACH(const IdoMysqlSession::Ptr& session, m_Sessions) {
+		if (session->Queue.IsWorkerThread())
+			return *session;
+	}
+
+	VERIFY(!"Not running on one of the IDO work queues.");
+
+	return *m_Sessions[0];
+}
+
+/**
+ * Returns the work queue a query should be executed on. Status updates and
+ * history inserts which no other queries depend on are partitioned across
+ * the writer sessions by object so that queries for the same object are
+ * still executed in order.
+ */
+WorkQueue& IdoMysqlConnection::GetQueryQueue(const DbQuery& query)
+{
+	if (m_Sessions.size() < 3)
+		return m_Sessions[0]->Queue;
+
+	DynamicObject::Ptr object;
+
+	if (query.StatusUpdate && query.Category == DbCatState && query.Object)
+		object = query.Object->GetObject();
+	else if (query.Type == DbQueryInsert && query.Fields && (query.Table == "statehistory" ||
+	    query.Table == "flappinghistory" || query.Table == "acknowledgements" || query.Table == "logentries")) {
+		Value rawvalue = DbValue::ExtractValue(query.Fields->Get("object_id"));
+
+		if (rawvalue.IsObjectType<DynamicObject>())
+			object = rawvalue;
+	} else
+		return m_Sessions[0]->Queue;
+
+	size_t writers = m_Sessions.size() - 2;
+	size_t index = object ? boost::hash_value(object->GetName().GetData()) % writers : 0;
+
+	return m_Sessions[2 + index]->Queue;
+}
+
+bool IdoMysqlConnection::IsSessionConnected(const IdoMysqlSession& session) const
+{
+	if (&session == m_Sessions[0].get())
+		return GetConnected();
+	else
+		return session.Connected;
+}
+
+/**
+ * Connects the session to the database server.
+ */
+void IdoMysqlConnection::OpenSession(IdoMysqlSession& session)
+{
+	String ihost, isocket_path, iuser, ipasswd, idb;
+	const char *host, *socket_path, *user , *passwd, *db;
+	long port;
+
+	ihost = GetHost();
+	isocket_path = GetSocketPath();
+	iuser = GetUser();
+	ipasswd = GetPassword();
+	idb = GetDatabase();
+
+	host = (!ihost.IsEmpty()) ? ihost.CStr() : NULL;
+	port = GetPort();
+	socket_path = (!isocket_path.IsEmpty()) ? isocket_path.CStr() : NULL;
+	user = (!iuser.IsEmpty()) ? iuser.CStr() : NULL;
+	passwd = (!ipasswd.IsEmpty()) ? ipasswd.CStr() : NULL;
+	db = (!idb.IsEmpty()) ? idb.CStr() : NULL;
+
+	/* connection */
+	if (!mysql_init(&session.Connection)) {
+		Log(LogCritical, "IdoMysqlConnection")
+		    << "mysql_init() failed: \"" << mysql_error(&session.Connection) << "\"";
+
+		BOOST_THROW_EXCEPTION(std::bad_alloc());
+	}
+
+	if (!mysql_real_connect(&session.Connection, host, user, passwd, db, port, socket_path, CLIENT_FOUND_ROWS | CLIENT_MULTI_STATEMENTS)) {
+		Log(LogCritical, "IdoMysqlConnection")
+		    << "Connection to database '" << db << "' with user '" << user << "' on '" << host << ":" << port
+		    << "' failed: \"" << mysql_error(&session.Connection) << "\"";
+
+		BOOST_THROW_EXCEPTION(std::runtime_error(mysql_error(&session.Connection)));
+	}
+
+	if (&session == m_Sessions[0].get())
+		SetConnected(true);
+	else
+		session.Connected = true;
+
+	IdoMysqlResult result = Query("SELECT @@global.max_allowed_packet AS max_allowed_packet");
+
+	Dictionary::Ptr row = FetchRow(result);
+
+	if (row)
+		session.MaxPacketSize = row->Get("max_allowed_packet");
+	else
+		session.MaxPacketSize = 64 * 1024;
+
+	DiscardRows(result);
+}
+
+void IdoMysqlConnection::CloseSession(IdoMysqlSession& session)
+{
+	mysql_close(&session.Connection);
+
+	if (&session == m_Sessions[0].get())
+		SetConnected(false);
+	else
+		session.Connected = false;
+
+	ResetSession(session);
+}
+
+/**
+ * Discards the queries which were buffered for the session but not sent
+ * to the database server yet.
+ */
+void IdoMysqlConnection::ResetSession(IdoMysqlSession& session)
+{
+	session.AsyncQueries.clear();
+	session.InsertRows.clear();
+	session.InsertBytes = 0;
+}
+
+/**
+ * Closes the caller's writer session after the main session has reconnected.
+ * The session is connected again on demand.
+ */
+void IdoMysqlConnection::ResetWriterSession(void)
+{
+	AssertOnWorkQueue();
+
+	IdoMysqlSession& session = GetSession();
+
+	if (session.Connected)
+		CloseSession(session);
+	else
+		ResetSession(session);
+
+	session.NextConnect = 0;
+}
+
+/**
+ * Checks whether queries can be executed on the caller's session. The writer
+ * sessions are connected on demand once the main session is connected.
+ */
+bool IdoMysqlConnection::CheckSession(void)
+{
+	IdoMysqlSession& session = GetSession();
+
+	if (&session == m_Sessions[0].get())
+		return GetConnected();
+
+	if (!GetConnected()) {
+		if (session.Connected)
+			CloseSession(session);
+
+		return false;
+	}
+
+	if (session.Connected)
+		return true;
+
+	double now = Utility::GetTime();
+
+	if (session.NextConnect > now)
+		return false;
+
+	session.NextConnect = now + 10;
+
+	OpenSession(session);
+
+	Query("SET SESSION TIME_ZONE='+00:00'");
+	Query("BEGIN");
+
+	return true;
 }
 
 void IdoMysqlConnection::Disconnect(void)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	IdoMysqlSession& session = GetSession();
+
+	if (!IsSessionConnected(session))
 		return;
 
 	Query("COMMIT");
-	mysql_close(&m_Connection);
-
-	SetConnected(false);
+	CloseSession(session);
 }
 
 void IdoMysqlConnection::TxTimerHandler(void)
 {
 	NewTransaction();
+
+	if (!m_Spool || !GetConnected() || GetPendingQueryCount() > IDO_SPOOL_THRESHOLD || m_Spool->GetLength() == 0)
+		return;
+
+	boost::mutex::scoped_lock lock(m_SpoolMutex);
+
+	if (m_SpoolDraining)
+		return;
+
+	m_SpoolDraining = true;
+
+	lock.unlock();
+
+	Log(LogInformation, "IdoMysqlConnection")
+	    << "Sending " << m_Spool->GetLength() << " spooled queries to the database.";
+
+	m_Sessions[0]->Queue.Enqueue(boost::bind(&IdoMysqlConnection::DrainSpool, this));
+}
+
+/**
+ * History queries are spooled to disk while the database is unavailable
+ * or can't keep up. Config and status queries are not spooled because the
+ * config dump after a reconnect sends them anyway.
+ */
+bool IdoMysqlConnection::IsSpoolableQuery(const DbQuery& query)
+{
+	if (query.Type != DbQueryInsert || query.ConfigUpdate || query.StatusUpdate)
+		return false;
+
+	return IsBatchableInsert(query) || query.Table == "notifications";
+}
+
+/**
+ * Adds a query to the spool if the query queue can't take it right now.
+ * Once there are spooled queries all history queries are spooled until
+ * the spool is empty again so that they are still executed in order.
+ */
+bool IdoMysqlConnection::SpoolQuery(const DbQuery& query)
+{
+	if (!m_Spool || IsPaused() || !IsSpoolableQuery(query))
+		return false;
+
+	if (m_Spool->GetLength() == 0 && GetConnected() && GetPendingQueryCount() <= IDO_SPOOL_THRESHOLD)
+		return false;
+
+	if ((query.Category & GetCategories()) == 0)
+		return true;
+
+	if (m_Spool->Append(query))
+		return true;
+
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_SpoolMutex);
+
+	if (now - m_LastSpoolWarning > 60) {
+		Log(LogWarning, "IdoMysqlConnection")
+		    << "Spool file '" << GetSpoolPath() << "' is full (" << m_Spool->GetSize() << " bytes). History queries will be lost.";
+
+		m_LastSpoolWarning = now;
+	}
+
+	return false;
+}
+
+void IdoMysqlConnection::DrainSpool(void)
+{
+	AssertOnWorkQueue();
+
+	bool more = false;
+
+	if (CheckSession()) {
+		DbQuery query;
+
+		try {
+			for (int i = 0; i < 1000 && GetConnected() && m_Spool->Read(&query); i++)
+				InternalExecuteQuery(query);
+
+			/* The queries are only removed from the spool once they've been
+			 * committed. The first flush runs the callbacks which may queue
+			 * follow-up queries (e.g. inserts for failed updates). */
+			FinishAsyncQueries(true);
+			AsyncQuery("COMMIT");
+			AsyncQuery("BEGIN");
+			FinishAsyncQueries(true);
+		} catch (...) {
+			m_Spool->Rollback();
+
+			boost::mutex::scoped_lock lock(m_SpoolMutex);
+			m_SpoolDraining = false;
+
+			throw;
+		}
+
+		if (GetConnected())
+			m_Spool->Acknowledge();
+		else
+			m_Spool->Rollback();
+
+		more = m_Spool->GetLength() > 0 && GetPendingQueryCount() <= IDO_SPOOL_THRESHOLD;
+	}
+
+	if (more) {
+		m_Sessions[0]->Queue.Enqueue(boost::bind(&IdoMysqlConnection::DrainSpool, this));
+		return;
+	}
+
+	boost::mutex::scoped_lock lock(m_SpoolMutex);
+	m_SpoolDraining = false;
 }
 
 void IdoMysqlConnection::NewTransaction(void)
 {
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalNewTransaction, this));
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::FinishAsyncQueries, this, true));
+	BOOST_FOREACH(const IdoMysqlSession::Ptr& session, m_Sessions) {
+		session->Queue.Enqueue(boost::bind(&IdoMysqlConnection::InternalNewTransaction, this));
+		session->Queue.Enqueue(boost::bind(&IdoMysqlConnection::FinishAsyncQueries, this, true));
+	}
 }
 
 void IdoMysqlConnection::InternalNewTransaction(void)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!CheckSession())
 		return;
 
 	AsyncQuery("COMMIT");
@@ -151,7 +506,7 @@ void IdoMysqlConnection::InternalNewTransaction(void)
 
 void IdoMysqlConnection::ReconnectTimerHandler(void)
 {
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::Reconnect, this));
+	m_Sessions[0]->Queue.Enqueue(boost::bind(&IdoMysqlConnection::Reconnect, this));
 }
 
 void IdoMysqlConnection::Reconnect(void)
@@ -166,63 +521,30 @@ void IdoMysqlConnection::Reconnect(void)
 
 	bool reconnect = false;
 
+	IdoMysqlSession& session = GetSession();
+
 	if (GetConnected()) {
 		/* Check if we're really still connected */
-		if (mysql_ping(&m_Connection) == 0)
+		if (mysql_ping(&session.Connection) == 0)
 			return;
 
-		mysql_close(&m_Connection);
-		SetConnected(false);
+		CloseSession(session);
 		reconnect = true;
 	}
 
-	ClearIDCache();
-
-	String ihost, isocket_path, iuser, ipasswd, idb;
-	const char *host, *socket_path, *user , *passwd, *db;
-	long port;
-
-	ihost = GetHost();
-	isocket_path = GetSocketPath();
-	iuser = GetUser();
-	ipasswd = GetPassword();
-	idb = GetDatabase();
-
-	host = (!ihost.IsEmpty()) ? ihost.CStr() : NULL;
-	port = GetPort();
-	socket_path = (!isocket_path.IsEmpty()) ? isocket_path.CStr() : NULL;
-	user = (!iuser.IsEmpty()) ? iuser.CStr() : NULL;
-	passwd = (!ipasswd.IsEmpty()) ? ipasswd.CStr() : NULL;
-	db = (!idb.IsEmpty()) ? idb.CStr() : NULL;
-
-	/* connection */
-	if (!mysql_init(&m_Connection)) {
-		Log(LogCritical, "IdoMysqlConnection")
-		    << "mysql_init() failed: \"" << mysql_error(&m_Connection) << "\"";
-
-		BOOST_THROW_EXCEPTION(std::bad_alloc());
-	}
-
-	if (!mysql_real_connect(&m_Connection, host, user, passwd, db, port, socket_path, CLIENT_FOUND_ROWS | CLIENT_MULTI_STATEMENTS)) {
-		Log(LogCritical, "IdoMysqlConnection")
-		    << "Connection to database '" << db << "' with user '" << user << "' on '" << host << ":" << port
-		    << "' failed: \"" << mysql_error(&m_Connection) << "\"";
-
-		BOOST_THROW_EXCEPTION(std::runtime_error(mysql_error(&m_Connection)));
-	}
+	/* don't let the writer sessions activate objects until we've loaded the object IDs */
+	boost::recursive_mutex::scoped_lock alock(m_ActivateMutex);
 
-	SetConnected(true);
-
-	IdoMysqlResult result = Query("SELECT @@global.max_allowed_packet AS max_allowed_packet");
+	ClearIDCache();
 
-	Dictionary::Ptr row = FetchRow(result);
+	/* The writer sessions' buffered queries refer to the old IDs. */
+	for (std::vector<IdoMysqlSession::Ptr>::size_type i = 1; i < m_Sessions.size(); i++)
+		m_Sessions[i]->Queue.Enqueue(boost::bind(&IdoMysqlConnection::ResetWriterSession, this));
 
-	if (row)
-		m_MaxPacketSize = row->Get("max_allowed_packet");
-	else
-		m_MaxPacketSize = 64 * 1024;
+	OpenSession(session);
 
-	DiscardRows(result);
+	IdoMysqlResult result;
+	Dictionary::Ptr row;
 
 	String dbVersionName = "idoutils";
 	result = Query("SELECT version FROM " + GetTablePrefix() + "dbversion WHERE name='" + Escape(dbVersionName) + "'");
@@ -230,8 +552,7 @@ void IdoMysqlConnection::Reconnect(void)
 	row = FetchRow(result);
 
 	if (!row) {
-		mysql_close(&m_Connection);
-		SetConnected(false);
+		CloseSession(session);
 
 		Log(LogCritical, "IdoMysqlConnection", "Schema does not provide any valid version! Verify your schema installation.");
 
@@ -245,8 +566,7 @@ void IdoMysqlConnection::Reconnect(void)
 	SetSchemaVersion(version);
 
 	if (Utility::CompareVersion(IDO_COMPAT_SCHEMA_VERSION, version) < 0) {
-		mysql_close(&m_Connection);
-		SetConnected(false);
+		CloseSession(session);
 
 		Log(LogCritical, "IdoMysqlConnection")
 		    << "Schema version '" << version << "' does not match the required version '"
@@ -301,8 +621,7 @@ void IdoMysqlConnection::Reconnect(void)
 			    << "Last update by '" << endpoint_name << "' was " << status_update_age << "s ago.";
 
 			if (status_update_age < GetFailoverTimeout()) {
-				mysql_close(&m_Connection);
-				SetConnected(false);
+				CloseSession(session);
 				SetShouldConnect(false);
 
 				return;
@@ -313,8 +632,7 @@ void IdoMysqlConnection::Reconnect(void)
 				Log(LogNotice, "IdoMysqlConnection")
 				    << "Local endpoint '" << my_endpoint->GetName() << "' is not authoritative, bailing out.";
 
-				mysql_close(&m_Connection);
-				SetConnected(false);
+				CloseSession(session);
 
 				return;
 			}
@@ -339,7 +657,12 @@ void IdoMysqlConnection::Reconnect(void)
 	PrepareDatabase();
 
 	std::ostringstream q1buf;
-	q1buf << "SELECT object_id, objecttype_id, name1, name2, is_active FROM " + GetTablePrefix() + "objects WHERE instance_id = " << static_cast<long>(m_InstanceID);
+	if (IsIncrementalConfigDump()) {
+		q1buf << "SELECT o.object_id, o.objecttype_id, o.name1, o.name2, o.is_active, COALESCE(h.config_hash, '') AS config_hash FROM " + GetTablePrefix() + "objects o "
+		    "LEFT JOIN " + GetTablePrefix() + "confighashes h ON h.object_id = o.object_id WHERE o.instance_id = " << static_cast<long>(m_InstanceID);
+	} else {
+		q1buf << "SELECT object_id, objecttype_id, name1, name2, is_active FROM " + GetTablePrefix() + "objects WHERE instance_id = " << static_cast<long>(m_InstanceID);
+	}
 	result = Query(q1buf.str());
 
 	while ((row = FetchRow(result))) {
@@ -352,10 +675,15 @@ void IdoMysqlConnection::Reconnect(void)
 		SetObjectID(dbobj, DbReference(row->Get("object_id")));
 		SetObjectActive(dbobj, row->Get("is_active"));
 
+		if (row->Contains("config_hash"))
+			SetConfigHash(dbobj, row->Get("config_hash"));
+
 		if (GetObjectActive(dbobj))
 			active_dbobjs.push_back(dbobj);
 	}
 
+	alock.unlock();
+
 	Query("BEGIN");
 
 	UpdateAllObjects();
@@ -367,6 +695,9 @@ void IdoMysqlConnection::Reconnect(void)
 			    << "Deactivate deleted object name1: '" << dbobj->GetName1()
 			    << "' name2: '" << dbobj->GetName2() + "'.";
 			DeactivateObject(dbobj);
+
+			if (IsIncrementalConfigDump())
+				RemoveObjectConfig(dbobj);
 		}
 	}
 }
@@ -380,24 +711,34 @@ void IdoMysqlConnection::AsyncQuery(const String& query, const boost::function<v
 {
 	AssertOnWorkQueue();
 
+	/* pending multi-row inserts have to be sent first to maintain the right order for queries */
+	FlushInsertRows();
+
+	IdoMysqlSession& session = GetSession();
+
 	IdoAsyncQuery aq;
 	aq.Query = query;
 	aq.Callback = callback;
-	m_AsyncQueries.push_back(aq);
+	session.AsyncQueries.push_back(aq);
 
-	if (m_AsyncQueries.size() > 500)
+	if (session.AsyncQueries.size() > 500)
 		FinishAsyncQueries(true);
 	else
-		m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::FinishAsyncQueries, this, false));
+		session.Queue.Enqueue(boost::bind(&IdoMysqlConnection::FinishAsyncQueries, this, false));
 }
 
 void IdoMysqlConnection::FinishAsyncQueries(bool force)
 {
-	if (m_AsyncQueries.size() < 10 && !force)
+	if (force)
+		FlushInsertRows();
+
+	IdoMysqlSession& session = GetSession();
+
+	if (session.AsyncQueries.size() < 10 && !force)
 		return;
 
 	std::vector<IdoAsyncQuery> queries;
-	m_AsyncQueries.swap(queries);
+	session.AsyncQueries.swap(queries);
 
 	std::vector<IdoAsyncQuery>::size_type offset = 0;
 
@@ -412,7 +753,7 @@ void IdoMysqlConnection::FinishAsyncQueries(bool force)
 
 			size_t size_query = aq.Query.GetLength() + 1;
 
-			if (num_bytes + size_query > m_MaxPacketSize - 512)
+			if (num_bytes + size_query > session.MaxPacketSize - 512)
 				break;
 
 			if (count > 0)
@@ -427,15 +768,15 @@ void IdoMysqlConnection::FinishAsyncQueries(bool force)
 
 		String query = querybuf.str();
 
-		if (mysql_query(&m_Connection, query.CStr()) != 0) {
+		if (mysql_query(&session.Connection, query.CStr()) != 0) {
 			std::ostringstream msgbuf;
-			String message = mysql_error(&m_Connection);
+			String message = mysql_error(&session.Connection);
 			msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 			Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 			BOOST_THROW_EXCEPTION(
 			    database_error()
-				<< errinfo_message(mysql_error(&m_Connection))
+				<< errinfo_message(mysql_error(&session.Connection))
 				<< errinfo_database_query(query)
 			);
 		}
@@ -443,22 +784,22 @@ void IdoMysqlConnection::FinishAsyncQueries(bool force)
 		for (std::vector<IdoAsyncQuery>::size_type i = offset; i < offset + count; i++) {
 			const IdoAsyncQuery& aq = queries[i];
 
-			m_AffectedRows = mysql_affected_rows(&m_Connection);
+			session.AffectedRows = mysql_affected_rows(&session.Connection);
 
-			MYSQL_RES *result = mysql_use_result(&m_Connection);
+			MYSQL_RES *result = mysql_use_result(&session.Connection);
 
 			IdoMysqlResult iresult;
 
 			if (!result) {
-				if (mysql_field_count(&m_Connection) > 0) {
+				if (mysql_field_count(&session.Connection) > 0) {
 					std::ostringstream msgbuf;
-					String message = mysql_error(&m_Connection);
+					String message = mysql_error(&session.Connection);
 					msgbuf << "Error \"" << message << "\" when executing query \"" << aq.Query << "\"";
 					Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 					BOOST_THROW_EXCEPTION(
 					    database_error()
-						<< errinfo_message(mysql_error(&m_Connection))
+						<< errinfo_message(mysql_error(&session.Connection))
 						<< errinfo_database_query(query)
 					);
 				}
@@ -468,15 +809,15 @@ void IdoMysqlConnection::FinishAsyncQueries(bool force)
 			if (aq.Callback)
 				aq.Callback(iresult);
 
-			if (mysql_next_result(&m_Connection) > 0) {
+			if (mysql_next_result(&session.Connection) > 0) {
 				std::ostringstream msgbuf;
-				String message = mysql_error(&m_Connection);
+				String message = mysql_error(&session.Connection);
 				msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 				Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 				BOOST_THROW_EXCEPTION(
 				    database_error()
-					<< errinfo_message(mysql_error(&m_Connection))
+					<< errinfo_message(mysql_error(&session.Connection))
 					<< errinfo_database_query(query)
 				);
 			}
@@ -486,6 +827,55 @@ void IdoMysqlConnection::FinishAsyncQueries(bool force)
 	}
 }
 
+void IdoMysqlConnection::AddInsertRow(const String& table, const String& columns, const String& values)
+{
+	AssertOnWorkQueue();
+
+	IdoMysqlSession& session = GetSession();
+
+	size_t size_row = values.GetLength() + 3;
+
+	if (!session.InsertRows.empty() && (table != session.InsertTable || columns != session.InsertColumns ||
+	    session.InsertRows.size() >= 500 || session.InsertBytes + size_row > session.MaxPacketSize - 512))
+		FlushInsertRows();
+
+	if (session.InsertRows.empty()) {
+		session.InsertTable = table;
+		session.InsertColumns = columns;
+		session.InsertBytes = GetTablePrefix().GetLength() + table.GetLength() + columns.GetLength() + 32;
+	}
+
+	session.InsertRows.push_back(values);
+	session.InsertBytes += size_row;
+}
+
+void IdoMysqlConnection::FlushInsertRows(void)
+{
+	IdoMysqlSession& session = GetSession();
+
+	if (session.InsertRows.empty())
+		return;
+
+	std::vector<String> rows;
+	session.InsertRows.swap(rows);
+
+	std::ostringstream qbuf;
+	qbuf << "INSERT INTO " << GetTablePrefix() << session.InsertTable << " (" << session.InsertColumns << ") VALUES ";
+
+	for (std::vector<String>::size_type i = 0; i < rows.size(); i++) {
+		if (i > 0) {
+			qbuf << ", ";
+
+			/* keep the query statistics comparable to single-row inserts */
+			IncreaseQueryCount();
+		}
+
+		qbuf << "(" << rows[i] << ")";
+	}
+
+	AsyncQuery(qbuf.str());
+}
+
 IdoMysqlResult IdoMysqlConnection::Query(const String& query)
 {
 	AssertOnWorkQueue();
@@ -498,33 +888,33 @@ IdoMysqlResult IdoMysqlConnection::Query(const String& query)
 
 	IncreaseQueryCount();
 
-	if (mysql_query(&m_Connection, query.CStr()) != 0) {
+	if (mysql_query(&GetSession().Connection, query.CStr()) != 0) {
 		std::ostringstream msgbuf;
-		String message = mysql_error(&m_Connection);
+		String message = mysql_error(&GetSession().Connection);
 		msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 		Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 		BOOST_THROW_EXCEPTION(
 		    database_error()
-			<< errinfo_message(mysql_error(&m_Connection))
+			<< errinfo_message(mysql_error(&GetSession().Connection))
 			<< errinfo_database_query(query)
 		);
 	}
 
-	m_AffectedRows = mysql_affected_rows(&m_Connection);
+	GetSession().AffectedRows = mysql_affected_rows(&GetSession().Connection);
 
-	MYSQL_RES *result = mysql_use_result(&m_Connection);
+	MYSQL_RES *result = mysql_use_result(&GetSession().Connection);
 
 	if (!result) {
-		if (mysql_field_count(&m_Connection) > 0) {
+		if (mysql_field_count(&GetSession().Connection) > 0) {
 			std::ostringstream msgbuf;
-			String message = mysql_error(&m_Connection);
+			String message = mysql_error(&GetSession().Connection);
 			msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 			Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 			BOOST_THROW_EXCEPTION(
 			    database_error()
-				<< errinfo_message(mysql_error(&m_Connection))
+				<< errinfo_message(mysql_error(&GetSession().Connection))
 				<< errinfo_database_query(query)
 			);
 		}
@@ -539,14 +929,14 @@ DbReference IdoMysqlConnection::GetLastInsertID(void)
 {
 	AssertOnWorkQueue();
 
-	return DbReference(mysql_insert_id(&m_Connection));
+	return DbReference(mysql_insert_id(&GetSession().Connection));
 }
 
 int IdoMysqlConnection::GetAffectedRows(void)
 {
 	AssertOnWorkQueue();
 
-	return m_AffectedRows;
+	return GetSession().AffectedRows;
 }
 
 String IdoMysqlConnection::Escape(const String& s)
@@ -556,7 +946,7 @@ String IdoMysqlConnection::Escape(const String& s)
 	size_t length = s.GetLength();
 	char *to = new char[s.GetLength() * 2 + 1];
 
-	mysql_real_escape_string(&m_Connection, to, s.CStr(), length);
+	mysql_real_escape_string(&GetSession().Connection, to, s.CStr(), length);
 
 	String result = String(to);
 
@@ -602,16 +992,18 @@ void IdoMysqlConnection::DiscardRows(const IdoMysqlResult& result)
 
 void IdoMysqlConnection::ActivateObject(const DbObject::Ptr& dbobj)
 {
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalActivateObject, this, dbobj));
+	m_Sessions[0]->Queue.Enqueue(boost::bind(&IdoMysqlConnection::InternalActivateObject, this, dbobj));
 }
 
 void IdoMysqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!CheckSession())
 		return;
 
+	boost::recursive_mutex::scoped_lock lock(m_ActivateMutex);
+
 	DbReference dbref = GetObjectID(dbobj);
 	std::ostringstream qbuf;
 
@@ -636,14 +1028,14 @@ void IdoMysqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
 
 void IdoMysqlConnection::DeactivateObject(const DbObject::Ptr& dbobj)
 {
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalDeactivateObject, this, dbobj));
+	m_Sessions[0]->Queue.Enqueue(boost::bind(&IdoMysqlConnection::InternalDeactivateObject, this, dbobj));
 }
 
 void IdoMysqlConnection::InternalDeactivateObject(const DbObject::Ptr& dbobj)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!CheckSession())
 		return;
 
 	DbReference dbref = GetObjectID(dbobj);
@@ -726,17 +1118,23 @@ void IdoMysqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	ASSERT(query.Category != DbCatInvalid);
 
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, (DbQueryType *)NULL), true);
+	if (SpoolQuery(query))
+		return;
+
+	GetQueryQueue(query).Enqueue(boost::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, (DbQueryType *)NULL), true);
 }
 
 void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType *typeOverride)
 {
 	AssertOnWorkQueue();
 
+	if (!typeOverride)
+		TakeStatusUpdateQuery(query);
+
 	if ((query.Category & GetCategories()) == 0)
 		return;
 
-	if (!GetConnected())
+	if (!CheckSession())
 		return;
 
 	if (query.Object && query.Object->GetObject()->GetExtension("agent_check").ToBool())
@@ -754,7 +1152,7 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType
 
 		BOOST_FOREACH(const Dictionary::Pair& kv, query.WhereCriteria) {
 			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
-				m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, (DbQueryType *)NULL));
+				GetSession().Queue.Enqueue(boost::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, (DbQueryType *)NULL));
 				return;
 			}
 
@@ -836,8 +1234,14 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType
 				first = false;
 		}
 
-		if (type == DbQueryInsert)
+		if (type == DbQueryInsert) {
+			if (IsBatchableInsert(query)) {
+				AddInsertRow(query.Table, colbuf.str(), valbuf.str());
+				return;
+			}
+
 			qbuf << " (" << colbuf.str() << ") VALUES (" << valbuf.str() << ")";
+		}
 	}
 
 	if (type != DbQueryInsert)
@@ -872,14 +1276,16 @@ void IdoMysqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool
 
 void IdoMysqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
 {
-	m_QueryQueue.Enqueue(boost::bind(&IdoMysqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age), true);
+	/* the cleanup queries use their own session if there are writer sessions */
+	WorkQueue& queue = m_Sessions.size() > 1 ? m_Sessions[1]->Queue : m_Sessions[0]->Queue;
+	queue.Enqueue(boost::bind(&IdoMysqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age), true);
 }
 
 void IdoMysqlConnection::InternalCleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!CheckSession())
 		return;
 
 	AsyncQuery("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
@@ -901,5 +1307,11 @@ void IdoMysqlConnection::FillIDCache(const DbType::Ptr& type)
 
 int IdoMysqlConnection::GetPendingQueryCount(void) const
 {
-	return m_QueryQueue.GetLength();
+	size_t items = 0;
+
+	BOOST_FOREACH(const IdoMysqlSession::Ptr& session, m_Sessions) {
+		items += session->Queue.GetLength();
+	}
+
+	return items;
 }
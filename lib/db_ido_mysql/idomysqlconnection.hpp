@@ -21,9 +21,11 @@
 #define IDOMYSQLCONNECTION_H
 
 #include "db_ido_mysql/idomysqlconnection.thpp"
+#include "db_ido/dbqueryspool.hpp"
 #include "base/array.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <boost/thread/recursive_mutex.hpp>
 #include <mysql.h>
 
 namespace icinga
@@ -39,6 +41,35 @@ struct IdoAsyncQuery
 	IdoAsyncCallback Callback;
 };
 
+/**
+ * A connection to the MySQL server and the work queue which uses it.
+ *
+ * @ingroup ido
+ */
+struct IdoMysqlSession
+{
+	typedef boost::shared_ptr<IdoMysqlSession> Ptr;
+
+	WorkQueue Queue;
+
+	MYSQL Connection;
+	bool Connected;
+	double NextConnect;
+	int AffectedRows;
+	int MaxPacketSize;
+
+	std::vector<IdoAsyncQuery> AsyncQueries;
+
+	String InsertTable;
+	String InsertColumns;
+	std::vector<String> InsertRows;
+	size_t InsertBytes;
+
+	IdoMysqlSession(void)
+		: Queue(500000), Connected(false), NextConnect(0), AffectedRows(0), MaxPacketSize(64 * 1024), InsertBytes(0)
+	{ }
+};
+
 /**
  * An IDO MySQL database connection.
  *
@@ -57,6 +88,7 @@ public:
 	virtual int GetPendingQueryCount(void) const;
 
 protected:
+	virtual void OnConfigLoaded(void);
 	virtual void Resume(void);
 	virtual void Pause(void);
 
@@ -70,17 +102,26 @@ protected:
 private:
 	DbReference m_InstanceID;
 
-	WorkQueue m_QueryQueue;
-
-	MYSQL m_Connection;
-	int m_AffectedRows;
-	int m_MaxPacketSize;
-
-	std::vector<IdoAsyncQuery> m_AsyncQueries;
+	std::vector<IdoMysqlSession::Ptr> m_Sessions;
+	boost::recursive_mutex m_ActivateMutex;
 
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
+	DbQuerySpool::Ptr m_Spool;
+	boost::mutex m_SpoolMutex;
+	bool m_SpoolDraining;
+	double m_LastSpoolWarning;
+
+	IdoMysqlSession& GetSession(void);
+	WorkQueue& GetQueryQueue(const DbQuery& query);
+	bool IsSessionConnected(const IdoMysqlSession& session) const;
+	void OpenSession(IdoMysqlSession& session);
+	void CloseSession(IdoMysqlSession& session);
+	void ResetSession(IdoMysqlSession& session);
+	void ResetWriterSession(void);
+	bool CheckSession(void);
+
 	IdoMysqlResult Query(const String& query);
 	DbReference GetLastInsertID(void);
 	int GetAffectedRows(void);
@@ -91,6 +132,9 @@ private:
 	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback());
 	void FinishAsyncQueries(bool force = false);
 
+	void AddInsertRow(const String& table, const String& columns, const String& values);
+	void FlushInsertRows(void);
+
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
@@ -108,6 +152,10 @@ private:
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
 	void InternalNewTransaction(void);
 
+	bool SpoolQuery(const DbQuery& query);
+	void DrainSpool(void);
+	static bool IsSpoolableQuery(const DbQuery& query);
+
 	virtual void ClearConfigTable(const String& table);
 
 	void ExceptionHandler(boost::exception_ptr exp);
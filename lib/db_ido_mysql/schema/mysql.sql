@@ -1385,6 +1385,21 @@ CREATE TABLE IF NOT EXISTS icinga_endpointstatus (
   PRIMARY KEY  (endpointstatus_id)
 ) ENGINE=InnoDB COMMENT='Endpoint status';
 
+-- --------------------------------------------------------
+
+--
+-- Table structure for table icinga_confighashes
+--
+
+CREATE TABLE IF NOT EXISTS icinga_confighashes (
+  confighash_id bigint(20) unsigned NOT NULL AUTO_INCREMENT,
+  instance_id bigint unsigned default 0,
+  object_id bigint(20) unsigned DEFAULT '0',
+  config_hash varchar(64) DEFAULT NULL,
+  PRIMARY KEY  (confighash_id),
+  UNIQUE KEY object_id (object_id)
+) ENGINE=InnoDB COMMENT='Config dump hashes';
+
 
 ALTER TABLE icinga_servicestatus ADD COLUMN endpoint_object_id bigint default NULL;
 ALTER TABLE icinga_hoststatus ADD COLUMN endpoint_object_id bigint default NULL;
@@ -1603,6 +1618,6 @@ CREATE INDEX commenthistory_delete_idx ON icinga_commenthistory (instance_id, co
 -- -----------------------------------------
 -- set dbversion
 -- -----------------------------------------
-INSERT INTO icinga_dbversion (name, version, create_time, modify_time) VALUES ('idoutils', '1.14.0', NOW(), NOW()) ON DUPLICATE KEY UPDATE version='1.14.0', modify_time=NOW();
+INSERT INTO icinga_dbversion (name, version, create_time, modify_time) VALUES ('idoutils', '1.14.1', NOW(), NOW()) ON DUPLICATE KEY UPDATE version='1.14.1', modify_time=NOW();
 
 
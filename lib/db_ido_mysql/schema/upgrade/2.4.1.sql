@@ -0,0 +1,27 @@
+-- -----------------------------------------
+-- upgrade path for Icinga 2.4.1
+--
+-- -----------------------------------------
+-- Copyright (c) 2015 Icinga Development Team (http://www.icinga.org)
+--
+-- Please check http://docs.icinga.org for upgrading information!
+-- -----------------------------------------
+
+-- -----------------------------------------
+-- incremental config dump
+-- -----------------------------------------
+
+CREATE TABLE IF NOT EXISTS icinga_confighashes (
+  confighash_id bigint(20) unsigned NOT NULL AUTO_INCREMENT,
+  instance_id bigint unsigned default 0,
+  object_id bigint(20) unsigned DEFAULT '0',
+  config_hash varchar(64) DEFAULT NULL,
+  PRIMARY KEY  (confighash_id),
+  UNIQUE KEY object_id (object_id)
+) ENGINE=InnoDB COMMENT='Config dump hashes';
+
+-- -----------------------------------------
+-- update dbversion
+-- -----------------------------------------
+
+INSERT INTO icinga_dbversion (name, version, create_time, modify_time) VALUES ('idoutils', '1.14.1', NOW(), NOW()) ON DUPLICATE KEY UPDATE version='1.14.1', modify_time=NOW();
@@ -135,6 +135,7 @@ void IdoPgsqlConnection::TxTimerHandler(void)
 void IdoPgsqlConnection::NewTransaction(void)
 {
 	m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::InternalNewTransaction, this), true);
+	m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::FinishAsyncQueries, this, true));
 }
 
 void IdoPgsqlConnection::InternalNewTransaction(void)
@@ -144,8 +145,8 @@ void IdoPgsqlConnection::InternalNewTransaction(void)
 	if (!GetConnected())
 		return;
 
-	Query("COMMIT");
-	Query("BEGIN");
+	AsyncQuery("COMMIT");
+	AsyncQuery("BEGIN");
 }
 
 void IdoPgsqlConnection::ReconnectTimerHandler(void)
@@ -181,6 +182,10 @@ void IdoPgsqlConnection::Reconnect(void)
 
 		ClearIDCache();
 
+		/* queries for the old connection refer to IDs we've just discarded */
+		m_AsyncQueries.clear();
+		m_InsertRows.clear();
+
 		String ihost, iport, iuser, ipasswd, idb;
 		const char *host, *port, *user , *passwd, *db;
 
@@ -322,7 +327,12 @@ void IdoPgsqlConnection::Reconnect(void)
 		PrepareDatabase();
 
 		std::ostringstream q1buf;
-		q1buf << "SELECT object_id, objecttype_id, name1, name2, is_active FROM " + GetTablePrefix() + "objects WHERE instance_id = " << static_cast<long>(m_InstanceID);
+		if (IsIncrementalConfigDump()) {
+			q1buf << "SELECT o.object_id, o.objecttype_id, o.name1, o.name2, o.is_active, COALESCE(h.config_hash, '') AS config_hash FROM " + GetTablePrefix() + "objects o "
+			    "LEFT JOIN " + GetTablePrefix() + "confighashes h ON h.object_id = o.object_id WHERE o.instance_id = " << static_cast<long>(m_InstanceID);
+		} else {
+			q1buf << "SELECT object_id, objecttype_id, name1, name2, is_active FROM " + GetTablePrefix() + "objects WHERE instance_id = " << static_cast<long>(m_InstanceID);
+		}
 		result = Query(q1buf.str());
 
 		int index = 0;
@@ -338,6 +348,9 @@ void IdoPgsqlConnection::Reconnect(void)
 			SetObjectID(dbobj, DbReference(row->Get("object_id")));
 			SetObjectActive(dbobj, row->Get("is_active"));
 
+			if (row->Contains("config_hash"))
+				SetConfigHash(dbobj, row->Get("config_hash"));
+
 			if (GetObjectActive(dbobj))
 				active_dbobjs.push_back(dbobj);
 		}
@@ -354,6 +367,9 @@ void IdoPgsqlConnection::Reconnect(void)
 			    << "Deactivate deleted object name1: '" << dbobj->GetName1()
 			    << "' name2: '" << dbobj->GetName2() + "'.";
 			DeactivateObject(dbobj);
+
+			if (IsIncrementalConfigDump())
+				RemoveObjectConfig(dbobj);
 		}
 	}
 }
@@ -363,10 +379,166 @@ void IdoPgsqlConnection::ClearConfigTable(const String& table)
 	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " + Convert::ToString(static_cast<long>(m_InstanceID)));
 }
 
+void IdoPgsqlConnection::AsyncQuery(const String& query, const IdoPgsqlAsyncCallback& callback)
+{
+	AssertOnWorkQueue();
+
+	/* pending multi-row inserts have to be sent first to maintain the right order for queries */
+	FlushInsertRows();
+
+	IdoPgsqlAsyncQuery aq;
+	aq.Query = query;
+	aq.Callback = callback;
+	m_AsyncQueries.push_back(aq);
+
+	if (m_AsyncQueries.size() > 500)
+		FinishAsyncQueries(true);
+	else
+		m_QueryQueue.Enqueue(boost::bind(&IdoPgsqlConnection::FinishAsyncQueries, this, false));
+}
+
+void IdoPgsqlConnection::FinishAsyncQueries(bool force)
+{
+	/* m_Connection isn't valid anymore, the queries are discarded when reconnecting */
+	if (!GetConnected())
+		return;
+
+	if (force)
+		FlushInsertRows();
+
+	if (m_AsyncQueries.size() < 10 && !force)
+		return;
+
+	std::vector<IdoPgsqlAsyncQuery> queries;
+	m_AsyncQueries.swap(queries);
+
+	if (queries.empty())
+		return;
+
+	std::ostringstream querybuf;
+
+	for (std::vector<IdoPgsqlAsyncQuery>::size_type i = 0; i < queries.size(); i++) {
+		if (i > 0)
+			querybuf << ";";
+
+		IncreaseQueryCount();
+
+		querybuf << queries[i].Query;
+	}
+
+	String query = querybuf.str();
+
+	/* all statements are sent in a single round trip, the server returns one result per statement */
+	if (!PQsendQuery(m_Connection, query.CStr())) {
+		String message = PQerrorMessage(m_Connection);
+		Log(LogCritical, "IdoPgsqlConnection")
+		    << "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+		    database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	std::vector<std::pair<IdoPgsqlResult, int> > results;
+	String message;
+
+	/* The results have to be fetched before invoking the callbacks because
+	 * those might have to run queries on their own. */
+	PGresult *result;
+	while ((result = PQgetResult(m_Connection))) {
+		ExecStatusType status = PQresultStatus(result);
+
+		if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK) {
+			if (message.IsEmpty())
+				message = PQresultErrorMessage(result);
+
+			PQclear(result);
+			continue;
+		}
+
+		int affectedRows = atoi(PQcmdTuples(result));
+
+		IdoPgsqlResult iresult;
+
+		if (status == PGRES_TUPLES_OK)
+			iresult = IdoPgsqlResult(result, std::ptr_fun(PQclear));
+		else
+			PQclear(result);
+
+		results.push_back(std::make_pair(iresult, affectedRows));
+	}
+
+	if (message.IsEmpty() && results.size() != queries.size())
+		message = PQerrorMessage(m_Connection);
+
+	if (!message.IsEmpty()) {
+		Log(LogCritical, "IdoPgsqlConnection")
+		    << "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+		    database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	for (std::vector<IdoPgsqlAsyncQuery>::size_type i = 0; i < queries.size(); i++) {
+		m_AffectedRows = results[i].second;
+
+		if (queries[i].Callback)
+			queries[i].Callback(results[i].first);
+	}
+}
+
+void IdoPgsqlConnection::AddInsertRow(const String& table, const String& columns, const String& values)
+{
+	AssertOnWorkQueue();
+
+	if (!m_InsertRows.empty() && (table != m_InsertTable || columns != m_InsertColumns || m_InsertRows.size() >= 500))
+		FlushInsertRows();
+
+	if (m_InsertRows.empty()) {
+		m_InsertTable = table;
+		m_InsertColumns = columns;
+	}
+
+	m_InsertRows.push_back(values);
+}
+
+void IdoPgsqlConnection::FlushInsertRows(void)
+{
+	if (m_InsertRows.empty())
+		return;
+
+	std::vector<String> rows;
+	m_InsertRows.swap(rows);
+
+	std::ostringstream qbuf;
+	qbuf << "INSERT INTO " << GetTablePrefix() << m_InsertTable << " (" << m_InsertColumns << ") VALUES ";
+
+	for (std::vector<String>::size_type i = 0; i < rows.size(); i++) {
+		if (i > 0) {
+			qbuf << ", ";
+
+			/* keep the query statistics comparable to single-row inserts */
+			IncreaseQueryCount();
+		}
+
+		qbuf << "(" << rows[i] << ")";
+	}
+
+	AsyncQuery(qbuf.str());
+}
+
 IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 {
 	AssertOnWorkQueue();
 
+	/* finish all async queries to maintain the right order for queries */
+	FinishAsyncQueries(true);
+
 	Log(LogDebug, "IdoPgsqlConnection")
 	    << "Query: " << query;
 
@@ -503,7 +675,7 @@ void IdoPgsqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
 		SetObjectID(dbobj, GetSequenceValue(GetTablePrefix() + "objects", "object_id"));
 	} else {
 		qbuf << "UPDATE " + GetTablePrefix() + "objects SET is_active = 1 WHERE object_id = " << static_cast<long>(dbref);
-		Query(qbuf.str());
+		AsyncQuery(qbuf.str());
 	}
 }
 
@@ -526,7 +698,7 @@ void IdoPgsqlConnection::InternalDeactivateObject(const DbObject::Ptr& dbobj)
 
 	std::ostringstream qbuf;
 	qbuf << "UPDATE " + GetTablePrefix() + "objects SET is_active = 0 WHERE object_id = " << static_cast<long>(dbref);
-	Query(qbuf.str());
+	AsyncQuery(qbuf.str());
 
 	/* Note that we're _NOT_ clearing the db refs via SetReference/SetConfigUpdate/SetStatusUpdate
 	 * because the object is still in the database. */
@@ -605,6 +777,9 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType
 {
 	AssertOnWorkQueue();
 
+	if (!typeOverride)
+		TakeStatusUpdateQuery(query);
+
 	if ((query.Category & GetCategories()) == 0)
 		return;
 
@@ -705,15 +880,31 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, DbQueryType
 				first = false;
 		}
 
-		if (type == DbQueryInsert)
+		if (type == DbQueryInsert) {
+			if (IsBatchableInsert(query)) {
+				AddInsertRow(query.Table, colbuf.str(), valbuf.str());
+				return;
+			}
+
 			qbuf << " (" << colbuf.str() << ") VALUES (" << valbuf.str() << ")";
+		}
 	}
 
 	if (type != DbQueryInsert)
 		qbuf << where.str();
 
-	Query(qbuf.str());
+	/* CURRVAL() has to be queried right after the insert, so we can't use an async query here */
+	if (type == DbQueryInsert && ((query.Object && query.ConfigUpdate) || query.NotificationObject)) {
+		Query(qbuf.str());
+		FinishExecuteQuery(query, type, upsert);
+		return;
+	}
 
+	AsyncQuery(qbuf.str(), boost::bind(&IdoPgsqlConnection::FinishExecuteQuery, this, query, type, upsert));
+}
+
+void IdoPgsqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool upsert)
+{
 	if (upsert && GetAffectedRows() == 0) {
 		DbQueryType to = DbQueryInsert;
 		InternalExecuteQuery(query, &to);
@@ -756,7 +947,7 @@ void IdoPgsqlConnection::InternalCleanUpExecuteQuery(const String& table, const
 	if (!GetConnected())
 		return;
 
-	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
+	AsyncQuery("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
 	    Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
 	    " < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ")");
 }
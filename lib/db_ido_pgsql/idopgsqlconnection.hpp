@@ -31,6 +31,14 @@ namespace icinga
 
 typedef boost::shared_ptr<PGresult> IdoPgsqlResult;
 
+typedef boost::function<void (const IdoPgsqlResult&)> IdoPgsqlAsyncCallback;
+
+struct IdoPgsqlAsyncQuery
+{
+	String Query;
+	IdoPgsqlAsyncCallback Callback;
+};
+
 /**
  * An IDO pgSQL database connection.
  *
@@ -67,6 +75,12 @@ private:
 	PGconn *m_Connection;
 	int m_AffectedRows;
 
+	std::vector<IdoPgsqlAsyncQuery> m_AsyncQueries;
+
+	String m_InsertTable;
+	String m_InsertColumns;
+	std::vector<String> m_InsertRows;
+
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
@@ -76,6 +90,12 @@ private:
 	String Escape(const String& s);
 	Dictionary::Ptr FetchRow(const IdoPgsqlResult& result, int row);
 
+	void AsyncQuery(const String& query, const IdoPgsqlAsyncCallback& callback = IdoPgsqlAsyncCallback());
+	void FinishAsyncQueries(bool force = false);
+
+	void AddInsertRow(const String& table, const String& columns, const String& values);
+	void FlushInsertRows(void);
+
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
@@ -90,6 +110,7 @@ private:
 	void ReconnectTimerHandler(void);
 
 	void InternalExecuteQuery(const DbQuery& query, DbQueryType *typeOverride = NULL);
+	void FinishExecuteQuery(const DbQuery& query, int type, bool upsert);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
 
 	virtual void ClearConfigTable(const String& table);
@@ -1413,6 +1413,21 @@ CREATE TABLE  icinga_endpointstatus (
   CONSTRAINT UQ_endpointstatus UNIQUE (endpoint_object_id)
 ) ;
 
+-- --------------------------------------------------------
+
+--
+-- Table structure for table icinga_confighashes
+--
+
+CREATE TABLE  icinga_confighashes (
+  confighash_id bigserial,
+  instance_id bigint default 0,
+  object_id bigint default 0,
+  config_hash text DEFAULT NULL,
+  CONSTRAINT PK_confighash_id PRIMARY KEY (confighash_id) ,
+  CONSTRAINT UQ_confighashes UNIQUE (object_id)
+) ;
+
 
 ALTER TABLE icinga_servicestatus ADD COLUMN endpoint_object_id bigint default NULL;
 ALTER TABLE icinga_hoststatus ADD COLUMN endpoint_object_id bigint default NULL;
@@ -1633,5 +1648,5 @@ CREATE INDEX commenthistory_delete_idx ON icinga_commenthistory (instance_id, co
 -- set dbversion
 -- -----------------------------------------
 
-SELECT updatedbversion('1.14.0');
+SELECT updatedbversion('1.14.1');
 
@@ -0,0 +1,27 @@
+-- -----------------------------------------
+-- upgrade path for Icinga 2.4.1
+--
+-- -----------------------------------------
+-- Copyright (c) 2015 Icinga Development Team (http://www.icinga.org)
+--
+-- Please check http://docs.icinga.org for upgrading information!
+-- -----------------------------------------
+
+-- -----------------------------------------
+-- incremental config dump
+-- -----------------------------------------
+
+CREATE TABLE IF NOT EXISTS icinga_confighashes (
+  confighash_id bigserial,
+  instance_id bigint default 0,
+  object_id bigint default 0,
+  config_hash text DEFAULT NULL,
+  CONSTRAINT PK_confighash_id PRIMARY KEY (confighash_id) ,
+  CONSTRAINT UQ_confighashes UNIQUE (object_id)
+) ;
+
+-- -----------------------------------------
+-- update dbversion
+-- -----------------------------------------
+
+SELECT updatedbversion('1.14.1');
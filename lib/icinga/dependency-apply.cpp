@@ -156,12 +156,12 @@ void Dependency::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("Dependency")) {
-		if (rule.GetTargetType() != "Host")
-			continue;
+	Dictionary::Ptr locals = new Dictionary();
+	locals->Set("host", host);
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Dependency", "Host", locals)) {
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
 
@@ -169,11 +169,12 @@ void Dependency::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" + service->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("Dependency")) {
-		if (rule.GetTargetType() != "Service")
-			continue;
+	Dictionary::Ptr locals = new Dictionary();
+	locals->Set("host", service->GetHost());
+	locals->Set("service", service);
 
-		if (EvaluateApplyRule(service, rule))
-			rule.AddMatch();
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Dependency", "Service", locals)) {
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
 	}
 }
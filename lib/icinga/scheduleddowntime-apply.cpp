@@ -154,12 +154,12 @@ void ScheduledDowntime::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("ScheduledDowntime")) {
-		if (rule.GetTargetType() != "Host")
-			continue;
+	Dictionary::Ptr locals = new Dictionary();
+	locals->Set("host", host);
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("ScheduledDowntime", "Host", locals)) {
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
 
@@ -167,11 +167,12 @@ void ScheduledDowntime::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" + service->GetName() + "'");
 
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("ScheduledDowntime")) {
-		if (rule.GetTargetType() != "Service")
-			continue;
+	Dictionary::Ptr locals = new Dictionary();
+	locals->Set("host", service->GetHost());
+	locals->Set("service", service);
 
-		if (EvaluateApplyRule(service, rule))
-			rule.AddMatch();
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("ScheduledDowntime", "Service", locals)) {
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
 	}
 }
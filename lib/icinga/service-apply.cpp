@@ -140,10 +140,13 @@ bool Service::EvaluateApplyRule(const Host::Ptr& host, const ApplyRule& rule)
 
 void Service::EvaluateApplyRules(const Host::Ptr& host)
 {
-	BOOST_FOREACH(ApplyRule& rule, ApplyRule::GetRules("Service")) {
-		CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
+	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+	Dictionary::Ptr locals = new Dictionary();
+	locals->Set("host", host);
+
+	BOOST_FOREACH(ApplyRule *rule, ApplyRule::GetCandidateRules("Service", String(), locals)) {
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
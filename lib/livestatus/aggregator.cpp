@@ -29,6 +29,15 @@ void Aggregator::SetFilter(const Filter::Ptr& filter)
 	m_Filter = filter;
 }
 
+/**
+ * Compiles the aggregator's filter for the specified table.
+ */
+void Aggregator::Compile(const Table::Ptr& table)
+{
+	if (m_Filter)
+		m_Filter->Compile(table);
+}
+
 Filter::Ptr Aggregator::GetFilter(void) const
 {
 	return m_Filter;
@@ -37,7 +37,12 @@ public:
 
 	virtual void Apply(const Table::Ptr& table, const Value& row) = 0;
 	virtual double GetResult(void) const = 0;
+
+	virtual Aggregator::Ptr Clone(void) const = 0;
+	virtual void Merge(const Aggregator::Ptr& other) = 0;
+
 	void SetFilter(const Filter::Ptr& filter);
+	void Compile(const Table::Ptr& table);
 
 protected:
 	Aggregator(void);
@@ -34,3 +34,17 @@ bool AndFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return true;
 }
+
+/**
+ * Uses the first sub-filter which can be answered by an index. The
+ * other sub-filters are applied to the rows afterwards.
+ */
+bool AndFilter::GetIndexedRows(const Table::Ptr& table, std::vector<Value>& rows)
+{
+	BOOST_FOREACH(const Filter::Ptr& filter, m_Filters) {
+		if (filter->GetIndexedRows(table, rows))
+			return true;
+	}
+
+	return false;
+}
@@ -22,27 +22,93 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
+#include "base/debug.hpp"
 #include <boost/foreach.hpp>
-#include <boost/regex.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 using namespace icinga;
 
 AttributeFilter::AttributeFilter(const String& column, const String& op, const String& operand)
-	: m_Column(column), m_Operator(op), m_Operand(operand)
+	: m_Column(column), m_Operator(op), m_Operand(operand), m_CompiledOperator(AttributeFilterUnknown),
+	  m_NumericOperand(false), m_NumericValue(0), m_ValidRegex(false)
 { }
 
+bool AttributeFilter::GetIndexedRows(const Table::Ptr& table, std::vector<Value>& rows)
+{
+	return table->GetIndexedRows(m_Column, m_Operator, m_Operand, rows);
+}
+
+/**
+ * Resolves the column accessor, the operator and the operand once so that
+ * Apply() doesn't have to do this for every row. Regular expressions are
+ * compiled here as well.
+ */
+void AttributeFilter::Compile(const Table::Ptr& table)
+{
+	if (m_Table == table)
+		return;
+
+	/* throws for unknown columns; leave the filter untouched in that case */
+	boost::shared_ptr<Column> column = boost::make_shared<Column>(table->GetColumn(m_Column));
+
+	if (m_Operator == "=")
+		m_CompiledOperator = AttributeFilterEqual;
+	else if (m_Operator == "~")
+		m_CompiledOperator = AttributeFilterRegex;
+	else if (m_Operator == "=~")
+		m_CompiledOperator = AttributeFilterEqualNoCase;
+	else if (m_Operator == "~~")
+		m_CompiledOperator = AttributeFilterRegexNoCase;
+	else if (m_Operator == "<")
+		m_CompiledOperator = AttributeFilterLessThan;
+	else if (m_Operator == ">")
+		m_CompiledOperator = AttributeFilterGreaterThan;
+	else if (m_Operator == "<=")
+		m_CompiledOperator = AttributeFilterLessThanOrEqual;
+	else if (m_Operator == ">=")
+		m_CompiledOperator = AttributeFilterGreaterThanOrEqual;
+	else
+		m_CompiledOperator = AttributeFilterUnknown;
+
+	try {
+		m_NumericValue = Convert::ToDouble(m_Operand);
+		m_NumericOperand = true;
+	} catch (const std::exception&) {
+		m_NumericOperand = false;
+	}
+
+	if (m_CompiledOperator == AttributeFilterRegex || m_CompiledOperator == AttributeFilterRegexNoCase) {
+		try {
+			if (m_CompiledOperator == AttributeFilterRegexNoCase)
+				m_Regex.assign(m_Operand.GetData(), boost::regex::icase);
+			else
+				m_Regex.assign(m_Operand.GetData());
+
+			m_ValidRegex = true;
+		} catch (const std::exception&) {
+			Log(LogWarning, "AttributeFilter")
+			    << "Regex '" << m_Operand << "' for column '" << m_Column << "' is invalid.";
+			m_ValidRegex = false;
+		}
+	}
+
+	m_ColumnAccessor = column;
+	m_Table = table;
+}
+
 bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 {
-	Column column = table->GetColumn(m_Column);
+	if (m_Table != table)
+		Compile(table);
 
-	Value value = column.ExtractValue(row);
+	Value value = m_ColumnAccessor->ExtractValue(row);
 
 	if (value.IsObjectType<Array>()) {
 		Array::Ptr array = value;
 
-		if (m_Operator == ">=" || m_Operator == "<") {
-			bool negate = (m_Operator == "<");
+		if (m_CompiledOperator == AttributeFilterGreaterThanOrEqual || m_CompiledOperator == AttributeFilterLessThan) {
+			bool negate = (m_CompiledOperator == AttributeFilterLessThan);
 
 			ObjectLock olock(array);
 			BOOST_FOREACH(const String& item, array) {
@@ -51,88 +117,78 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 			}
 
 			return negate; /* Item not found in list. */
-		} else if (m_Operator == "=") {
+		} else if (m_CompiledOperator == AttributeFilterEqual) {
 			return (array->GetLength() == 0);
 		} else {
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid operator for column '" + m_Column + "': " + m_Operator + " (expected '>=' or '=')."));
 		}
-	} else {
-		if (m_Operator == "=") {
-			if (value.GetType() == ValueNumber || value.GetType() == ValueBoolean)
-				return (static_cast<double>(value) == Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) == m_Operand);
-		} else if (m_Operator == "~") {
-			bool ret;
-			try {
-				boost::regex expr(m_Operand.GetData());
-				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-				    << "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
+	}
 
-			//Log(LogDebug, "LivestatusListener/AttributeFilter")
-			//    << "Attribute filter '" << m_Operand + " " << m_Operator << " "
-			//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
-
-			return ret;
-		} else if (m_Operator == "=~") {
-			bool ret;
-			try {
-				String operand = value;
-				ret = boost::iequals(operand, m_Operand.GetData());
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-				    << "Case-insensitive equality '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
+	if (m_CompiledOperator == AttributeFilterUnknown)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown operator for column '" + m_Column + "': " + m_Operator));
 
-			return ret;
-		} else if (m_Operator == "~~") {
-			bool ret;
-			try {
-				boost::regex expr(m_Operand.GetData(), boost::regex::icase);
-				String operand = value;
-				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
-			} catch (boost::exception&) {
-				Log(LogWarning, "AttributeFilter")
-				    << "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
-				ret = false;
-			}
+	if (value.GetType() == ValueNumber || (value.GetType() == ValueBoolean && m_CompiledOperator == AttributeFilterEqual)) {
+		switch (m_CompiledOperator) {
+			case AttributeFilterEqual:
+			case AttributeFilterLessThan:
+			case AttributeFilterGreaterThan:
+			case AttributeFilterLessThanOrEqual:
+			case AttributeFilterGreaterThanOrEqual:
+				return CompareNumber(value);
+			default:
+				break;
+		}
+	}
 
-			//Log(LogDebug, "LivestatusListener/AttributeFilter")
-			//    << "Attribute filter '" << m_Operand << " " << m_Operator << " "
-			//    << value << "' " << (ret ? "matches" : "doesn't match") << ".";
+	return CompareString(value);
+}
 
-			return ret;
-		} else if (m_Operator == "<") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) < Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) < m_Operand);
-		} else if (m_Operator == ">") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) > Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) > m_Operand);
-		} else if (m_Operator == "<=") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) <= Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) <= m_Operand);
-		} else if (m_Operator == ">=") {
-			if (value.GetType() == ValueNumber)
-				return (static_cast<double>(value) >= Convert::ToDouble(m_Operand));
-			else
-				return (static_cast<String>(value) >= m_Operand);
-		} else {
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown operator for column '" + m_Column + "': " + m_Operator));
-		}
+bool AttributeFilter::CompareNumber(double value) const
+{
+	if (!m_NumericOperand)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Can't convert '" + m_Operand + "' to a floating point number."));
+
+	switch (m_CompiledOperator) {
+		case AttributeFilterEqual:
+			return (value == m_NumericValue);
+		case AttributeFilterLessThan:
+			return (value < m_NumericValue);
+		case AttributeFilterGreaterThan:
+			return (value > m_NumericValue);
+		case AttributeFilterLessThanOrEqual:
+			return (value <= m_NumericValue);
+		case AttributeFilterGreaterThanOrEqual:
+			return (value >= m_NumericValue);
+		default:
+			VERIFY(!"Invalid numeric operator.");
+	}
+
+	return false;
+}
+
+bool AttributeFilter::CompareString(const String& value) const
+{
+	switch (m_CompiledOperator) {
+		case AttributeFilterEqual:
+			return (value == m_Operand);
+		case AttributeFilterRegex:
+		case AttributeFilterRegexNoCase:
+			if (!m_ValidRegex)
+				return false;
+
+			return boost::regex_search(value.GetData(), m_Regex);
+		case AttributeFilterEqualNoCase:
+			return boost::iequals(value, m_Operand.GetData());
+		case AttributeFilterLessThan:
+			return (value < m_Operand);
+		case AttributeFilterGreaterThan:
+			return (value > m_Operand);
+		case AttributeFilterLessThanOrEqual:
+			return (value <= m_Operand);
+		case AttributeFilterGreaterThanOrEqual:
+			return (value >= m_Operand);
+		default:
+			VERIFY(!"Invalid string operator.");
 	}
 
 	return false;
@@ -21,12 +21,27 @@
 #define ATTRIBUTEFILTER_H
 
 #include "livestatus/filter.hpp"
+#include <boost/regex.hpp>
+#include <boost/shared_ptr.hpp>
 
 using namespace icinga;
 
 namespace icinga
 {
 
+enum AttributeFilterOperator
+{
+	AttributeFilterEqual,
+	AttributeFilterRegex,
+	AttributeFilterEqualNoCase,
+	AttributeFilterRegexNoCase,
+	AttributeFilterLessThan,
+	AttributeFilterGreaterThan,
+	AttributeFilterLessThanOrEqual,
+	AttributeFilterGreaterThanOrEqual,
+	AttributeFilterUnknown
+};
+
 /**
  * @ingroup livestatus
  */
@@ -38,11 +53,26 @@ public:
 	AttributeFilter(const String& column, const String& op, const String& operand);
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row);
+	virtual bool GetIndexedRows(const Table::Ptr& table, std::vector<Value>& rows);
+	virtual void Compile(const Table::Ptr& table);
 
 protected:
 	String m_Column;
 	String m_Operator;
 	String m_Operand;
+
+private:
+	/* state prepared by Compile() for the table the filter is applied to */
+	Table::Ptr m_Table;
+	boost::shared_ptr<Column> m_ColumnAccessor;
+	AttributeFilterOperator m_CompiledOperator;
+	bool m_NumericOperand;
+	double m_NumericValue;
+	bool m_ValidRegex;
+	boost::regex m_Regex;
+
+	bool CompareNumber(double value) const;
+	bool CompareString(const String& value) const;
 };
 
 }
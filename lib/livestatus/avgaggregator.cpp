@@ -39,3 +39,18 @@ double AvgAggregator::GetResult(void) const
 {
 	return (m_Avg / m_AvgCount);
 }
+
+Aggregator::Ptr AvgAggregator::Clone(void) const
+{
+	Aggregator::Ptr aggregator = new AvgAggregator(m_AvgAttr);
+	aggregator->SetFilter(GetFilter());
+	return aggregator;
+}
+
+void AvgAggregator::Merge(const Aggregator::Ptr& other)
+{
+	AvgAggregator::Ptr aggregator = static_pointer_cast<AvgAggregator>(other);
+
+	m_Avg += aggregator->m_Avg;
+	m_AvgCount += aggregator->m_AvgCount;
+}
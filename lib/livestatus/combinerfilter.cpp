@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "livestatus/combinerfilter.hpp"
+#include <boost/foreach.hpp>
 
 using namespace icinga;
 
@@ -28,3 +29,9 @@ void CombinerFilter::AddSubFilter(const Filter::Ptr& filter)
 {
 	m_Filters.push_back(filter);
 }
+
+void CombinerFilter::Compile(const Table::Ptr& table)
+{
+	BOOST_FOREACH(const Filter::Ptr& filter, m_Filters)
+		filter->Compile(table);
+}
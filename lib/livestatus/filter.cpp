@@ -23,3 +23,21 @@ using namespace icinga;
 
 Filter::Filter(void)
 { }
+
+/**
+ * Looks up the candidate rows for this filter using the table's indexes.
+ * The rows still have to be checked with Apply().
+ *
+ * @returns false if the filter can't be answered by an index.
+ */
+bool Filter::GetIndexedRows(const Table::Ptr&, std::vector<Value>&)
+{
+	return false;
+}
+
+/**
+ * Prepares the filter for being applied to rows from the specified table.
+ * This must be called before the filter is used from multiple threads.
+ */
+void Filter::Compile(const Table::Ptr&)
+{ }
@@ -35,6 +35,8 @@ public:
 	DECLARE_PTR_TYPEDEFS(Filter);
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row) = 0;
+	virtual bool GetIndexedRows(const Table::Ptr& table, std::vector<Value>& rows);
+	virtual void Compile(const Table::Ptr& table);
 
 protected:
 	Filter(void);
@@ -202,6 +202,38 @@ void HostsTable::FetchRows(const AddRowFunction& addRowFn)
 	}
 }
 
+bool HostsTable::FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows)
+{
+	String prefix;
+
+	if (column == "name" && op == "=") {
+		Host::Ptr host = Host::GetByName(operand);
+
+		if (host)
+			rows.push_back(host);
+
+		return true;
+	} else if (column == "name" && op == "~" && GetRegexPrefix(operand, &prefix)) {
+		BOOST_FOREACH(const DynamicObject::Ptr& host, DynamicType::GetByName("Host")->GetObjectsByPrefix(prefix)) {
+			rows.push_back(host);
+		}
+
+		return true;
+	} else if (column == "groups" && op == ">=") {
+		HostGroup::Ptr hg = HostGroup::GetByName(operand);
+
+		if (hg) {
+			BOOST_FOREACH(const Host::Ptr& host, hg->GetMembers()) {
+				rows.push_back(host);
+			}
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
 Object::Ptr HostsTable::HostGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	/* return the current group by value set from within FetchRows()
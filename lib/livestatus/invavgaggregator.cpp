@@ -39,3 +39,18 @@ double InvAvgAggregator::GetResult(void) const
 {
 	return (m_InvAvg / m_InvAvgCount);
 }
+
+Aggregator::Ptr InvAvgAggregator::Clone(void) const
+{
+	Aggregator::Ptr aggregator = new InvAvgAggregator(m_InvAvgAttr);
+	aggregator->SetFilter(GetFilter());
+	return aggregator;
+}
+
+void InvAvgAggregator::Merge(const Aggregator::Ptr& other)
+{
+	InvAvgAggregator::Ptr aggregator = static_pointer_cast<InvAvgAggregator>(other);
+
+	m_InvAvg += aggregator->m_InvAvg;
+	m_InvAvgCount += aggregator->m_InvAvgCount;
+}
@@ -38,3 +38,17 @@ double InvSumAggregator::GetResult(void) const
 {
 	return m_InvSum;
 }
+
+Aggregator::Ptr InvSumAggregator::Clone(void) const
+{
+	Aggregator::Ptr aggregator = new InvSumAggregator(m_InvSumAttr);
+	aggregator->SetFilter(GetFilter());
+	return aggregator;
+}
+
+void InvSumAggregator::Merge(const Aggregator::Ptr& other)
+{
+	InvSumAggregator::Ptr aggregator = static_pointer_cast<InvSumAggregator>(other);
+
+	m_InvSum += aggregator->m_InvSum;
+}
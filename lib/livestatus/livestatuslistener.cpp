@@ -19,6 +19,7 @@
 
 #include "livestatus/livestatuslistener.hpp"
 #include "livestatus/livestatuslistener.tcpp"
+#include "livestatus/livestatuslogstore.hpp"
 #include "icinga/perfdatavalue.hpp"
 #include "base/utility.hpp"
 #include "base/objectlock.hpp"
@@ -40,9 +41,14 @@ REGISTER_TYPE(LivestatusListener);
 static int l_ClientsConnected = 0;
 static int l_Connections = 0;
 static boost::mutex l_ComponentMutex;
+static boost::condition_variable l_ClientsCV;
 
 REGISTER_STATSFUNCTION(LivestatusListenerStats, &LivestatusListener::StatsFunc);
 
+LivestatusListener::LivestatusListener(void)
+	: m_ClientsConnected(0)
+{ }
+
 void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	Dictionary::Ptr nodes = new Dictionary();
@@ -66,6 +72,9 @@ void LivestatusListener::Start(void)
 {
 	DynamicObject::Start();
 
+	/* index the compat log files for history queries in the background */
+	LivestatusLogStore::GetInstance(GetCompatLogPath())->Start();
+
 	if (GetSocketType() == "tcp") {
 		TcpSocket::Ptr socket = new TcpSocket();
 
@@ -149,11 +158,35 @@ void LivestatusListener::ServerThreadProc(void)
 
 	try {
 		for (;;) {
+			int maxClients = GetMaxClients();
+
+			if (maxClients > 0) {
+				boost::mutex::scoped_lock lock(l_ComponentMutex);
+
+				/* leave new connections in the listen backlog until a client session has finished */
+				if (m_ClientsConnected >= maxClients) {
+					l_ClientsCV.timed_wait(lock, boost::posix_time::milliseconds(500));
+
+					if (!IsActive())
+						break;
+
+					continue;
+				}
+			}
+
 			timeval tv = { 0, 500000 };
 
 			if (m_Listener->Poll(true, false, &tv)) {
 				Socket::Ptr client = m_Listener->Accept();
 				Log(LogNotice, "LivestatusListener", "Client connected");
+
+				{
+					boost::mutex::scoped_lock lock(l_ComponentMutex);
+					l_ClientsConnected++;
+					l_Connections++;
+					m_ClientsConnected++;
+				}
+
 				Utility::QueueAsyncCallback(boost::bind(&LivestatusListener::ClientHandler, this, client), LowLatencyScheduler);
 			}
 
@@ -169,12 +202,6 @@ void LivestatusListener::ServerThreadProc(void)
 
 void LivestatusListener::ClientHandler(const Socket::Ptr& client)
 {
-	{
-		boost::mutex::scoped_lock lock(l_ComponentMutex);
-		l_ClientsConnected++;
-		l_Connections++;
-	}
-
 	Stream::Ptr stream = new NetworkStream(client);
 
 	for (;;) {
@@ -209,7 +236,10 @@ void LivestatusListener::ClientHandler(const Socket::Ptr& client)
 	{
 		boost::mutex::scoped_lock lock(l_ComponentMutex);
 		l_ClientsConnected--;
+		m_ClientsConnected--;
 	}
+
+	l_ClientsCV.notify_all();
 }
 
 
@@ -220,3 +250,11 @@ void LivestatusListener::ValidateSocketType(const String& value, const Validatio
 	if (value != "unix" && value != "tcp")
 		BOOST_THROW_EXCEPTION(ValidationError(this, boost::assign::list_of("socket_type"), "Socket type '" + value + "' is invalid."));
 }
+
+void LivestatusListener::ValidateMaxClients(int value, const ValidationUtils& utils)
+{
+	ObjectImpl<LivestatusListener>::ValidateMaxClients(value, utils);
+
+	if (value < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, boost::assign::list_of("max_clients"), "Maximum number of clients must not be negative."));
+}
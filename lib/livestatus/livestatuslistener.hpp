@@ -40,12 +40,15 @@ public:
 	DECLARE_OBJECT(LivestatusListener);
 	DECLARE_OBJECTNAME(LivestatusListener);
 
+	LivestatusListener(void);
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 	static int GetClientsConnected(void);
 	static int GetConnections(void);
 
 	virtual void ValidateSocketType(const String& value, const ValidationUtils& utils) override;
+	virtual void ValidateMaxClients(int value, const ValidationUtils& utils) override;
 
 protected:
 	virtual void Start(void);
@@ -57,6 +60,9 @@ private:
 
 	Socket::Ptr m_Listener;
 	boost::thread m_Thread;
+
+	/* the number of this listener's clients, protected by l_ComponentMutex */
+	int m_ClientsConnected;
 };
 
 }
@@ -0,0 +1,342 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "livestatus/livestatuslogstore.hpp"
+#include "livestatus/livestatuslogutility.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include "base/utility.hpp"
+#include <boost/foreach.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/make_shared.hpp>
+#include <fstream>
+#include <algorithm>
+
+using namespace icinga;
+
+static std::map<String, LivestatusLogStore::Ptr> l_LogStores;
+static boost::mutex l_LogStoresMutex;
+
+LivestatusLogStore::LivestatusLogStore(const String& path)
+	: m_Path(path)
+{ }
+
+/**
+ * Returns the log store for the specified compat log directory.
+ */
+LivestatusLogStore::Ptr LivestatusLogStore::GetInstance(const String& path)
+{
+	boost::mutex::scoped_lock lock(l_LogStoresMutex);
+
+	std::map<String, LivestatusLogStore::Ptr>::iterator it = l_LogStores.find(path);
+
+	if (it != l_LogStores.end())
+		return it->second;
+
+	LivestatusLogStore::Ptr store = new LivestatusLogStore(path);
+	l_LogStores[path] = store;
+
+	return store;
+}
+
+/**
+ * Starts indexing the log files in the background.
+ */
+void LivestatusLogStore::Start(void)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_Timer)
+		return;
+
+	m_Timer = new Timer();
+	m_Timer->SetInterval(30);
+	m_Timer->OnTimerExpired.connect(boost::bind(&LivestatusLogStore::TimerHandler, this));
+	m_Timer->Start();
+	m_Timer->Reschedule(0);
+}
+
+void LivestatusLogStore::TimerHandler(void)
+{
+	try {
+		Update();
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "LivestatusLogStore")
+		    << "Could not update the log index for '" << m_Path << "': " << DiagnosticInformation(ex);
+	}
+}
+
+/**
+ * Indexes new log files and lines which have been appended to known
+ * log files since the last update. Log files are read without holding
+ * the lock which is used by queries.
+ */
+void LivestatusLogStore::Update(void)
+{
+	boost::mutex::scoped_lock ulock(m_UpdateMutex);
+
+	std::map<time_t, String> index;
+	LivestatusLogUtility::CreateLogIndex(m_Path, index);
+
+	time_t expiry = static_cast<time_t>(Utility::GetTime()) - LIVESTATUS_LOGSTORE_RETENTION;
+
+	std::map<time_t, String> expired;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		/* forget about log files which have been deleted or are too old */
+		for (std::map<time_t, LogStoreFile>::iterator it = m_Files.begin(); it != m_Files.end(); ) {
+			if (index.find(it->first) == index.end() || it->first < expiry)
+				m_Files.erase(it++);
+			else
+				it++;
+		}
+	}
+
+	time_t ts;
+	String path;
+	BOOST_FOREACH(boost::tie(ts, path), index) {
+		if (ts < expiry) {
+			expired[ts] = path;
+			continue;
+		}
+
+		/* m_Files is only modified while holding m_UpdateMutex, so
+		 * the file's state can be read without holding m_Mutex */
+		LogStoreFile state;
+
+		std::map<time_t, LogStoreFile>::const_iterator it = m_Files.find(ts);
+
+		if (it != m_Files.end()) {
+			state.Path = it->second.Path;
+			state.Offset = it->second.Offset;
+			state.NextLineNo = it->second.NextLineNo;
+		}
+
+		/* the CompatLogger moves icinga.log to the archive directory
+		 * when rotating it, the contents stay the same */
+		bool complete = (Utility::BaseName(path) != "icinga.log");
+
+		bool truncated = IndexFile(state, path, complete);
+
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		LogStoreFile& file = m_Files[ts];
+
+		if (truncated)
+			file.Chunks.clear();
+
+		file.Path = state.Path;
+		file.Offset = state.Offset;
+		file.NextLineNo = state.NextLineNo;
+		file.Chunks.insert(file.Chunks.end(), state.Chunks.begin(), state.Chunks.end());
+	}
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_ExpiredFiles.swap(expired);
+}
+
+/**
+ * Reads the lines which were appended to a log file since it was last
+ * indexed and adds them to the file as a new chunk.
+ *
+ * @param file The file's state.
+ * @param path The file's path.
+ * @param complete Whether the file is no longer written to, i.e. whether
+ *                 its last line is complete even if it isn't terminated.
+ * @returns true if the file was truncated and indexed again.
+ */
+bool LivestatusLogStore::IndexFile(LogStoreFile& file, const String& path, bool complete)
+{
+	file.Path = path;
+
+	std::ifstream fp;
+	fp.open(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp)
+		return false;
+
+	fp.seekg(0, std::ifstream::end);
+	std::streamoff size = fp.tellg();
+
+	bool truncated = false;
+
+	if (size < file.Offset) {
+		Log(LogNotice, "LivestatusLogStore")
+		    << "Log file '" << path << "' was truncated, indexing it again.";
+
+		file = LogStoreFile();
+		file.Path = path;
+		truncated = true;
+	}
+
+	if (size == file.Offset)
+		return truncated;
+
+	fp.seekg(file.Offset);
+
+	Log(LogDebug, "LivestatusLogStore")
+	    << "Indexing log file '" << path << "' from offset " << file.Offset << ".";
+
+	boost::shared_ptr<LogStoreChunk> chunk = boost::make_shared<LogStoreChunk>();
+
+	std::string line;
+
+	while (std::getline(fp, line)) {
+		bool terminated = !fp.eof();
+
+		/* the last line of the current log file may not be complete yet,
+		 * it'll be indexed once the CompatLogger has finished writing it */
+		if (!terminated && !complete)
+			break;
+
+		file.Offset += line.size() + (terminated ? 1 : 0);
+
+		if (line.empty())
+			continue; /* Ignore empty lines */
+
+		Dictionary::Ptr attrs;
+
+		try {
+			attrs = LivestatusLogUtility::GetAttributes(line);
+		} catch (const std::exception&) {
+			Log(LogDebug, "LivestatusLogStore")
+			    << "Skipping invalid log line: '" << line << "'.";
+			continue;
+		}
+
+		LogStoreEntry entry;
+		entry.Time = attrs->Get("time");
+		entry.LineNo = file.NextLineNo++;
+		entry.Line = line;
+
+		String host_name = attrs->Get("host_name");
+
+		if (!host_name.IsEmpty())
+			chunk->HostIndex[host_name].push_back(chunk->Entries.size());
+
+		chunk->Entries.push_back(entry);
+	}
+
+	if (!chunk->Entries.empty())
+		file.Chunks.push_back(chunk);
+
+	return truncated;
+}
+
+/**
+ * Invokes the callback for the log lines from log files which were started
+ * between 'from' and 'until'. When a host name is specified only the lines
+ * which refer to that host (or one of its services) are returned.
+ *
+ * @param filterLines Whether to skip lines outside of the time range. The
+ *                    state history needs the lines after 'until' from the
+ *                    last log file to calculate the state durations.
+ */
+void LivestatusLogStore::ForEachEntry(time_t from, time_t until, const String& hostName, bool filterLines, const EntryCallback& callback)
+{
+	std::vector<String> expired;
+	std::vector<LogStoreChunk::Ptr> chunks;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		/* skip log files not in range (performance optimization) */
+		time_t ts;
+		String path;
+		BOOST_FOREACH(boost::tie(ts, path), m_ExpiredFiles) {
+			if (ts >= from && ts <= until)
+				expired.push_back(path);
+		}
+
+		for (std::map<time_t, LogStoreFile>::const_iterator it = m_Files.begin(); it != m_Files.end(); it++) {
+			if (it->first < from || it->first > until)
+				continue;
+
+			chunks.insert(chunks.end(), it->second.Chunks.begin(), it->second.Chunks.end());
+		}
+	}
+
+	int line_count = 0;
+
+	/* expired log files are older than the ones which are kept in memory */
+	BOOST_FOREACH(const String& path, expired) {
+		LogStoreFile file;
+		IndexFile(file, path, true);
+
+		BOOST_FOREACH(const LogStoreChunk::Ptr& chunk, file.Chunks)
+			ForEachChunkEntry(*chunk, from, until, hostName, filterLines, line_count, callback);
+	}
+
+	BOOST_FOREACH(const LogStoreChunk::Ptr& chunk, chunks)
+		ForEachChunkEntry(*chunk, from, until, hostName, filterLines, line_count, callback);
+}
+
+static bool EntryTimeLess(const LogStoreEntry& entry, time_t ts)
+{
+	return entry.Time < ts;
+}
+
+static bool TimeEntryLess(time_t ts, const LogStoreEntry& entry)
+{
+	return ts < entry.Time;
+}
+
+void LivestatusLogStore::ForEachChunkEntry(const LogStoreChunk& chunk, time_t from, time_t until, const String& hostName,
+    bool filterLines, int& line_count, const EntryCallback& callback)
+{
+	if (hostName.IsEmpty()) {
+		std::vector<LogStoreEntry>::const_iterator begin = chunk.Entries.begin(), end = chunk.Entries.end();
+
+		/* the lines are ordered by time, only parse the ones in range */
+		if (filterLines) {
+			begin = std::lower_bound(begin, end, from, EntryTimeLess);
+			end = std::upper_bound(begin, end, until, TimeEntryLess);
+		}
+
+		for (std::vector<LogStoreEntry>::const_iterator it = begin; it != end; it++) {
+			CallbackEntry(*it, line_count, callback);
+			line_count++;
+		}
+	} else {
+		std::map<String, std::vector<size_t> >::const_iterator hit = chunk.HostIndex.find(hostName);
+
+		if (hit == chunk.HostIndex.end())
+			return;
+
+		BOOST_FOREACH(size_t index, hit->second) {
+			const LogStoreEntry& entry = chunk.Entries[index];
+
+			if (filterLines && (entry.Time < from || entry.Time > until))
+				continue;
+
+			CallbackEntry(entry, line_count, callback);
+			line_count++;
+		}
+	}
+}
+
+void LivestatusLogStore::CallbackEntry(const LogStoreEntry& entry, int line_count, const EntryCallback& callback)
+{
+	/* the parsed attributes aren't kept in memory, parse the line again */
+	Dictionary::Ptr attrs = LivestatusLogUtility::GetAttributes(entry.Line);
+
+	callback(attrs, line_count, entry.LineNo);
+}
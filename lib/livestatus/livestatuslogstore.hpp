@@ -0,0 +1,124 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef LIVESTATUSLOGSTORE_H
+#define LIVESTATUSLOGSTORE_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/object.hpp"
+#include "base/dictionary.hpp"
+#include "base/timer.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <vector>
+#include <map>
+
+namespace icinga
+{
+
+/* log files which were started longer ago than this aren't kept in memory */
+#define LIVESTATUS_LOGSTORE_RETENTION (7 * 24 * 60 * 60)
+
+/**
+ * A line from a compat log file.
+ *
+ * @ingroup livestatus
+ */
+struct LogStoreEntry
+{
+	time_t Time;
+	int LineNo;
+	String Line;
+};
+
+/**
+ * The lines which were indexed by a single update of a compat log file.
+ * Chunks aren't modified once they've been added to the store, so queries
+ * can read them without holding the store's lock.
+ *
+ * @ingroup livestatus
+ */
+struct LogStoreChunk
+{
+	typedef boost::shared_ptr<const LogStoreChunk> Ptr;
+
+	std::vector<LogStoreEntry> Entries;
+	std::map<String, std::vector<size_t> > HostIndex;
+};
+
+/**
+ * The indexed lines of a compat log file.
+ *
+ * @ingroup livestatus
+ */
+struct LogStoreFile
+{
+	String Path;
+	std::streamoff Offset;
+	int NextLineNo;
+	std::vector<LogStoreChunk::Ptr> Chunks;
+
+	LogStoreFile(void)
+		: Offset(0), NextLineNo(0)
+	{ }
+};
+
+/**
+ * Keeps the lines of the recent compat log files in memory so that
+ * history queries don't have to read the log files again. Archived log
+ * files are read once, the current log file is read incrementally as the
+ * CompatLogger appends to it. Log files which are older than the retention
+ * window are read from disk when they're queried.
+ *
+ * @ingroup livestatus
+ */
+class I2_LIVESTATUS_API LivestatusLogStore : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusLogStore);
+
+	typedef boost::function<void (const Dictionary::Ptr&, int, int)> EntryCallback;
+
+	static LivestatusLogStore::Ptr GetInstance(const String& path);
+
+	void Start(void);
+	void Update(void);
+
+	void ForEachEntry(time_t from, time_t until, const String& hostName, bool filterLines, const EntryCallback& callback);
+
+private:
+	LivestatusLogStore(const String& path);
+
+	String m_Path;
+	boost::mutex m_UpdateMutex;
+	boost::mutex m_Mutex;
+	std::map<time_t, LogStoreFile> m_Files;
+	std::map<time_t, String> m_ExpiredFiles;
+	Timer::Ptr m_Timer;
+
+	void TimerHandler(void);
+	static bool IndexFile(LogStoreFile& file, const String& path, bool complete);
+	static void ForEachChunkEntry(const LogStoreChunk& chunk, time_t from, time_t until, const String& hostName,
+	    bool filterLines, int& line_count, const EntryCallback& callback);
+	static void CallbackEntry(const LogStoreEntry& entry, int line_count, const EntryCallback& callback);
+};
+
+}
+
+#endif /* LIVESTATUSLOGSTORE_H */
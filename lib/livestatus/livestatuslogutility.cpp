@@ -74,52 +74,6 @@ void LivestatusLogUtility::CreateLogIndexFileHandler(const String& path, std::ma
 	index[ts_start] = path;
 }
 
-void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, HistoryTable *table,
-    time_t from, time_t until, const AddRowFunction& addRowFn)
-{
-	ASSERT(table);
-
-	/* m_LogFileIndex map tells which log files are involved ordered by their start timestamp */
-	unsigned int ts;
-	unsigned long line_count = 0;
-	BOOST_FOREACH(boost::tie(ts, boost::tuples::ignore), index) {
-		/* skip log files not in range (performance optimization) */
-		if (ts < from || ts > until)
-			continue;
-
-		String log_file = index[ts];
-		int lineno = 0;
-
-		std::ifstream fp;
-		fp.exceptions(std::ifstream::badbit);
-		fp.open(log_file.CStr(), std::ifstream::in);
-
-		while (fp.good()) {
-			std::string line;
-			std::getline(fp, line);
-
-			if (line.empty())
-				continue; /* Ignore empty lines */
-
-			Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
-
-			/* no attributes available - invalid log line */
-			if (!log_entry_attrs) {
-				Log(LogDebug, "LivestatusLogUtility")
-				    << "Skipping invalid log line: '" << line << "'.";
-				continue;
-			}
-
-			table->UpdateLogEntries(log_entry_attrs, line_count, lineno, addRowFn);
-
-			line_count++;
-			lineno++;
-		}
-
-		fp.close();
-	}
-}
-
 Dictionary::Ptr LivestatusLogUtility::GetAttributes(const String& text)
 {
 	Dictionary::Ptr bag = new Dictionary();
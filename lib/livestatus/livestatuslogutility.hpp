@@ -65,7 +65,6 @@ class I2_LIVESTATUS_API LivestatusLogUtility
 public:
 	static void CreateLogIndex(const String& path, std::map<time_t, String>& index);
 	static void CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index);
-	static void CreateLogCache(std::map<time_t, String> index, HistoryTable *table, time_t from, time_t until, const AddRowFunction& addRowFn);
 	static Dictionary::Ptr GetAttributes(const String& text);
 
 private:
@@ -407,34 +407,67 @@ Filter::Ptr LivestatusQuery::ParseFilter(const String& params, unsigned long& fr
 
 void LivestatusQuery::PrintResultSet(std::ostream& fp, const Array::Ptr& rs) const
 {
-	if (m_OutputFormat == "csv") {
-		ObjectLock olock(rs);
-
-		BOOST_FOREACH(const Array::Ptr& row, rs) {
-			bool first = true;
-
-			ObjectLock rlock(row);
-			BOOST_FOREACH(const Value& value, row) {
-				if (first)
-					first = false;
-				else
-					fp << m_Separators[1];
-
-				if (value.IsObjectType<Array>())
-					PrintCsvArray(fp, value, 0);
-				else
-					fp << value;
-			}
+	BeginResultSet(fp);
+
+	bool first = true;
+
+	ObjectLock olock(rs);
+	BOOST_FOREACH(const Array::Ptr& row, rs) {
+		PrintResultRow(fp, row, first);
+		first = false;
+	}
+
+	EndResultSet(fp);
+}
 
-			fp << m_Separators[0];
+void LivestatusQuery::BeginResultSet(std::ostream& fp) const
+{
+	if (m_OutputFormat == "json")
+		fp << "[";
+	else if (m_OutputFormat == "python")
+		fp << "[ ";
+}
+
+void LivestatusQuery::PrintResultRow(std::ostream& fp, const Array::Ptr& row, bool first) const
+{
+	if (m_OutputFormat == "csv") {
+		bool firstValue = true;
+
+		ObjectLock rlock(row);
+		BOOST_FOREACH(const Value& value, row) {
+			if (firstValue)
+				firstValue = false;
+			else
+				fp << m_Separators[1];
+
+			if (value.IsObjectType<Array>())
+				PrintCsvArray(fp, value, 0);
+			else
+				fp << value;
 		}
+
+		fp << m_Separators[0];
 	} else if (m_OutputFormat == "json") {
-		fp << JsonEncode(rs);
+		if (!first)
+			fp << ",";
+
+		fp << JsonEncode(row);
 	} else if (m_OutputFormat == "python") {
-		PrintPythonArray(fp, rs);
+		if (!first)
+			fp << ", ";
+
+		PrintPythonArray(fp, row);
 	}
 }
 
+void LivestatusQuery::EndResultSet(std::ostream& fp) const
+{
+	if (m_OutputFormat == "json")
+		fp << "]";
+	else if (m_OutputFormat == "python")
+		fp << " ]";
+}
+
 void LivestatusQuery::PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const
 {
 	bool first = true;
@@ -505,99 +538,163 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	else
 		columns = table->GetColumnNames();
 
-	Array::Ptr rs = new Array();
+	if (m_Aggregators.empty())
+		SendRows(stream, table, objects, columns);
+	else
+		SendStats(stream, table, objects);
+}
 
-	if (m_Aggregators.empty()) {
-		Array::Ptr header = new Array();
+/**
+ * Formats the rows one at a time. Unless the client requested a fixed16
+ * header (which needs to know the length of the whole response) the
+ * output is written to the client in chunks while the remaining rows
+ * are still being formatted.
+ */
+void LivestatusQuery::SendRows(const Stream::Ptr& stream, const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects, const std::vector<String>& columns)
+{
+	typedef std::pair<String, Column> ColumnPair;
 
-		typedef std::pair<String, Column> ColumnPair;
+	std::vector<ColumnPair> column_objs;
+	column_objs.reserve(columns.size());
 
-		std::vector<ColumnPair> column_objs;
-		column_objs.reserve(columns.size());
+	BOOST_FOREACH(const String& columnName, columns)
+		column_objs.push_back(std::make_pair(columnName, table->GetColumn(columnName)));
 
-		BOOST_FOREACH(const String& columnName, columns)
-			column_objs.push_back(std::make_pair(columnName, table->GetColumn(columnName)));
+	bool streaming = (m_ResponseHeader != "fixed16");
 
-		rs->Reserve(1 + objects.size());
+	std::ostringstream result;
+	BeginResultSet(result);
 
-		BOOST_FOREACH(const LivestatusRowValue& object, objects) {
-			Array::Ptr row = new Array();
+	bool first = true;
 
-			row->Reserve(column_objs.size());
+	if (m_ColumnHeaders && !objects.empty()) {
+		Array::Ptr header = new Array();
 
-			BOOST_FOREACH(const ColumnPair& cv, column_objs) {
-				if (m_ColumnHeaders)
-					header->Add(cv.first);
+		BOOST_FOREACH(const ColumnPair& cv, column_objs)
+			header->Add(cv.first);
 
-				row->Add(cv.second.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
+		PrintResultRow(result, header, first);
+		first = false;
+	}
 
-			if (m_ColumnHeaders) {
-				rs->Add(header);
-				m_ColumnHeaders = false;
-			}
+	BOOST_FOREACH(const LivestatusRowValue& object, objects) {
+		Array::Ptr row = new Array();
+
+		row->Reserve(column_objs.size());
+
+		BOOST_FOREACH(const ColumnPair& cv, column_objs)
+			row->Add(cv.second.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
 
-			rs->Add(row);
+		PrintResultRow(result, row, first);
+		first = false;
+
+		if (streaming && result.tellp() >= LIVESTATUS_STREAM_CHUNK_SIZE) {
+			/* stop formatting rows once the client has gone away */
+			if (!SendResponse(stream, LivestatusErrorOK, result.str()))
+				return;
+
+			result.str("");
 		}
+	}
+
+	EndResultSet(result);
+
+	SendResponse(stream, LivestatusErrorOK, result.str());
+}
+
+/**
+ * Calculates the Stats: aggregates. Large result sets are split into
+ * partitions which are aggregated concurrently using copies of the
+ * aggregators; the partial results are merged afterwards.
+ */
+void LivestatusQuery::SendStats(const Stream::Ptr& stream, const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects)
+{
+	std::vector<Aggregator::Ptr> aggregators(m_Aggregators.begin(), m_Aggregators.end());
+
+	BOOST_FOREACH(const Aggregator::Ptr& aggregator, aggregators)
+		aggregator->Compile(table);
+
+	int count = Table::GetPartitionCount(objects.size());
+
+	if (count == 1) {
+		ApplyAggregators(table, objects, 0, objects.size(), aggregators);
 	} else {
-		std::vector<double> stats(m_Aggregators.size(), 0);
-		int index = 0;
+		std::vector<std::vector<Aggregator::Ptr> > partitions(count);
+		std::vector<boost::function<void (void)> > tasks;
 
-		/* add aggregated stats */
-		BOOST_FOREACH(const Aggregator::Ptr aggregator, m_Aggregators) {
-			BOOST_FOREACH(const LivestatusRowValue& object, objects) {
-				aggregator->Apply(table, object.Row);
-			}
+		for (int i = 0; i < count; i++) {
+			BOOST_FOREACH(const Aggregator::Ptr& aggregator, aggregators)
+				partitions[i].push_back(aggregator->Clone());
 
-			stats[index] = aggregator->GetResult();
-			index++;
+			size_t begin = objects.size() * i / count;
+			size_t end = objects.size() * (i + 1) / count;
+
+			tasks.push_back(boost::bind(&LivestatusQuery::ApplyAggregators, table, boost::cref(objects), begin, end, boost::cref(partitions[i])));
 		}
 
-		/* add column headers both for raw and aggregated data */
-		if (m_ColumnHeaders) {
-			Array::Ptr header = new Array();
+		Table::ExecutePartitions(tasks);
 
-			BOOST_FOREACH(const String& columnName, m_Columns) {
-				header->Add(columnName);
-			}
+		BOOST_FOREACH(const std::vector<Aggregator::Ptr>& partition, partitions) {
+			for (size_t i = 0; i < aggregators.size(); i++)
+				aggregators[i]->Merge(partition[i]);
+		}
+	}
 
-			for (size_t i = 1; i <= m_Aggregators.size(); i++) {
-				header->Add("stats_" + Convert::ToString(i));
-			}
+	Array::Ptr rs = new Array();
+
+	/* add column headers both for raw and aggregated data */
+	if (m_ColumnHeaders) {
+		Array::Ptr header = new Array();
 
-			rs->Add(header);
+		BOOST_FOREACH(const String& columnName, m_Columns) {
+			header->Add(columnName);
 		}
 
-		Array::Ptr row = new Array();
+		for (size_t i = 1; i <= m_Aggregators.size(); i++) {
+			header->Add("stats_" + Convert::ToString(i));
+		}
 
-		row->Reserve(m_Columns.size() + m_Aggregators.size());
+		rs->Add(header);
+	}
 
-		/*
-		 * add selected columns next to stats
-		 * may not be accurate for grouping!
-		 */
-		if (objects.size() > 0 && m_Columns.size() > 0) {
-			BOOST_FOREACH(const String& columnName, m_Columns) {
-				Column column = table->GetColumn(columnName);
+	Array::Ptr row = new Array();
 
-				LivestatusRowValue object = objects[0]; //first object wins
+	row->Reserve(m_Columns.size() + m_Aggregators.size());
 
-				row->Add(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
-		}
+	/*
+	 * add selected columns next to stats
+	 * may not be accurate for grouping!
+	 */
+	if (objects.size() > 0 && m_Columns.size() > 0) {
+		BOOST_FOREACH(const String& columnName, m_Columns) {
+			Column column = table->GetColumn(columnName);
 
-		for (size_t i = 0; i < m_Aggregators.size(); i++)
-			row->Add(stats[i]);
+			LivestatusRowValue object = objects[0]; //first object wins
 
-		rs->Add(row);
+			row->Add(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
+		}
 	}
 
+	BOOST_FOREACH(const Aggregator::Ptr& aggregator, aggregators)
+		row->Add(aggregator->GetResult());
+
+	rs->Add(row);
+
 	std::ostringstream result;
 	PrintResultSet(result, rs);
 
 	SendResponse(stream, LivestatusErrorOK, result.str());
 }
 
+void LivestatusQuery::ApplyAggregators(const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects,
+    size_t begin, size_t end, const std::vector<Aggregator::Ptr>& aggregators)
+{
+	BOOST_FOREACH(const Aggregator::Ptr& aggregator, aggregators) {
+		for (size_t i = begin; i < end; i++)
+			aggregator->Apply(table, objects[i].Row);
+	}
+}
+
 void LivestatusQuery::ExecuteCommandHelper(const Stream::Ptr& stream)
 {
 	{
@@ -666,21 +763,29 @@ void LivestatusQuery::ExecuteErrorHelper(const Stream::Ptr& stream)
 	SendResponse(stream, m_ErrorCode, m_ErrorMessage);
 }
 
-void LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const String& data)
+/**
+ * Sends a response to the client.
+ *
+ * @returns false if the response could not be written.
+ */
+bool LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const String& data)
 {
-	if (m_ResponseHeader == "fixed16")
-		PrintFixed16(stream, code, data);
+	if (m_ResponseHeader == "fixed16" && !PrintFixed16(stream, code, data))
+		return false;
 
 	if (m_ResponseHeader == "fixed16" || code == LivestatusErrorOK) {
 		try {
 			stream->Write(data.CStr(), data.GetLength());
 		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusQuery", "Cannot write to TCP socket.");
+			return false;
 		}
 	}
+
+	return true;
 }
 
-void LivestatusQuery::PrintFixed16(const Stream::Ptr& stream, int code, const String& data)
+bool LivestatusQuery::PrintFixed16(const Stream::Ptr& stream, int code, const String& data)
 {
 	ASSERT(code >= 100 && code <= 999);
 
@@ -693,7 +798,10 @@ void LivestatusQuery::PrintFixed16(const Stream::Ptr& stream, int code, const St
 		stream->Write(header.CStr(), header.GetLength());
 	} catch (const std::exception&) {
 		Log(LogCritical, "LivestatusQuery", "Cannot write to TCP socket.");
+		return false;
 	}
+
+	return true;
 }
 
 bool LivestatusQuery::Execute(const Stream::Ptr& stream)
@@ -33,6 +33,9 @@ using namespace icinga;
 namespace icinga
 {
 
+/* number of bytes which are buffered before a result set is written to the client */
+#define LIVESTATUS_STREAM_CHUNK_SIZE (64 * 1024)
+
 enum LivestatusError
 {
 	LivestatusErrorOK = 200,
@@ -98,17 +101,24 @@ private:
 	String m_CompatLogPath;
 
 	void PrintResultSet(std::ostream& fp, const Array::Ptr& rs) const;
+	void BeginResultSet(std::ostream& fp) const;
+	void PrintResultRow(std::ostream& fp, const Array::Ptr& row, bool first) const;
+	void EndResultSet(std::ostream& fp) const;
 	void PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const;
 	void PrintPythonArray(std::ostream& fp, const Array::Ptr& array) const;
 	static String QuoteStringPython(const String& str);
 
 	void ExecuteGetHelper(const Stream::Ptr& stream);
+	void SendRows(const Stream::Ptr& stream, const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects, const std::vector<String>& columns);
+	void SendStats(const Stream::Ptr& stream, const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects);
+	static void ApplyAggregators(const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects,
+	    size_t begin, size_t end, const std::vector<Aggregator::Ptr>& aggregators);
 	void ExecuteCommandHelper(const Stream::Ptr& stream);
 	void ExecuteScriptHelper(const Stream::Ptr& stream);
 	void ExecuteErrorHelper(const Stream::Ptr& stream);
 
-	void SendResponse(const Stream::Ptr& stream, int code, const String& data);
-	void PrintFixed16(const Stream::Ptr& stream, int code, const String& data);
+	bool SendResponse(const Stream::Ptr& stream, int code, const String& data);
+	bool PrintFixed16(const Stream::Ptr& stream, int code, const String& data);
 	
 	static Filter::Ptr ParseFilter(const String& params, unsigned long& from, unsigned long& until);
 };
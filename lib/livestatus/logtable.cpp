@@ -19,6 +19,7 @@
 
 #include "livestatus/logtable.hpp"
 #include "livestatus/livestatuslogutility.hpp"
+#include "livestatus/livestatuslogstore.hpp"
 #include "livestatus/hoststable.hpp"
 #include "livestatus/servicestable.hpp"
 #include "livestatus/contactstable.hpp"
@@ -97,14 +98,38 @@ void LogTable::FetchRows(const AddRowFunction& addRowFn)
 	Log(LogDebug, "LogTable")
 	    << "Pre-selecting log file from " << m_TimeFrom << " until " << m_TimeUntil;
 
-	/* create log file index */
-	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
+	LivestatusLogStore::Ptr store = LivestatusLogStore::GetInstance(m_CompatLogPath);
+	store->Update();
 
-	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	store->ForEachEntry(m_TimeFrom, m_TimeUntil, String(), true,
+	    boost::bind(&LogTable::UpdateLogEntries, this, _1, _2, _3, boost::cref(addRowFn)));
 }
 
-/* gets called in LivestatusLogUtility::CreateLogCache */
+/**
+ * Looks up log entries by host name using the log store's host index.
+ */
+bool LogTable::FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows)
+{
+	if (column != "host_name" || op != "=")
+		return false;
+
+	LivestatusLogStore::Ptr store = LivestatusLogStore::GetInstance(m_CompatLogPath);
+	store->Update();
+
+	store->ForEachEntry(m_TimeFrom, m_TimeUntil, operand, true,
+	    boost::bind(&LogTable::AddIndexedRow, _1, _3, boost::ref(rows)));
+
+	return true;
+}
+
+void LogTable::AddIndexedRow(const Dictionary::Ptr& log_entry_attrs, int lineno, std::vector<Value>& rows)
+{
+	log_entry_attrs->Set("lineno", lineno);
+
+	rows.push_back(log_entry_attrs);
+}
+
+/* gets called in LivestatusLogStore::ForEachEntry */
 void LogTable::UpdateLogEntries(const Dictionary::Ptr& log_entry_attrs, int line_count, int lineno, const AddRowFunction& addRowFn)
 {
 	/* additional attributes only for log table */
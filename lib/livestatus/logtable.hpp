@@ -48,6 +48,7 @@ public:
 
 protected:
 	virtual void FetchRows(const AddRowFunction& addRowFn);
+	virtual bool FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows);
 
 	static Object::Ptr HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
 	static Object::Ptr ServiceAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
@@ -71,11 +72,12 @@ protected:
 	static Value CommandNameAccessor(const Value& row);
 
 private:
-	std::map<time_t, String> m_LogFileIndex;
 	std::map<time_t, Dictionary::Ptr> m_RowsCache;
 	time_t m_TimeFrom;
 	time_t m_TimeUntil;
 	String m_CompatLogPath;
+
+	static void AddIndexedRow(const Dictionary::Ptr& log_entry_attrs, int lineno, std::vector<Value>& rows);
 };
 
 }
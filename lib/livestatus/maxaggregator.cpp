@@ -39,3 +39,18 @@ double MaxAggregator::GetResult(void) const
 {
 	return m_Max;
 }
+
+Aggregator::Ptr MaxAggregator::Clone(void) const
+{
+	Aggregator::Ptr aggregator = new MaxAggregator(m_MaxAttr);
+	aggregator->SetFilter(GetFilter());
+	return aggregator;
+}
+
+void MaxAggregator::Merge(const Aggregator::Ptr& other)
+{
+	MaxAggregator::Ptr aggregator = static_pointer_cast<MaxAggregator>(other);
+
+	if (aggregator->m_Max > m_Max)
+		m_Max = aggregator->m_Max;
+}
@@ -39,3 +39,18 @@ double MinAggregator::GetResult(void) const
 {
 	return m_Min;
 }
+
+Aggregator::Ptr MinAggregator::Clone(void) const
+{
+	Aggregator::Ptr aggregator = new MinAggregator(m_MinAttr);
+	aggregator->SetFilter(GetFilter());
+	return aggregator;
+}
+
+void MinAggregator::Merge(const Aggregator::Ptr& other)
+{
+	MinAggregator::Ptr aggregator = static_pointer_cast<MinAggregator>(other);
+
+	if (aggregator->m_Min < m_Min)
+		m_Min = aggregator->m_Min;
+}
@@ -29,3 +29,8 @@ bool NegateFilter::Apply(const Table::Ptr& table, const Value& row)
 {
 	return !m_Inner->Apply(table, row);
 }
+
+void NegateFilter::Compile(const Table::Ptr& table)
+{
+	m_Inner->Compile(table);
+}
@@ -38,6 +38,7 @@ public:
 	NegateFilter(const Filter::Ptr& inner);
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row);
+	virtual void Compile(const Table::Ptr& table);
 
 private:
 	Filter::Ptr m_Inner;
@@ -19,6 +19,7 @@
 
 #include "livestatus/orfilter.hpp"
 #include <boost/foreach.hpp>
+#include <set>
 
 using namespace icinga;
 
@@ -37,3 +38,32 @@ bool OrFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return false;
 }
+
+/**
+ * Combines the rows for all sub-filters. This only works if every
+ * sub-filter can be answered by an index.
+ */
+bool OrFilter::GetIndexedRows(const Table::Ptr& table, std::vector<Value>& rows)
+{
+	if (m_Filters.empty())
+		return false;
+
+	std::vector<Value> result;
+	std::set<Object::Ptr> seen;
+
+	BOOST_FOREACH(const Filter::Ptr& filter, m_Filters) {
+		std::vector<Value> frows;
+
+		if (!filter->GetIndexedRows(table, frows))
+			return false;
+
+		BOOST_FOREACH(const Value& row, frows) {
+			if (seen.insert(row).second)
+				result.push_back(row);
+		}
+	}
+
+	rows.swap(result);
+
+	return true;
+}
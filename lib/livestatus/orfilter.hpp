@@ -38,6 +38,7 @@ public:
 	OrFilter(void);
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row);
+	virtual bool GetIndexedRows(const Table::Ptr& table, std::vector<Value>& rows);
 };
 
 }
@@ -194,6 +194,54 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 	}
 }
 
+bool ServicesTable::FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows)
+{
+	String prefix;
+
+	if (column == "host_name" && op == "=") {
+		Host::Ptr host = Host::GetByName(operand);
+
+		if (host) {
+			BOOST_FOREACH(const Service::Ptr& service, host->GetServices()) {
+				rows.push_back(service);
+			}
+		}
+
+		return true;
+	} else if (column == "host_name" && op == "~" && GetRegexPrefix(operand, &prefix)) {
+		/* service names start with the host name */
+		BOOST_FOREACH(const DynamicObject::Ptr& service, DynamicType::GetByName("Service")->GetObjectsByPrefix(prefix)) {
+			rows.push_back(service);
+		}
+
+		return true;
+	} else if (column == "groups" && op == ">=") {
+		ServiceGroup::Ptr sg = ServiceGroup::GetByName(operand);
+
+		if (sg) {
+			BOOST_FOREACH(const Service::Ptr& service, sg->GetMembers()) {
+				rows.push_back(service);
+			}
+		}
+
+		return true;
+	} else if (column == "host_groups" && op == ">=") {
+		HostGroup::Ptr hg = HostGroup::GetByName(operand);
+
+		if (hg) {
+			BOOST_FOREACH(const Host::Ptr& host, hg->GetMembers()) {
+				BOOST_FOREACH(const Service::Ptr& service, host->GetServices()) {
+					rows.push_back(service);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
 Object::Ptr ServicesTable::HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor)
 {
 	Value service;
@@ -45,6 +45,7 @@ public:
 
 protected:
 	virtual void FetchRows(const AddRowFunction& addRowFn);
+	virtual bool FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows);
 
 	static Object::Ptr HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
 	static Object::Ptr ServiceGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
@@ -19,6 +19,7 @@
 
 #include "livestatus/statehisttable.hpp"
 #include "livestatus/livestatuslogutility.hpp"
+#include "livestatus/livestatuslogstore.hpp"
 #include "livestatus/hoststable.hpp"
 #include "livestatus/servicestable.hpp"
 #include "livestatus/contactstable.hpp"
@@ -260,11 +261,11 @@ void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
 	Log(LogDebug, "StateHistTable")
 	    << "Pre-selecting log file from " << m_TimeFrom << " until " << m_TimeUntil;
 
-	/* create log file index */
-	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
+	LivestatusLogStore::Ptr store = LivestatusLogStore::GetInstance(m_CompatLogPath);
+	store->Update();
 
-	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	store->ForEachEntry(m_TimeFrom, m_TimeUntil, String(), false,
+	    boost::bind(&StateHistTable::UpdateLogEntries, this, _1, _2, _3, boost::cref(addRowFn)));
 
 	Checkable::Ptr checkable;
 
@@ -277,6 +278,36 @@ void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
 	}
 }
 
+/**
+ * Calculates the state history for a single host and its services. Only the
+ * log lines for that host are read from the log store's host index.
+ */
+bool StateHistTable::FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows)
+{
+	if (column != "host_name" || op != "=")
+		return false;
+
+	LivestatusLogStore::Ptr store = LivestatusLogStore::GetInstance(m_CompatLogPath);
+	store->Update();
+
+	m_CheckablesCache.clear();
+
+	store->ForEachEntry(m_TimeFrom, m_TimeUntil, operand, false,
+	    boost::bind(&StateHistTable::UpdateLogEntries, this, _1, _2, _3, AddRowFunction()));
+
+	Checkable::Ptr checkable;
+	Array::Ptr states;
+
+	BOOST_FOREACH(boost::tie(checkable, states), m_CheckablesCache) {
+		ObjectLock olock(states);
+
+		BOOST_FOREACH(const Dictionary::Ptr& state_hist_bag, states)
+			rows.push_back(state_hist_bag);
+	}
+
+	return true;
+}
+
 Object::Ptr StateHistTable::HostAccessor(const Value& row, const Column::ObjectAccessor&)
 {
 	String host_name = static_cast<Dictionary::Ptr>(row)->Get("host_name");
@@ -49,6 +49,7 @@ public:
 
 protected:
 	virtual void FetchRows(const AddRowFunction& addRowFn);
+	virtual bool FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows);
 
 	static Object::Ptr HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
 	static Object::Ptr ServiceAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
@@ -81,7 +82,6 @@ protected:
 	static Value DurationPartUnmonitoredAccessor(const Value& row);
 
 private:
-	std::map<time_t, String> m_LogFileIndex;
 	std::map<Checkable::Ptr, Array::Ptr> m_CheckablesCache;
 	time_t m_TimeFrom;
 	time_t m_TimeUntil;
@@ -41,3 +41,19 @@ double StdAggregator::GetResult(void) const
 {
 	return sqrt((m_StdQSum - (1 / m_StdCount) * pow(m_StdSum, 2)) / (m_StdCount - 1));
 }
+
+Aggregator::Ptr StdAggregator::Clone(void) const
+{
+	Aggregator::Ptr aggregator = new StdAggregator(m_StdAttr);
+	aggregator->SetFilter(GetFilter());
+	return aggregator;
+}
+
+void StdAggregator::Merge(const Aggregator::Ptr& other)
+{
+	StdAggregator::Ptr aggregator = static_pointer_cast<StdAggregator>(other);
+
+	m_StdSum += aggregator->m_StdSum;
+	m_StdQSum += aggregator->m_StdQSum;
+	m_StdCount += aggregator->m_StdCount;
+}
@@ -38,3 +38,17 @@ double SumAggregator::GetResult(void) const
 {
 	return m_Sum;
 }
+
+Aggregator::Ptr SumAggregator::Clone(void) const
+{
+	Aggregator::Ptr aggregator = new SumAggregator(m_SumAttr);
+	aggregator->SetFilter(GetFilter());
+	return aggregator;
+}
+
+void SumAggregator::Merge(const Aggregator::Ptr& other)
+{
+	SumAggregator::Ptr aggregator = static_pointer_cast<SumAggregator>(other);
+
+	m_Sum += aggregator->m_Sum;
+}
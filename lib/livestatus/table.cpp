@@ -35,13 +35,31 @@
 #include "livestatus/filter.hpp"
 #include "base/array.hpp"
 #include "base/dictionary.hpp"
+#include "base/application.hpp"
+#include "base/workqueue.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 using namespace icinga;
 
+static boost::once_flag l_PartitionQueueOnceFlag = BOOST_ONCE_INIT;
+static WorkQueue *l_PartitionQueue;
+
+/**
+ * Tracks the partitions of a single query which are still being processed.
+ */
+struct PartitionState
+{
+	boost::mutex Mutex;
+	boost::condition_variable CV;
+	size_t Pending;
+	boost::exception_ptr Exception;
+};
+
 Table::Table(LivestatusGroupByType type)
     : m_GroupByType(type), m_GroupByObject(Empty)
 { }
@@ -128,11 +146,203 @@ std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int
 {
 	std::vector<LivestatusRowValue> rs;
 
-	FetchRows(boost::bind(&Table::FilteredAddRow, this, boost::ref(rs), filter, limit, _1, _2, _3));
+	if (filter)
+		filter->Compile(this);
+
+	/* look up the candidate rows in an index instead of scanning the whole table */
+	std::vector<Value> rows;
+
+	if (filter && GetGroupByType() == LivestatusGroupByNone && filter->GetIndexedRows(this, rows)) {
+		BOOST_FOREACH(const Value& row, rows) {
+			if (!FilteredAddRow(rs, filter, limit, row, LivestatusGroupByNone, Object::Ptr()))
+				break;
+		}
+
+		return rs;
+	}
+
+	if (!filter || limit != -1) {
+		FetchRows(boost::bind(&Table::FilteredAddRow, this, boost::ref(rs), filter, limit, _1, _2, _3));
+
+		return rs;
+	}
+
+	/* collect all rows first and evaluate the filter in partitions; each
+	 * partition moves its matches to the front of its range */
+	FetchRows(boost::bind(&Table::FilteredAddRow, this, boost::ref(rs), Filter::Ptr(), -1, _1, _2, _3));
+
+	int count = GetPartitionCount(rs.size());
+
+	std::vector<size_t> matches(count);
+	std::vector<boost::function<void (void)> > tasks;
+
+	for (int i = 0; i < count; i++) {
+		size_t begin = rs.size() * i / count;
+		size_t end = rs.size() * (i + 1) / count;
+
+		tasks.push_back(boost::bind(&Table::FilterPartition, this, filter, boost::ref(rs), begin, end, boost::ref(matches[i])));
+	}
+
+	ExecutePartitions(tasks);
+
+	size_t total = 0;
+
+	for (int i = 0; i < count; i++) {
+		size_t begin = rs.size() * i / count;
+
+		if (begin != total)
+			std::copy(rs.begin() + begin, rs.begin() + begin + matches[i], rs.begin() + total);
+
+		total += matches[i];
+	}
+
+	rs.resize(total);
 
 	return rs;
 }
 
+/**
+ * Returns the number of partitions a query over the specified number of rows
+ * should be split into.
+ */
+int Table::GetPartitionCount(size_t rows)
+{
+	size_t count = rows / LIVESTATUS_PARTITION_SIZE;
+	size_t concurrency = Application::GetConcurrency();
+
+	if (count > concurrency)
+		count = concurrency;
+
+	if (count < 1)
+		count = 1;
+
+	return count;
+}
+
+static void InitializePartitionQueue(void)
+{
+	l_PartitionQueue = new WorkQueue(25000, Application::GetConcurrency());
+}
+
+static void ExecutePartition(PartitionState *state, const boost::function<void (void)>& task)
+{
+	boost::exception_ptr exp;
+
+	try {
+		task();
+	} catch (...) {
+		exp = boost::current_exception();
+	}
+
+	boost::mutex::scoped_lock lock(state->Mutex);
+
+	if (exp && !state->Exception)
+		state->Exception = exp;
+
+	state->Pending--;
+
+	if (state->Pending == 0)
+		state->CV.notify_all();
+}
+
+/**
+ * Runs the partitions of a query on a work queue which is shared by all
+ * queries and waits until they have finished. The first partition is run
+ * by the calling thread.
+ */
+void Table::ExecutePartitions(const std::vector<boost::function<void (void)> >& tasks)
+{
+	if (tasks.empty())
+		return;
+
+	PartitionState state;
+	state.Pending = tasks.size();
+
+	if (tasks.size() > 1) {
+		boost::call_once(l_PartitionQueueOnceFlag, &InitializePartitionQueue);
+
+		for (std::vector<boost::function<void (void)> >::size_type i = 1; i < tasks.size(); i++)
+			l_PartitionQueue->Enqueue(boost::bind(&ExecutePartition, &state, boost::cref(tasks[i])));
+	}
+
+	ExecutePartition(&state, tasks[0]);
+
+	boost::mutex::scoped_lock lock(state.Mutex);
+
+	while (state.Pending > 0)
+		state.CV.wait(lock);
+
+	if (state.Exception)
+		boost::rethrow_exception(state.Exception);
+}
+
+/**
+ * Moves the rows in [begin, end) which match the filter to the front
+ * of the range.
+ */
+void Table::FilterPartition(const Filter::Ptr& filter, std::vector<LivestatusRowValue>& rows, size_t begin, size_t end, size_t& matches)
+{
+	size_t out = begin;
+
+	for (size_t i = begin; i < end; i++) {
+		if (!filter->Apply(this, rows[i].Row))
+			continue;
+
+		if (out != i)
+			rows[out] = rows[i];
+
+		out++;
+	}
+
+	matches = out - begin;
+}
+
+/**
+ * Returns the rows which may match the filter "column op operand".
+ *
+ * @returns false if there is no index for the column and operator.
+ */
+bool Table::GetIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows)
+{
+	String dname = column;
+	String prefix = GetPrefix() + "_";
+
+	if (dname.Find(prefix) == 0)
+		dname = dname.SubStr(prefix.GetLength());
+
+	return FetchIndexedRows(dname, op, operand, rows);
+}
+
+/**
+ * Tables override this for the columns they can look up without
+ * scanning all rows.
+ */
+bool Table::FetchIndexedRows(const String&, const String&, const String&, std::vector<Value>&)
+{
+	return false;
+}
+
+/**
+ * Checks whether a regular expression only matches strings which start
+ * with a fixed prefix, e.g. "^web".
+ */
+bool Table::GetRegexPrefix(const String& regex, String *prefix)
+{
+	if (regex.GetLength() < 2 || regex[0] != '^')
+		return false;
+
+	for (String::SizeType i = 1; i < regex.GetLength(); i++) {
+		char ch = regex[i];
+
+		if (!isalnum(static_cast<unsigned char>(ch)) && ch != '-' && ch != '_')
+			return false;
+	}
+
+	*prefix = regex.SubStr(1);
+
+	return true;
+}
+
 bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	if (limit != -1 && rs.size() == limit)
@@ -29,6 +29,9 @@
 namespace icinga
 {
 
+/* minimum number of rows per partition when evaluating queries concurrently */
+#define LIVESTATUS_PARTITION_SIZE 2048
+
 struct LivestatusRowValue {
 	Value Row;
 	LivestatusGroupByType GroupByType;
@@ -54,6 +57,10 @@ public:
 	virtual String GetPrefix(void) const = 0;
 
 	std::vector<LivestatusRowValue> FilterRows(const intrusive_ptr<Filter>& filter, int limit = -1);
+	bool GetIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows);
+
+	static int GetPartitionCount(size_t rows);
+	static void ExecutePartitions(const std::vector<boost::function<void (void)> >& tasks);
 
 	void AddColumn(const String& name, const Column& column);
 	Column GetColumn(const String& name) const;
@@ -65,6 +72,9 @@ protected:
 	Table(LivestatusGroupByType type = LivestatusGroupByNone);
 
 	virtual void FetchRows(const AddRowFunction& addRowFn) = 0;
+	virtual bool FetchIndexedRows(const String& column, const String& op, const String& operand, std::vector<Value>& rows);
+
+	static bool GetRegexPrefix(const String& regex, String *prefix);
 
 	static Value ZeroAccessor(const Value&);
 	static Value OneAccessor(const Value&);
@@ -79,6 +89,7 @@ private:
 	std::map<String, Column> m_Columns;
 
 	bool FilteredAddRow(std::vector<LivestatusRowValue>& rs, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
+	void FilterPartition(const intrusive_ptr<Filter>& filter, std::vector<LivestatusRowValue>& rows, size_t begin, size_t end, size_t& matches);
 };
 
 }
@@ -26,6 +26,7 @@
 #include "base/utility.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include "base/netstring.hpp"
 #include <boost/thread/once.hpp>
 
 using namespace icinga;
@@ -38,9 +39,13 @@ REGISTER_APIFUNCTION(RequestCertificate, pki, &RequestCertificateHandler);
 static boost::once_flag l_ApiClientOnceFlag = BOOST_ONCE_INIT;
 static Timer::Ptr l_ApiClientTimeoutTimer;
 
+#define MAX_SEND_QUEUE_LENGTH 25000
+#define MAX_REPLAY_QUEUE_LENGTH 1000
+
 ApiClient::ApiClient(const String& identity, bool authenticated, const TlsStream::Ptr& stream, ConnectionRole role)
 	: m_Identity(identity), m_Authenticated(authenticated), m_Stream(stream), m_Role(role), m_Seen(Utility::GetTime()),
-	  m_NextHeartbeat(0), m_HeartbeatTimeout(0)
+	  m_NextHeartbeat(0), m_HeartbeatTimeout(0), m_Replaying(false), m_SendQueueOverflow(false), m_FlushPending(false), m_Flushes(0),
+	  m_FlushedMessages(0), m_FlushedBytes(0)
 {
 	boost::call_once(l_ApiClientOnceFlag, &ApiClient::StaticInitialize);
 
@@ -90,16 +95,143 @@ ConnectionRole ApiClient::GetRole(void) const
 
 void ApiClient::SendMessage(const Dictionary::Ptr& message)
 {
-	m_WriteQueue.Enqueue(boost::bind(&ApiClient::SendMessageSync, ApiClient::Ptr(this), message));
+	SendMessage(JsonRpc::EncodeMessage(message));
+}
+
+/**
+ * Queues a message for the peer. Messages which are queued while the write
+ * queue is busy are sent together with a single write to the stream.
+ *
+ * While the client is replaying its queue isn't flushed. Rather than
+ * blocking the caller the client is disconnected once the queue is full;
+ * the peer catches up using the replay log when it reconnects.
+ *
+ * @param message The encoded message.
+ */
+void ApiClient::SendMessage(const JsonRpc::EncodedMessage& message)
+{
+	boost::mutex::scoped_lock lock(m_SendMutex);
+
+	while (!m_Replaying && m_SendQueue.size() >= MAX_SEND_QUEUE_LENGTH)
+		m_SendCV.wait(lock);
+
+	if (m_SendQueueOverflow)
+		return;
+
+	if (m_SendQueue.size() >= MAX_SEND_QUEUE_LENGTH) {
+		m_SendQueueOverflow = true;
+		m_SendQueue.clear();
+
+		Log(LogWarning, "ApiClient")
+		    << "Send queue overflow while replaying the log for identity '" << m_Identity << "'";
+
+		Utility::QueueAsyncCallback(boost::bind(&ApiClient::Disconnect, ApiClient::Ptr(this)));
+		return;
+	}
+
+	m_SendQueue.push_back(message);
+
+	if (!m_Replaying)
+		ScheduleFlush();
+}
+
+/**
+ * While the client is replaying only replayed messages are sent. Other
+ * messages are held back until the replay has finished.
+ *
+ * @param replaying Whether the client is replaying.
+ */
+void ApiClient::SetReplaying(bool replaying)
+{
+	boost::mutex::scoped_lock lock(m_SendMutex);
+
+	m_Replaying = replaying;
+	m_SendCV.notify_all();
+
+	if (!m_Replaying && !m_SendQueue.empty())
+		ScheduleFlush();
+}
+
+/**
+ * Queues a replayed message for the peer. Blocks while the client already
+ * has too many unsent replayed messages.
+ *
+ * @param message The encoded message.
+ */
+void ApiClient::ReplayMessage(const JsonRpc::EncodedMessage& message)
+{
+	boost::mutex::scoped_lock lock(m_SendMutex);
+
+	while (m_ReplayQueue.size() >= MAX_REPLAY_QUEUE_LENGTH)
+		m_SendCV.wait(lock);
+
+	m_ReplayQueue.push_back(message);
+
+	ScheduleFlush();
+}
+
+/* must hold m_SendMutex */
+void ApiClient::ScheduleFlush(void)
+{
+	if (m_FlushPending)
+		return;
+
+	m_FlushPending = true;
+	m_WriteQueue.Enqueue(boost::bind(&ApiClient::FlushMessages, ApiClient::Ptr(this)));
+}
+
+size_t ApiClient::GetSendQueueLength(void)
+{
+	boost::mutex::scoped_lock lock(m_SendMutex);
+	return m_SendQueue.size() + m_ReplayQueue.size();
+}
+
+void ApiClient::GetFlushStats(unsigned long& flushes, unsigned long& messages, unsigned long& bytes)
+{
+	boost::mutex::scoped_lock lock(m_SendMutex);
+	flushes = m_Flushes;
+	messages = m_FlushedMessages;
+	bytes = m_FlushedBytes;
 }
 
-void ApiClient::SendMessageSync(const Dictionary::Ptr& message)
+void ApiClient::FlushMessages(void)
 {
+	std::deque<JsonRpc::EncodedMessage> messages;
+
+	{
+		boost::mutex::scoped_lock lock(m_SendMutex);
+		messages.swap(m_ReplayQueue);
+
+		if (!m_Replaying) {
+			messages.insert(messages.end(), m_SendQueue.begin(), m_SendQueue.end());
+			m_SendQueue.clear();
+		}
+
+		m_FlushPending = false;
+		m_SendCV.notify_all();
+	}
+
+	if (messages.empty())
+		return;
+
 	try {
-		ObjectLock olock(m_Stream);
-		if (m_Stream->IsEof())
-			return;
-		JsonRpc::SendMessage(m_Stream, message);
+		String buffer;
+
+		BOOST_FOREACH(const JsonRpc::EncodedMessage& message, messages) {
+			NetString::WriteStringToBuffer(buffer, *message);
+		}
+
+		{
+			ObjectLock olock(m_Stream);
+			if (m_Stream->IsEof())
+				return;
+			m_Stream->Write(buffer.CStr(), buffer.GetLength());
+		}
+
+		boost::mutex::scoped_lock lock(m_SendMutex);
+		m_Flushes++;
+		m_FlushedMessages += messages.size();
+		m_FlushedBytes += buffer.GetLength();
 	} catch (const std::exception& ex) {
 		std::ostringstream info;
 		info << "Error while sending JSON-RPC message for identity '" << m_Identity << "'";
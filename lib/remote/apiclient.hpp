@@ -21,6 +21,7 @@
 #define APICLIENT_H
 
 #include "remote/endpoint.hpp"
+#include "remote/jsonrpc.hpp"
 #include "base/tlsstream.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
@@ -60,6 +61,13 @@ public:
 	void Disconnect(void);
 
 	void SendMessage(const Dictionary::Ptr& request);
+	void SendMessage(const JsonRpc::EncodedMessage& request);
+
+	void SetReplaying(bool replaying);
+	void ReplayMessage(const JsonRpc::EncodedMessage& message);
+
+	size_t GetSendQueueLength(void);
+	void GetFlushStats(unsigned long& flushes, unsigned long& messages, unsigned long& bytes);
 
 	static void HeartbeatTimerHandler(void);
 	static Value HeartbeatAPIHandler(const MessageOrigin& origin, const Dictionary::Ptr& params);
@@ -80,9 +88,21 @@ private:
 
 	WorkQueue m_WriteQueue;
 
+	boost::mutex m_SendMutex;
+	boost::condition_variable m_SendCV;
+	std::deque<JsonRpc::EncodedMessage> m_SendQueue;
+	std::deque<JsonRpc::EncodedMessage> m_ReplayQueue;
+	bool m_Replaying;
+	bool m_SendQueueOverflow;
+	bool m_FlushPending;
+	unsigned long m_Flushes;
+	unsigned long m_FlushedMessages;
+	unsigned long m_FlushedBytes;
+
 	bool ProcessMessage(void);
 	void DataAvailableHandler(void);
-	void SendMessageSync(const Dictionary::Ptr& request);
+	void ScheduleFlush(void);
+	void FlushMessages(void);
 
 	static void StaticInitialize(void);
 	static void TimeoutTimerHandler(void);
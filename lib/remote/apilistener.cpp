@@ -43,8 +43,10 @@ boost::signals2::signal<void(bool)> ApiListener::OnMasterChanged;
 
 REGISTER_STATSFUNCTION(ApiListenerStats, &ApiListener::StatsFunc);
 
+#define REPLAY_CACHE_SIZE (64 * 1024 * 1024)
+
 ApiListener::ApiListener(void)
-	: m_LogMessageCount(0)
+	: m_LogCache(REPLAY_CACHE_SIZE)
 { }
 
 void ApiListener::OnConfigLoaded(void)
@@ -365,6 +367,7 @@ void ApiListener::ApiTimerHandler(void)
 			Log(LogNotice, "ApiListener")
 			    << "Removing old log file: " << path;
 			(void)unlink(path.CStr());
+			(void)unlink(ClusterLogWriter::GetIndexPath(path).CStr());
 		}
 	}
 
@@ -457,29 +460,16 @@ void ApiListener::RelayMessage(const MessageOrigin& origin, const DynamicObject:
 	m_RelayQueue.Enqueue(boost::bind(&ApiListener::SyncRelayMessage, this, origin, secobj, message, log));
 }
 
-void ApiListener::PersistMessage(const Dictionary::Ptr& message, const DynamicObject::Ptr& secobj)
+void ApiListener::PersistMessage(const JsonRpc::EncodedMessage& message, double ts, const DynamicObject::Ptr& secobj)
 {
-	double ts = message->Get("ts");
-
 	ASSERT(ts != 0);
 
-	Dictionary::Ptr pmessage = new Dictionary();
-	pmessage->Set("timestamp", ts);
-
-	pmessage->Set("message", JsonEncode(message));
-	
-	Dictionary::Ptr secname = new Dictionary();
-	secname->Set("type", secobj->GetType()->GetName());
-	secname->Set("name", secobj->GetName());
-	pmessage->Set("secobj", secname);
-
 	boost::mutex::scoped_lock lock(m_LogLock);
 	if (m_LogFile) {
-		NetString::WriteStringToStream(m_LogFile, JsonEncode(pmessage));
-		m_LogMessageCount++;
+		m_LogFile->WriteMessage(ts, secobj->GetType()->GetName(), secobj->GetName(), message);
 		SetLogMessageTimestamp(ts);
 
-		if (m_LogMessageCount > 50000) {
+		if (m_LogFile->GetMessageCount() > 50000) {
 			CloseLogFile();
 			RotateLogFile();
 			OpenLogFile();
@@ -488,6 +478,11 @@ void ApiListener::PersistMessage(const Dictionary::Ptr& message, const DynamicOb
 }
 
 void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	SyncSendMessage(endpoint, JsonRpc::EncodeMessage(message));
+}
+
+void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const JsonRpc::EncodedMessage& message)
 {
 	ObjectLock olock(endpoint);
 
@@ -509,12 +504,15 @@ void ApiListener::SyncRelayMessage(const MessageOrigin& origin, const DynamicObj
 	Log(LogNotice, "ApiListener")
 	    << "Relaying '" << message->Get("method") << "' message";
 
-	if (log)
-		PersistMessage(message, secobj);
-
 	if (origin.FromZone)
 		message->Set("originZone", origin.FromZone->GetName());
 
+	/* Encode the message once for the replay log and all endpoints. */
+	JsonRpc::EncodedMessage encodedMessage = JsonRpc::EncodeMessage(message);
+
+	if (log)
+		PersistMessage(encodedMessage, ts, secobj);
+
 	bool is_master = IsMaster();
 	Endpoint::Ptr master = GetMaster();
 	Zone::Ptr my_zone = Zone::GetLocalZone();
@@ -566,7 +564,7 @@ void ApiListener::SyncRelayMessage(const MessageOrigin& origin, const DynamicObj
 
 		finishedZones.insert(target_zone);
 
-		SyncSendMessage(endpoint, message);
+		SyncSendMessage(endpoint, encodedMessage);
 	}
 
 	BOOST_FOREACH(const Endpoint::Ptr& endpoint, skippedEndpoints)
@@ -583,16 +581,15 @@ void ApiListener::OpenLogFile(void)
 {
 	String path = GetApiDir() + "log/current";
 
-	std::fstream *fp = new std::fstream(path.CStr(), std::fstream::out | std::ofstream::app);
+	ClusterLogWriter::Ptr logFile = new ClusterLogWriter(path, GetLogCompression());
 
-	if (!fp->good()) {
+	if (!logFile->IsGood()) {
 		Log(LogWarning, "ApiListener")
 		    << "Could not open spool file: " << path;
 		return;
 	}
 
-	m_LogFile = new StdioStream(fp, true);
-	m_LogMessageCount = 0;
+	m_LogFile = logFile;
 	SetLogMessageTimestamp(Utility::GetTime());
 }
 
@@ -615,8 +612,17 @@ void ApiListener::RotateLogFile(void)
 		ts = Utility::GetTime();
 
 	String oldpath = GetApiDir() + "log/current";
-	String newpath = GetApiDir() + "log/" + Convert::ToString(static_cast<int>(ts)+1);
+	int id = static_cast<int>(ts) + 1;
+	String newpath;
+
+	/* Don't overwrite segments which were rotated within the same second. */
+	do {
+		newpath = GetApiDir() + "log/" + Convert::ToString(id);
+		id++;
+	} while (Utility::PathExists(newpath));
+
 	(void) rename(oldpath.CStr(), newpath.CStr());
+	(void) rename(ClusterLogWriter::GetIndexPath(oldpath).CStr(), ClusterLogWriter::GetIndexPath(newpath).CStr());
 }
 
 void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
@@ -635,6 +641,26 @@ void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
 	files.push_back(ts);
 }
 
+/**
+ * Holds back a client's live messages while it is replaying and releases
+ * them on every exit path.
+ */
+struct ReplayingScope
+{
+	ApiClient::Ptr Client;
+
+	ReplayingScope(const ApiClient::Ptr& client)
+		: Client(client)
+	{
+		Client->SetReplaying(true);
+	}
+
+	~ReplayingScope(void)
+	{
+		Client->SetReplaying(false);
+	}
+};
+
 void ApiListener::ReplayLog(const ApiClient::Ptr& client)
 {
 	Endpoint::Ptr endpoint = client->GetEndpoint();
@@ -654,17 +680,25 @@ void ApiListener::ReplayLog(const ApiClient::Ptr& client)
 	if (!target_zone)
 		return;
 
-	for (;;) {
-		boost::mutex::scoped_lock lock(m_LogLock);
+	/* Hold back other messages until the client has caught up. */
+	ReplayingScope replaying(client);
 
-		CloseLogFile();
-		RotateLogFile();
+	for (;;) {
+		{
+			boost::mutex::scoped_lock lock(m_LogLock);
 
-		if (count == -1 || count > 50000) {
+			CloseLogFile();
+			RotateLogFile();
 			OpenLogFile();
-			lock.unlock();
-		} else {
-			last_sync = true;
+
+			/* Messages which are relayed from now on are queued for the
+			 * client until the remaining log files have been replayed. */
+			if (count != -1 && count <= 50000) {
+				last_sync = true;
+
+				ObjectLock olock2(endpoint);
+				endpoint->SetSyncing(false);
+			}
 		}
 
 		count = 0;
@@ -673,7 +707,10 @@ void ApiListener::ReplayLog(const ApiClient::Ptr& client)
 		Utility::Glob(GetApiDir() + "log/*", boost::bind(&ApiListener::LogGlobHandler, boost::ref(files), _1), GlobFile);
 		std::sort(files.begin(), files.end());
 
-		BOOST_FOREACH(int ts, files) {
+		bool first = true;
+
+		for (std::vector<int>::size_type i = 0; i < files.size(); i++) {
+			int ts = files[i];
 			String path = GetApiDir() + "log/" + Convert::ToString(ts);
 
 			if (ts < peer_ts)
@@ -682,56 +719,47 @@ void ApiListener::ReplayLog(const ApiClient::Ptr& client)
 			Log(LogNotice, "ApiListener")
 			    << "Replaying log: " << path;
 
-			std::fstream *fp = new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary);
-			StdioStream::Ptr logStream = new StdioStream(fp, true);
+			ClusterLogCache::Segment segment;
 
-			String message;
-			StreamReadContext src;
-			while (true) {
-				Dictionary::Ptr pmessage;
+			/* Only the first segment contains messages the peer already
+			 * has. Unless it's cached those are skipped using the
+			 * segment's index rather than decoding the whole segment. */
+			if (first) {
+				segment = m_LogCache.FindSegment(ts);
 
-				try {
-					StreamReadStatus srs = NetString::ReadStringFromStream(logStream, &message, src);
+				if (!segment)
+					segment = ClusterLogCache::ReadSegment(path, peer_ts);
 
-					if (srs == StatusEof)
-						break;
+				first = false;
+			} else
+				segment = m_LogCache.GetSegment(path, ts);
 
-					if (srs != StatusNewItem)
-						continue;
-
-					pmessage = JsonDecode(message);
-				} catch (const std::exception&) {
-					Log(LogWarning, "ApiListener")
-					    << "Unexpected end-of-file for cluster log: " << path;
-
-					/* Log files may be incomplete or corrupted. This is perfectly OK. */
-					break;
-				}
+			if (i + 1 < files.size())
+				m_LogCache.Prefetch(GetApiDir() + "log/" + Convert::ToString(files[i + 1]), files[i + 1]);
 
-				if (pmessage->Get("timestamp") <= peer_ts)
+			BOOST_FOREACH(const ClusterLogMessage& message, *segment) {
+				if (message.Timestamp <= peer_ts)
 					continue;
 
-				Dictionary::Ptr secname = pmessage->Get("secobj");
-				
-				if (secname) {
-					DynamicType::Ptr dtype = DynamicType::GetByName(secname->Get("type"));
-					
+				if (!message.SecobjType.IsEmpty()) {
+					DynamicType::Ptr dtype = DynamicType::GetByName(message.SecobjType);
+
 					if (!dtype)
 						continue;
-					
-					DynamicObject::Ptr secobj = dtype->GetObject(secname->Get("name"));
-					
+
+					DynamicObject::Ptr secobj = dtype->GetObject(message.SecobjName);
+
 					if (!secobj)
 						continue;
-					
+
 					if (!target_zone->CanAccessObject(secobj))
 						continue;
 				}
 
-				NetString::WriteStringToStream(client->GetStream(), pmessage->Get("message"));
+				client->ReplayMessage(message.Message);
 				count++;
 
-				peer_ts = pmessage->Get("timestamp");
+				peer_ts = message.Timestamp;
 
 				if (ts > logpos_ts + 10) {
 					logpos_ts = ts;
@@ -744,26 +772,22 @@ void ApiListener::ReplayLog(const ApiClient::Ptr& client)
 					lmessage->Set("method", "log::SetLogPosition");
 					lmessage->Set("params", lparams);
 
-					JsonRpc::SendMessage(client->GetStream(), lmessage);
+					client->ReplayMessage(JsonRpc::EncodeMessage(lmessage));
 				}
 			}
 
-			logStream->Close();
+			if (client->GetStream()->IsEof()) {
+				Log(LogNotice, "ApiListener")
+				    << "Stopped replaying log for disconnected endpoint '" << endpoint->GetName() << "'";
+				return;
+			}
 		}
 
 		Log(LogNotice, "ApiListener")
 		   << "Replayed " << count << " messages.";
 
-		if (last_sync) {
-			{
-				ObjectLock olock2(endpoint);
-				endpoint->SetSyncing(false);
-			}
-
-			OpenLogFile();
-
+		if (last_sync)
 			break;
-		}
 	}
 }
 
@@ -820,6 +844,37 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus(void)
 	perfdata->Set("num_conn_endpoints", Convert::ToDouble(connected_endpoints->GetLength()));
 	perfdata->Set("num_not_conn_endpoints", Convert::ToDouble(not_connected_endpoints->GetLength()));
 
+	/* write path stats */
+	std::set<ApiClient::Ptr> clients = GetAnonymousClients();
+
+	BOOST_FOREACH(const Endpoint::Ptr& endpoint, DynamicType::GetObjectsByType<Endpoint>()) {
+		std::set<ApiClient::Ptr> endpointClients = endpoint->GetClients();
+		clients.insert(endpointClients.begin(), endpointClients.end());
+	}
+
+	double send_queue_length = 0, flushes = 0, flushed_messages = 0, flushed_bytes = 0;
+
+	BOOST_FOREACH(const ApiClient::Ptr& client, clients) {
+		unsigned long clientFlushes, clientMessages, clientBytes;
+		client->GetFlushStats(clientFlushes, clientMessages, clientBytes);
+
+		send_queue_length += client->GetSendQueueLength();
+		flushes += clientFlushes;
+		flushed_messages += clientMessages;
+		flushed_bytes += clientBytes;
+	}
+
+	double messages_per_flush = flushes > 0 ? flushed_messages / flushes : 0;
+	double bytes_per_flush = flushes > 0 ? flushed_bytes / flushes : 0;
+
+	status->Set("send_queue_length", send_queue_length);
+	status->Set("messages_per_flush", messages_per_flush);
+	status->Set("bytes_per_flush", bytes_per_flush);
+
+	perfdata->Set("send_queue_length", send_queue_length);
+	perfdata->Set("messages_per_flush", messages_per_flush);
+	perfdata->Set("bytes_per_flush", bytes_per_flush);
+
 	return std::make_pair(status, perfdata);
 }
 
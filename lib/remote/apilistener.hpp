@@ -24,6 +24,7 @@
 #include "remote/apiclient.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
+#include "remote/clusterlog.hpp"
 #include "base/dynamicobject.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
@@ -59,6 +60,7 @@ public:
 	static String GetApiDir(void);
 
 	void SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message);
+	void SyncSendMessage(const Endpoint::Ptr& endpoint, const JsonRpc::EncodedMessage& message);
 	void RelayMessage(const MessageOrigin& origin, const DynamicObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
@@ -92,11 +94,11 @@ private:
 	WorkQueue m_RelayQueue;
 
 	boost::mutex m_LogLock;
-	Stream::Ptr m_LogFile;
-	size_t m_LogMessageCount;
+	ClusterLogWriter::Ptr m_LogFile;
+	ClusterLogCache m_LogCache;
 
 	void SyncRelayMessage(const MessageOrigin& origin, const DynamicObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
-	void PersistMessage(const Dictionary::Ptr& message, const DynamicObject::Ptr& secobj);
+	void PersistMessage(const JsonRpc::EncodedMessage& message, double ts, const DynamicObject::Ptr& secobj);
 
 	void OpenLogFile(void);
 	void RotateLogFile(void);
@@ -0,0 +1,457 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/clusterlog.hpp"
+#include "base/netstring.hpp"
+#include "base/stdiostream.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/bind.hpp>
+
+#ifdef HAVE_ZLIB
+#	include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+using namespace icinga;
+
+static const char l_ClusterLogMagic[8] = { 'I', '2', 'C', 'L', 'O', 'G', '1', '\n' };
+
+#define CLUSTERLOG_INDEX_INTERVAL 256
+#define CLUSTERLOG_MAX_FRAME_SIZE (64 * 1024 * 1024)
+
+enum ClusterLogFrameFlags
+{
+	ClusterLogFrameCompressed = 1
+};
+
+ClusterLogWriter::ClusterLogWriter(const String& path, bool compress)
+	: m_Compress(compress), m_MessageCount(0), m_MaxTimestamp(0)
+{
+#ifndef HAVE_ZLIB
+	if (m_Compress) {
+		Log(LogWarning, "ClusterLogWriter", "Compression for the cluster log is not available: Icinga 2 was built without zlib.");
+		m_Compress = false;
+	}
+#endif /* HAVE_ZLIB */
+
+	m_Segment.open(path.CStr(), std::ofstream::out | std::ofstream::app | std::ofstream::binary);
+
+	if (!m_Segment.good())
+		return;
+
+	m_Segment.seekp(0, std::ofstream::end);
+
+	/* Existing segments are appended to without an index, the index
+	 * entries' maximum timestamps would be wrong otherwise. */
+	if (m_Segment.tellp() > 0)
+		return;
+
+	m_Segment.write(l_ClusterLogMagic, sizeof(l_ClusterLogMagic));
+
+	m_Index.open(GetIndexPath(path).CStr(), std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+}
+
+ClusterLogWriter::~ClusterLogWriter(void)
+{
+	Close();
+}
+
+String ClusterLogWriter::GetIndexPath(const String& path)
+{
+	return path + ".idx";
+}
+
+bool ClusterLogWriter::IsGood(void) const
+{
+	return m_Segment.good();
+}
+
+size_t ClusterLogWriter::GetMessageCount(void) const
+{
+	return m_MessageCount;
+}
+
+void ClusterLogWriter::WriteMessage(double ts, const String& secobjType, const String& secobjName, const JsonRpc::EncodedMessage& message)
+{
+	if (m_Index.is_open() && m_MessageCount % CLUSTERLOG_INDEX_INTERVAL == 0) {
+		ClusterLogIndexEntry entry;
+		entry.MaxTimestamp = m_MaxTimestamp;
+		entry.Offset = m_Segment.tellp();
+		m_Index.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+	}
+
+	const char *payload = message->CStr();
+	uint32_t payloadLength = message->GetLength();
+	uint32_t flags = 0;
+
+#ifdef HAVE_ZLIB
+	std::vector<char> compressed;
+
+	if (m_Compress) {
+		uLongf compressedLength = compressBound(payloadLength);
+		compressed.resize(sizeof(uint32_t) + compressedLength);
+
+		if (compress2(reinterpret_cast<Bytef *>(&compressed[sizeof(uint32_t)]), &compressedLength,
+		    reinterpret_cast<const Bytef *>(payload), payloadLength, Z_BEST_SPEED) == Z_OK) {
+			/* The uncompressed length precedes the compressed data. */
+			memcpy(&compressed[0], &payloadLength, sizeof(payloadLength));
+
+			payload = &compressed[0];
+			payloadLength = sizeof(uint32_t) + compressedLength;
+			flags |= ClusterLogFrameCompressed;
+		}
+	}
+#endif /* HAVE_ZLIB */
+
+	uint32_t typeLength = secobjType.GetLength();
+	uint32_t nameLength = secobjName.GetLength();
+	uint32_t frameLength = sizeof(ts) + sizeof(flags) + sizeof(typeLength) + typeLength +
+	    sizeof(nameLength) + nameLength + payloadLength;
+
+	m_Segment.write(reinterpret_cast<const char *>(&frameLength), sizeof(frameLength));
+	m_Segment.write(reinterpret_cast<const char *>(&ts), sizeof(ts));
+	m_Segment.write(reinterpret_cast<const char *>(&flags), sizeof(flags));
+	m_Segment.write(reinterpret_cast<const char *>(&typeLength), sizeof(typeLength));
+	m_Segment.write(secobjType.CStr(), typeLength);
+	m_Segment.write(reinterpret_cast<const char *>(&nameLength), sizeof(nameLength));
+	m_Segment.write(secobjName.CStr(), nameLength);
+	m_Segment.write(payload, payloadLength);
+
+	m_MessageCount++;
+
+	if (ts > m_MaxTimestamp)
+		m_MaxTimestamp = ts;
+}
+
+void ClusterLogWriter::Close(void)
+{
+	if (m_Index.is_open())
+		m_Index.close();
+
+	if (m_Segment.is_open())
+		m_Segment.close();
+}
+
+ClusterLogReader::ClusterLogReader(const String& path)
+	: m_Path(path), m_Legacy(false)
+{
+	m_Segment.open(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	char magic[sizeof(l_ClusterLogMagic)];
+
+	if (!m_Segment.read(magic, sizeof(magic)) || memcmp(magic, l_ClusterLogMagic, sizeof(magic)) != 0) {
+		m_Segment.close();
+
+		m_Legacy = true;
+
+		std::fstream *fp = new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary);
+		m_LegacyStream = new StdioStream(fp, true);
+	}
+}
+
+/**
+ * Skips to the last indexed position before which there are no messages
+ * newer than the specified timestamp.
+ *
+ * @param ts The timestamp.
+ */
+void ClusterLogReader::Seek(double ts)
+{
+	if (m_Legacy)
+		return;
+
+	m_Segment.seekg(0, std::ifstream::end);
+	unsigned long long size = m_Segment.tellg();
+
+	unsigned long long offset = sizeof(l_ClusterLogMagic);
+
+	std::ifstream index(ClusterLogWriter::GetIndexPath(m_Path).CStr(), std::ifstream::in | std::ifstream::binary);
+	ClusterLogIndexEntry entry;
+
+	while (index.read(reinterpret_cast<char *>(&entry), sizeof(entry))) {
+		/* Index entries may point past the end of a segment which wasn't closed properly. */
+		if (entry.MaxTimestamp > ts || entry.Offset > size)
+			break;
+
+		offset = entry.Offset;
+	}
+
+	m_Segment.clear();
+	m_Segment.seekg(offset);
+}
+
+static bool ReadFrameField(const std::vector<char>& frame, size_t& pos, void *buffer, size_t length)
+{
+	if (frame.size() - pos < length)
+		return false;
+
+	memcpy(buffer, &frame[pos], length);
+	pos += length;
+
+	return true;
+}
+
+static bool ReadFrameString(const std::vector<char>& frame, size_t& pos, String *str)
+{
+	uint32_t length;
+
+	if (!ReadFrameField(frame, pos, &length, sizeof(length)) || frame.size() - pos < length)
+		return false;
+
+	*str = String(frame.begin() + pos, frame.begin() + pos + length);
+	pos += length;
+
+	return true;
+}
+
+/**
+ * Reads the next message from the segment.
+ *
+ * @param message Receives the message.
+ * @returns false if there are no more messages, true otherwise.
+ */
+bool ClusterLogReader::ReadMessage(ClusterLogMessage *message)
+{
+	if (m_Legacy)
+		return ReadLegacyMessage(message);
+
+	uint32_t frameLength;
+
+	if (!m_Segment.read(reinterpret_cast<char *>(&frameLength), sizeof(frameLength)))
+		return false;
+
+	std::vector<char> frame;
+
+	if (frameLength <= CLUSTERLOG_MAX_FRAME_SIZE) {
+		frame.resize(frameLength);
+		m_Segment.read(&frame[0], frameLength);
+	}
+
+	size_t pos = 0;
+	uint32_t flags;
+
+	/* Segments may be incomplete or corrupted. This is perfectly OK. */
+	if (frame.empty() || !m_Segment ||
+	    !ReadFrameField(frame, pos, &message->Timestamp, sizeof(message->Timestamp)) ||
+	    !ReadFrameField(frame, pos, &flags, sizeof(flags)) ||
+	    !ReadFrameString(frame, pos, &message->SecobjType) ||
+	    !ReadFrameString(frame, pos, &message->SecobjName)) {
+		Log(LogWarning, "ClusterLogReader")
+		    << "Unexpected end-of-file for cluster log: " << m_Path;
+		return false;
+	}
+
+	if (flags & ClusterLogFrameCompressed) {
+#ifdef HAVE_ZLIB
+		uint32_t length;
+
+		if (ReadFrameField(frame, pos, &length, sizeof(length)) && length <= CLUSTERLOG_MAX_FRAME_SIZE) {
+			std::vector<char> payload(length);
+			uLongf payloadLength = length;
+
+			if (length == 0 || uncompress(reinterpret_cast<Bytef *>(&payload[0]), &payloadLength,
+			    reinterpret_cast<const Bytef *>(&frame[pos]), frame.size() - pos) == Z_OK) {
+				message->Message = boost::make_shared<String>(payload.begin(), payload.begin() + payloadLength);
+				return true;
+			}
+		}
+#endif /* HAVE_ZLIB */
+
+		Log(LogWarning, "ClusterLogReader")
+		    << "Could not decompress message in cluster log: " << m_Path;
+		return false;
+	}
+
+	message->Message = boost::make_shared<String>(frame.begin() + pos, frame.end());
+	return true;
+}
+
+bool ClusterLogReader::ReadLegacyMessage(ClusterLogMessage *message)
+{
+	for (;;) {
+		String str;
+		Dictionary::Ptr pmessage;
+
+		try {
+			StreamReadStatus srs = NetString::ReadStringFromStream(m_LegacyStream, &str, m_Context);
+
+			if (srs == StatusEof)
+				return false;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			pmessage = JsonDecode(str);
+		} catch (const std::exception&) {
+			Log(LogWarning, "ClusterLogReader")
+			    << "Unexpected end-of-file for cluster log: " << m_Path;
+
+			/* Log files may be incomplete or corrupted. This is perfectly OK. */
+			return false;
+		}
+
+		message->Timestamp = pmessage->Get("timestamp");
+
+		Dictionary::Ptr secname = pmessage->Get("secobj");
+
+		if (secname) {
+			message->SecobjType = secname->Get("type");
+			message->SecobjName = secname->Get("name");
+		} else {
+			message->SecobjType = String();
+			message->SecobjName = String();
+		}
+
+		message->Message = boost::make_shared<String>(pmessage->Get("message"));
+
+		return true;
+	}
+}
+
+ClusterLogCache::ClusterLogCache(size_t maxSize)
+	: m_Size(0), m_MaxSize(maxSize)
+{ }
+
+/**
+ * Returns all messages from a rotated segment, reading it if it's not
+ * already cached.
+ *
+ * @param path The segment's path.
+ * @param id The segment's ID, i.e. the timestamp it's named after.
+ * @returns The messages.
+ */
+ClusterLogCache::Segment ClusterLogCache::GetSegment(const String& path, int id)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		std::map<int, CacheEntry>::const_iterator it = m_Segments.find(id);
+
+		if (it != m_Segments.end())
+			return it->second.Messages;
+	}
+
+	/* Segments are read without holding the lock. Concurrent readers of
+	 * the same segment may read it more than once which is harmless. */
+	size_t size;
+	Segment messages = ReadSegment(path, 0, &size);
+
+	AddSegment(id, messages, size);
+
+	return messages;
+}
+
+/**
+ * Returns a segment if it's already cached.
+ *
+ * @param id The segment's ID.
+ * @returns The messages, or an empty pointer if the segment isn't cached.
+ */
+ClusterLogCache::Segment ClusterLogCache::FindSegment(int id)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	std::map<int, CacheEntry>::const_iterator it = m_Segments.find(id);
+
+	if (it == m_Segments.end())
+		return Segment();
+
+	return it->second.Messages;
+}
+
+/**
+ * Reads the messages which are newer than the specified timestamp from a
+ * segment. The segment's index is used to skip older messages.
+ *
+ * @param path The segment's path.
+ * @param since The timestamp.
+ * @param size Receives the total size of the messages.
+ * @returns The messages.
+ */
+ClusterLogCache::Segment ClusterLogCache::ReadSegment(const String& path, double since, size_t *size)
+{
+	boost::shared_ptr<std::vector<ClusterLogMessage> > messages = boost::make_shared<std::vector<ClusterLogMessage> >();
+	size_t total = 0;
+
+	ClusterLogReader::Ptr reader = new ClusterLogReader(path);
+
+	if (since > 0)
+		reader->Seek(since);
+
+	ClusterLogMessage message;
+	while (reader->ReadMessage(&message)) {
+		if (since > 0 && message.Timestamp <= since)
+			continue;
+
+		messages->push_back(message);
+		total += message.Message->GetLength();
+	}
+
+	if (size)
+		*size = total;
+
+	return messages;
+}
+
+/**
+ * Reads a segment in the background.
+ *
+ * @param path The segment's path.
+ * @param id The segment's ID.
+ */
+void ClusterLogCache::Prefetch(const String& path, int id)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Segments.find(id) != m_Segments.end())
+			return;
+	}
+
+	Utility::QueueAsyncCallback(boost::bind(&ClusterLogCache::GetSegment, this, path, id));
+}
+
+void ClusterLogCache::AddSegment(int id, const Segment& segment, size_t size)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_Segments.find(id) != m_Segments.end())
+		return;
+
+	CacheEntry entry;
+	entry.Messages = segment;
+	entry.Size = size;
+
+	m_Segments[id] = entry;
+	m_Size += size;
+
+	std::map<int, CacheEntry>::iterator it = m_Segments.begin();
+
+	while (m_Size > m_MaxSize && it != m_Segments.end()) {
+		if (it->first == id) {
+			it++;
+			continue;
+		}
+
+		m_Size -= it->second.Size;
+		m_Segments.erase(it++);
+	}
+}
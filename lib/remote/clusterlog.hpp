@@ -0,0 +1,157 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CLUSTERLOG_H
+#define CLUSTERLOG_H
+
+#include "remote/i2-remote.hpp"
+#include "remote/jsonrpc.hpp"
+#include "base/object.hpp"
+#include <boost/thread/mutex.hpp>
+#include <fstream>
+#include <vector>
+#include <map>
+
+namespace icinga
+{
+
+/**
+ * A message from the cluster replay log.
+ *
+ * @ingroup remote
+ */
+struct I2_REMOTE_API ClusterLogMessage
+{
+	double Timestamp;
+	String SecobjType;
+	String SecobjName;
+	JsonRpc::EncodedMessage Message;
+};
+
+/**
+ * An entry in a log segment's sparse index. MaxTimestamp is the highest
+ * timestamp of all messages which were written before Offset.
+ *
+ * @ingroup remote
+ */
+struct ClusterLogIndexEntry
+{
+	double MaxTimestamp;
+	unsigned long long Offset;
+};
+
+/**
+ * Appends messages to a segment of the cluster replay log.
+ *
+ * Segments consist of a header followed by length-prefixed binary frames.
+ * Every 256 frames an entry is appended to the segment's index file (the
+ * segment's path with an ".idx" suffix). Integers and timestamps are
+ * stored in native byte order.
+ *
+ * @ingroup remote
+ */
+class I2_REMOTE_API ClusterLogWriter : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(ClusterLogWriter);
+
+	ClusterLogWriter(const String& path, bool compress = false);
+	~ClusterLogWriter(void);
+
+	bool IsGood(void) const;
+
+	void WriteMessage(double ts, const String& secobjType, const String& secobjName, const JsonRpc::EncodedMessage& message);
+	size_t GetMessageCount(void) const;
+
+	void Close(void);
+
+	static String GetIndexPath(const String& path);
+
+private:
+	std::ofstream m_Segment;
+	std::ofstream m_Index;
+	bool m_Compress;
+	size_t m_MessageCount;
+	double m_MaxTimestamp;
+};
+
+/**
+ * Reads messages from a segment of the cluster replay log. Segments in the
+ * legacy netstring/JSON format are supported as well.
+ *
+ * @ingroup remote
+ */
+class I2_REMOTE_API ClusterLogReader : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(ClusterLogReader);
+
+	ClusterLogReader(const String& path);
+
+	void Seek(double ts);
+	bool ReadMessage(ClusterLogMessage *message);
+
+private:
+	String m_Path;
+	std::ifstream m_Segment;
+	bool m_Legacy;
+	StreamReadContext m_Context;
+	Stream::Ptr m_LegacyStream;
+
+	bool ReadLegacyMessage(ClusterLogMessage *message);
+};
+
+/**
+ * Caches rotated segments of the cluster replay log so that concurrent
+ * replays can share them. The oldest segments are evicted first once the
+ * cache exceeds its maximum size.
+ *
+ * @ingroup remote
+ */
+class I2_REMOTE_API ClusterLogCache
+{
+public:
+	typedef boost::shared_ptr<const std::vector<ClusterLogMessage> > Segment;
+
+	ClusterLogCache(size_t maxSize);
+
+	Segment GetSegment(const String& path, int id);
+	Segment FindSegment(int id);
+	void Prefetch(const String& path, int id);
+
+	static Segment ReadSegment(const String& path, double since = 0, size_t *size = NULL);
+
+private:
+	struct CacheEntry
+	{
+		Segment Messages;
+		size_t Size;
+	};
+
+	boost::mutex m_Mutex;
+	std::map<int, CacheEntry> m_Segments;
+	size_t m_Size;
+	size_t m_MaxSize;
+
+	void AddSegment(int id, const Segment& segment, size_t size);
+};
+
+}
+
+#endif /* CLUSTERLOG_H */
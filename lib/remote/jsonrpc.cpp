@@ -20,6 +20,7 @@
 #include "remote/jsonrpc.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
+#include <boost/smart_ptr/make_shared.hpp>
 //#include <iostream>
 
 using namespace icinga;
@@ -36,6 +37,17 @@ void JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& mess
 	NetString::WriteStringToStream(stream, json);
 }
 
+/**
+ * Encodes a message so that it can be sent to multiple peers.
+ *
+ * @param message The message.
+ * @returns The encoded message.
+ */
+JsonRpc::EncodedMessage JsonRpc::EncodeMessage(const Dictionary::Ptr& message)
+{
+	return boost::make_shared<String>(JsonEncode(message));
+}
+
 StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, Dictionary::Ptr *message, StreamReadContext& src)
 {
 	String jsonString;
@@ -23,6 +23,7 @@
 #include "base/stream.hpp"
 #include "base/dictionary.hpp"
 #include "remote/i2-remote.hpp"
+#include <boost/smart_ptr/shared_ptr.hpp>
 
 namespace icinga
 {
@@ -35,7 +36,14 @@ namespace icinga
 class I2_REMOTE_API JsonRpc
 {
 public:
+	/**
+	 * A JSON-encoded message. Encoded messages are immutable and can be
+	 * shared between multiple connections.
+	 */
+	typedef boost::shared_ptr<const String> EncodedMessage;
+
 	static void SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message);
+	static EncodedMessage EncodeMessage(const Dictionary::Ptr& message);
 	static StreamReadStatus ReadMessage(const Stream::Ptr& stream, Dictionary::Ptr *message, StreamReadContext& src);
 
 private:
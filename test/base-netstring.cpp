@@ -39,4 +39,25 @@ BOOST_AUTO_TEST_CASE(netstring)
 	fifo->Close();
 }
 
+BOOST_AUTO_TEST_CASE(netstring_buffer)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	String buffer;
+	NetString::WriteStringToBuffer(buffer, "hello");
+	NetString::WriteStringToBuffer(buffer, "world");
+	BOOST_CHECK(buffer == "5:hello,5:world,");
+
+	fifo->Write(buffer.CStr(), buffer.GetLength());
+
+	String s;
+	StreamReadContext src;
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNewItem);
+	BOOST_CHECK(s == "hello");
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNewItem);
+	BOOST_CHECK(s == "world");
+
+	fifo->Close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/threadpool.hpp"
+#include "base/utility.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_threadpool)
+
+static boost::mutex l_CounterMutex;
+
+static void Increment(int *counter)
+{
+	boost::mutex::scoped_lock lock(l_CounterMutex);
+	(*counter)++;
+}
+
+static void PostNested(ThreadPool *tp, int *counter)
+{
+	for (int i = 0; i < 10; i++)
+		tp->Post(boost::bind(&Increment, counter));
+}
+
+static int GetCounter(int *counter)
+{
+	boost::mutex::scoped_lock lock(l_CounterMutex);
+	return *counter;
+}
+
+BOOST_AUTO_TEST_CASE(post)
+{
+	ThreadPool tp;
+	int counter = 0;
+
+	for (int i = 0; i < 1000; i++)
+		BOOST_CHECK(tp.Post(boost::bind(&Increment, &counter)));
+
+	tp.Stop();
+
+	BOOST_CHECK(counter == 1000);
+}
+
+BOOST_AUTO_TEST_CASE(workstealing)
+{
+	ThreadPool tp;
+	tp.SetWorkStealing(true);
+	BOOST_CHECK(tp.GetWorkStealing());
+
+	int counter = 0;
+
+	for (int i = 0; i < 1000; i++)
+		BOOST_CHECK(tp.Post(boost::bind(&PostNested, &tp, &counter)));
+
+	for (int i = 0; i < 100 && GetCounter(&counter) < 10000; i++)
+		Utility::Sleep(0.1);
+
+	tp.Stop();
+
+	BOOST_CHECK(counter == 10000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
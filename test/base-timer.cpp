@@ -22,6 +22,9 @@
 #include "base/application.hpp"
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <vector>
 
 using namespace icinga;
 
@@ -76,4 +79,168 @@ BOOST_AUTO_TEST_CASE(scope)
 	BOOST_CHECK(counter >= 4 && counter <= 6);
 }
 
+BOOST_AUTO_TEST_CASE(invoke_wheel)
+{
+	Timer::SetBackend(TimingWheelTimerBackend);
+
+	int counter;
+	Timer::Ptr timer = new Timer();
+	timer->OnTimerExpired.connect(boost::bind(&Callback, &counter));
+	timer->SetInterval(1);
+
+	counter = 0;
+	timer->Start();
+	Utility::Sleep(5.5);
+	timer->Stop();
+
+	Timer::SetBackend(OrderedTimerBackend);
+
+	BOOST_CHECK(counter >= 4 && counter <= 6);
+}
+
+static double BenchmarkBackend(TimerBackend backend, std::vector<Timer::Ptr>& timers)
+{
+	Timer::SetBackend(backend);
+
+	double start = Utility::GetTime();
+
+	BOOST_FOREACH(const Timer::Ptr& timer, timers) {
+		timer->Start();
+	}
+
+	std::vector<double> next(timers.size());
+
+	for (int i = 0; i < 3; i++) {
+		double now = Utility::GetTime();
+
+		for (std::vector<Timer::Ptr>::size_type k = 0; k < timers.size(); k++) {
+			next[k] = now + 300 + rand() % 3600;
+			timers[k]->Reschedule(next[k]);
+		}
+	}
+
+	int misscheduled = 0;
+
+	for (std::vector<Timer::Ptr>::size_type k = 0; k < timers.size(); k++) {
+		if (timers[k]->GetNext() != next[k])
+			misscheduled++;
+	}
+
+	BOOST_CHECK(misscheduled == 0);
+
+	BOOST_FOREACH(const Timer::Ptr& timer, timers) {
+		timer->Stop();
+	}
+
+	return Utility::GetTime() - start;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+	std::vector<Timer::Ptr> timers;
+
+	for (int i = 0; i < 100000; i++) {
+		Timer::Ptr timer = new Timer();
+		timer->SetInterval(300 + i % 3600);
+		timers.push_back(timer);
+	}
+
+	double ordered = BenchmarkBackend(OrderedTimerBackend, timers);
+	double wheel = BenchmarkBackend(TimingWheelTimerBackend, timers);
+
+	Timer::SetBackend(OrderedTimerBackend);
+
+	BOOST_TEST_MESSAGE("100000 periodic timers: ordered set " << ordered << "s, timing wheel " << wheel << "s");
+
+	BOOST_CHECK(Timer::GetBackend() == OrderedTimerBackend);
+}
+
+static void RecordExpiry(boost::mutex *mutex, std::vector<double> *fired, int index)
+{
+	boost::mutex::scoped_lock lock(*mutex);
+
+	if ((*fired)[index] == 0)
+		(*fired)[index] = Utility::GetTime();
+}
+
+BOOST_AUTO_TEST_CASE(order_wheel)
+{
+	Timer::SetBackend(TimingWheelTimerBackend);
+
+	boost::mutex mutex;
+	std::vector<double> fired(4, 0);
+	std::vector<Timer::Ptr> timers;
+
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < 4; i++) {
+		Timer::Ptr timer = new Timer();
+		timer->OnTimerExpired.connect(boost::bind(&RecordExpiry, &mutex, &fired, i));
+		timer->SetInterval(0.5 + i * 0.5);
+		timer->Start();
+		timers.push_back(timer);
+	}
+
+	Utility::Sleep(2.5);
+
+	BOOST_FOREACH(const Timer::Ptr& timer, timers) {
+		timer->Stop(true);
+	}
+
+	Timer::SetBackend(OrderedTimerBackend);
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	for (int i = 0; i < 4; i++) {
+		double due = start + 0.5 + i * 0.5;
+
+		BOOST_CHECK(fired[i] >= due - 0.05 && fired[i] <= due + 0.25);
+
+		if (i > 0)
+			BOOST_CHECK(fired[i] > fired[i - 1]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(cascade_wheel)
+{
+	Timer::SetBackend(TimingWheelTimerBackend);
+
+	boost::mutex mutex;
+	std::vector<double> fired(3, 0);
+	std::vector<Timer::Ptr> timers;
+
+	/* The first level of the wheel covers 2.56 seconds. These timers start
+	 * out in the second level and have to be cascaded into the first. */
+	double intervals[] = { 2.7, 3.5, 4.2 };
+
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < 3; i++) {
+		Timer::Ptr timer = new Timer();
+		timer->OnTimerExpired.connect(boost::bind(&RecordExpiry, &mutex, &fired, i));
+		timer->SetInterval(intervals[i]);
+		timer->Start();
+		timers.push_back(timer);
+	}
+
+	Utility::Sleep(4.6);
+
+	BOOST_FOREACH(const Timer::Ptr& timer, timers) {
+		timer->Stop(true);
+	}
+
+	Timer::SetBackend(OrderedTimerBackend);
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	for (int i = 0; i < 3; i++) {
+		double due = start + intervals[i];
+
+		BOOST_CHECK(fired[i] >= due - 0.05 && fired[i] <= due + 0.25);
+
+		if (i > 0)
+			BOOST_CHECK(fired[i] > fired[i - 1]);
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/applyruleindex.hpp"
+#include "config/applyrule.hpp"
+#include <boost/make_shared.hpp>
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace icinga;
+
+static Expression *MakeHostVar(const String& name)
+{
+	return new IndexerExpression(new IndexerExpression(new VariableExpression("host"),
+	    MakeLiteral("vars")), MakeLiteral(name));
+}
+
+BOOST_AUTO_TEST_SUITE(config_apply)
+
+BOOST_AUTO_TEST_CASE(predicates)
+{
+	std::set<String> variables;
+	variables.insert("host");
+
+	std::vector<ApplyRulePredicate> predicates;
+	Expression *expr;
+
+	expr = new EqualExpression(MakeHostVar("os"), MakeLiteral("Linux"));
+	BOOST_CHECK(ApplyRuleIndex::GetPredicates(expr, variables, predicates));
+	BOOST_CHECK(predicates.size() == 1);
+	BOOST_CHECK(predicates[0].Type == ApplyRulePredicateEqual);
+	BOOST_CHECK(predicates[0].Operand == "Linux");
+	delete expr;
+
+	predicates.clear();
+	expr = new LogicalAndExpression(new InExpression(MakeLiteral("linux-servers"), MakeHostVar("groups")),
+	    new LogicalNegateExpression(new EqualExpression(MakeHostVar("os"), MakeLiteral("Windows"))));
+	BOOST_CHECK(ApplyRuleIndex::GetPredicates(expr, variables, predicates));
+	BOOST_CHECK(predicates.size() == 1);
+	BOOST_CHECK(predicates[0].Type == ApplyRulePredicateContains);
+	BOOST_CHECK(predicates[0].Operand == "linux-servers");
+	delete expr;
+
+	predicates.clear();
+	expr = new LogicalOrExpression(new EqualExpression(MakeHostVar("os"), MakeLiteral("Linux")),
+	    new GreaterThanExpression(MakeHostVar("cores"), MakeLiteral(4)));
+	BOOST_CHECK(!ApplyRuleIndex::GetPredicates(expr, variables, predicates));
+	delete expr;
+
+	predicates.clear();
+	expr = new EqualExpression(new IndexerExpression(new VariableExpression("service"), MakeLiteral("name")), MakeLiteral("ping4"));
+	BOOST_CHECK(!ApplyRuleIndex::GetPredicates(expr, variables, predicates));
+	delete expr;
+
+	predicates.clear();
+	expr = new EqualExpression(MakeHostVar("os"), MakeLiteral(""));
+	BOOST_CHECK(!ApplyRuleIndex::GetPredicates(expr, variables, predicates));
+	delete expr;
+}
+
+static void AddTestRule(const String& name, Expression *filter)
+{
+	ApplyRule::AddRule("ApplyTest", "Host", name, boost::make_shared<LiteralExpression>(Empty),
+	    boost::shared_ptr<Expression>(filter), String(), String(), boost::shared_ptr<Expression>(), DebugInfo(), new Dictionary());
+}
+
+static bool HasCandidate(const std::vector<ApplyRule *>& rules, const String& name)
+{
+	BOOST_FOREACH(ApplyRule *rule, rules) {
+		if (rule->GetName() == name)
+			return true;
+	}
+
+	return false;
+}
+
+BOOST_AUTO_TEST_CASE(candidates)
+{
+	AddTestRule("linux", new EqualExpression(MakeHostVar("os"), MakeLiteral("Linux")));
+	AddTestRule("web", new InExpression(MakeLiteral("web"), MakeHostVar("roles")));
+
+	std::vector<Expression *> args;
+	args.push_back(MakeLiteral("DB*"));
+	args.push_back(new IndexerExpression(new VariableExpression("host"), MakeLiteral("name")));
+	AddTestRule("db", new FunctionCallExpression(new VariableExpression("match"), args));
+
+	AddTestRule("cores", new GreaterThanExpression(MakeHostVar("cores"), MakeLiteral(4)));
+
+	Dictionary::Ptr vars = new Dictionary();
+	vars->Set("os", "Linux");
+	Array::Ptr roles = new Array();
+	roles->Add("web");
+	vars->Set("roles", roles);
+
+	Dictionary::Ptr host = new Dictionary();
+	host->Set("name", "db01");
+	host->Set("vars", vars);
+
+	Dictionary::Ptr locals = new Dictionary();
+	locals->Set("host", host);
+
+	std::vector<ApplyRule *> rules = ApplyRule::GetCandidateRules("ApplyTest", "Host", locals);
+	BOOST_CHECK(HasCandidate(rules, "linux"));
+	BOOST_CHECK(HasCandidate(rules, "web"));
+	BOOST_CHECK(HasCandidate(rules, "db"));
+	BOOST_CHECK(HasCandidate(rules, "cores"));
+
+	vars->Set("os", "Windows");
+	vars->Remove("roles");
+	host->Set("name", "web01");
+
+	rules = ApplyRule::GetCandidateRules("ApplyTest", "Host", locals);
+	BOOST_CHECK(!HasCandidate(rules, "linux"));
+	BOOST_CHECK(!HasCandidate(rules, "web"));
+	BOOST_CHECK(!HasCandidate(rules, "db"));
+	BOOST_CHECK(HasCandidate(rules, "cores"));
+
+	ApplyRule::DiscardRules();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
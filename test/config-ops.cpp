@@ -18,8 +18,13 @@
  ******************************************************************************/
 
 #include "config/configcompiler.hpp"
+#include "config/bytecode.hpp"
+#include "config/configcache.hpp"
+#include "base/json.hpp"
 #include "base/exception.hpp"
+#include "base/utility.hpp"
 #include <boost/test/unit_test.hpp>
+#include <fstream>
 
 using namespace icinga;
 
@@ -328,4 +333,224 @@ BOOST_AUTO_TEST_CASE(advanced)
 	delete expr;
 }
 
+BOOST_AUTO_TEST_CASE(bytecode)
+{
+	const char *texts[] = {
+		"1 + 3 * 2",
+		"var v = 5; v - 2 >= 3",
+		"\"a\" in [ \"a\", \"b\" ]",
+		"\"c\" !in null",
+		"true && 0 || \"x\"",
+		"!(~5 == -6)",
+		"var x = 3; if (x > 2) { x * 2 } else { x }",
+		"var f = function(x) { return x * 2; 99 }; f(21)",
+		"var a = []; a.len()",
+		NULL
+	};
+
+	for (int i = 0; texts[i]; i++) {
+		boost::shared_ptr<Expression> expr(ConfigCompiler::CompileText("<test>", texts[i]));
+		boost::shared_ptr<Expression> code = BytecodeExpression::Compile(expr);
+		BOOST_CHECK(code != expr);
+
+		ScriptFrame frame1;
+		Value result1 = expr->Evaluate(frame1).GetValue();
+
+		ScriptFrame frame2;
+		Value result2 = code->Evaluate(frame2).GetValue();
+
+		BOOST_CHECK(JsonEncode(result1) == JsonEncode(result2));
+	}
+
+	boost::shared_ptr<Expression> expr(ConfigCompiler::CompileText("<test>", "\"c\" in \"foo\""));
+	boost::shared_ptr<Expression> code = BytecodeExpression::Compile(expr);
+	ScriptFrame frame;
+	BOOST_CHECK_THROW(code->Evaluate(frame).GetValue(), ScriptError);
+
+	/* the arguments must not be evaluated when the callee can't be called with them */
+	const char *calls[] = {
+		"var d = {}; var f = function(d) { d.called = true }; String(f(d), 2)",
+		"var d = {}; var f = function(d) { d.called = true }; var g = 3; g(f(d))",
+		NULL
+	};
+
+	for (int i = 0; calls[i]; i++) {
+		expr = boost::shared_ptr<Expression>(ConfigCompiler::CompileText("<test>", calls[i]));
+		code = BytecodeExpression::Compile(expr);
+
+		ScriptFrame frame1;
+		BOOST_CHECK_THROW(expr->Evaluate(frame1).GetValue(), ScriptError);
+		Dictionary::Ptr d1 = frame1.Locals->Get("d");
+
+		ScriptFrame frame2;
+		BOOST_CHECK_THROW(code->Evaluate(frame2).GetValue(), ScriptError);
+		Dictionary::Ptr d2 = frame2.Locals->Get("d");
+
+		BOOST_CHECK(!d1->Contains("called"));
+		BOOST_CHECK(!d2->Contains("called"));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fold)
+{
+	ScriptFrame frame;
+	Expression *expr;
+
+	expr = new AddExpression(MakeLiteral(1), new MultiplyExpression(MakeLiteral(3), MakeLiteral(2)));
+	OptimizeExpression(expr);
+	BOOST_CHECK(dynamic_cast<LiteralExpression *>(expr));
+	BOOST_CHECK(expr->Evaluate(frame).GetValue() == 7);
+	delete expr;
+
+	expr = new AddExpression(MakeLiteral("foo"), MakeLiteral("bar"));
+	OptimizeExpression(expr);
+	BOOST_CHECK(dynamic_cast<LiteralExpression *>(expr));
+	BOOST_CHECK(expr->Evaluate(frame).GetValue() == "foobar");
+	delete expr;
+
+	expr = new LogicalAndExpression(MakeLiteral(true), new VariableExpression("x"));
+	OptimizeExpression(expr);
+	BOOST_CHECK(dynamic_cast<VariableExpression *>(expr));
+	delete expr;
+
+	expr = new ConditionalExpression(new EqualExpression(MakeLiteral(1), MakeLiteral(2)), MakeLiteral("yes"), MakeLiteral("no"));
+	OptimizeExpression(expr);
+	BOOST_CHECK(dynamic_cast<LiteralExpression *>(expr));
+	BOOST_CHECK(expr->Evaluate(frame).GetValue() == "no");
+	delete expr;
+
+	std::vector<Expression *> inner;
+	inner.push_back(new SetExpression(MakeIndexer(ScopeLocal, "a"), OpSetLiteral, new SubtractExpression(MakeLiteral(5), MakeLiteral(2))));
+	inner.push_back(new VariableExpression("a"));
+	DictExpression *innerDict = new DictExpression(inner);
+	innerDict->MakeInline();
+
+	std::vector<Expression *> outer;
+	outer.push_back(new ConditionalExpression(MakeLiteral(true), innerDict, NULL));
+	DictExpression *outerDict = new DictExpression(outer);
+	outerDict->MakeInline();
+
+	expr = outerDict;
+	OptimizeExpression(expr);
+	BOOST_CHECK(expr == outerDict);
+	BOOST_CHECK(expr->Evaluate(frame).GetValue() == 3);
+	delete expr;
+
+	/* errors have to be reported when the expression is evaluated */
+	expr = new InExpression(MakeLiteral("c"), MakeLiteral("foo"));
+	OptimizeExpression(expr);
+	BOOST_CHECK(dynamic_cast<InExpression *>(expr));
+	BOOST_CHECK_THROW(expr->Evaluate(frame), ScriptError);
+	delete expr;
+}
+
+static void RemoveCacheTestFile(const String& path)
+{
+	(void) unlink(path.CStr());
+}
+
+static void RemoveCacheTestDir(const String& path)
+{
+	Utility::Glob(path + "/*", &RemoveCacheTestDir, GlobDirectory);
+	Utility::Glob(path + "/*", &RemoveCacheTestFile, GlobFile);
+	(void) rmdir(path.CStr());
+}
+
+static void WriteCacheTestFile(const String& path, const std::string& content)
+{
+	std::ofstream fp(path.CStr(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	fp << content;
+}
+
+static void AddCacheTestFile(std::vector<String> *files, const String& path)
+{
+	files->push_back(path);
+}
+
+BOOST_AUTO_TEST_CASE(cache)
+{
+	const char *tmpdir = getenv("TMPDIR");
+	String dir = String(tmpdir ? tmpdir : "/tmp") + "/icinga2-config-ops-" + Utility::NewUniqueID();
+	String cacheDir = dir + "/cache";
+
+	BOOST_REQUIRE(Utility::MkDirP(dir + "/include", 0750));
+
+	ConfigCache::SetCacheDir(cacheDir);
+
+	String text = "var f = function(x) { return x * 2 }; var a = [ 1, f(3) ]; if (a[1] > 5) { \"big\" } else { \"small\" }";
+	String key = ConfigCache::GetKey("<test>", "", text);
+
+	Expression *expr = ConfigCompiler::CompileText("<test>", text, false);
+	ConfigCache::Store("<test>", "", key, std::vector<String>(), expr);
+
+	Expression *cached = ConfigCache::Load("<test>", "", key);
+	BOOST_REQUIRE(cached);
+
+	ScriptFrame frame1;
+	BOOST_CHECK(expr->Evaluate(frame1).GetValue() == "big");
+
+	ScriptFrame frame2;
+	BOOST_CHECK(cached->Evaluate(frame2).GetValue() == "big");
+
+	delete expr;
+	delete cached;
+
+	/* the cache file is ignored once the text changes */
+	BOOST_CHECK(!ConfigCache::Load("<test>", "", ConfigCache::GetKey("<test>", "", text + "\n")));
+
+	/* truncated or corrupt cache files are rejected */
+	std::vector<String> files;
+	Utility::Glob(cacheDir + "/*.cache", boost::bind(&AddCacheTestFile, &files, _1), GlobFile);
+	BOOST_REQUIRE(files.size() == 1);
+
+	std::string data;
+
+	{
+		std::ifstream fp(files[0].CStr(), std::ifstream::in | std::ifstream::binary);
+		std::ostringstream databuf;
+		databuf << fp.rdbuf();
+		data = databuf.str();
+	}
+
+	for (size_t length = data.size() - 1; length > 0; length /= 2) {
+		WriteCacheTestFile(files[0], data.substr(0, length));
+		BOOST_CHECK(!ConfigCache::Load("<test>", "", key));
+	}
+
+	std::string corrupt = data;
+
+	for (size_t i = corrupt.size() / 2; i < corrupt.size(); i++)
+		corrupt[i] = '\xff';
+
+	WriteCacheTestFile(files[0], corrupt);
+	BOOST_CHECK(!ConfigCache::Load("<test>", "", key));
+
+	/* include directives are resolved again when the cache file is used */
+	WriteCacheTestFile(dir + "/include/a.conf", "var a = 1\n");
+
+	text = "include \"" + dir + "/include/*.conf\"";
+	key = ConfigCache::GetKey("<test>", "", text);
+
+	expr = ConfigCompiler::CompileText("<test>", text, false);
+	ConfigCache::Store("<test>", "", key, std::vector<String>(), expr);
+	delete expr;
+
+	WriteCacheTestFile(dir + "/include/b.conf", "var b = 2\n");
+
+	cached = ConfigCache::Load("<test>", "", key);
+	BOOST_REQUIRE(cached);
+
+	ScriptFrame frame3;
+	cached->Evaluate(frame3);
+	BOOST_CHECK(frame3.Locals->Get("a") == 1);
+	BOOST_CHECK(frame3.Locals->Get("b") == 2);
+
+	delete cached;
+
+	ConfigCache::SetCacheDir(String());
+
+	RemoveCacheTestDir(dir);
+	BOOST_CHECK(!Utility::PathExists(dir));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -18,14 +18,20 @@
  ******************************************************************************/
 
 #include "livestatus/livestatusquery.hpp"
+#include "livestatus/attributefilter.hpp"
+#include "livestatus/negatefilter.hpp"
+#include "livestatus/andfilter.hpp"
+#include "livestatus/orfilter.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
 #include "base/application.hpp"
 #include "base/stdiostream.hpp"
 #include "base/json.hpp"
 #include "base/loader.hpp"
+#include "base/utility.hpp"
 #include "cli/daemonutility.hpp"
 #include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
 #include <fstream>
 
 using namespace icinga;
@@ -201,6 +207,115 @@ BOOST_AUTO_TEST_CASE(services)
 
 	BOOST_MESSAGE("Done with testing livestatus services...");
 }
+
+BOOST_AUTO_TEST_CASE(services_indexed)
+{
+	BOOST_MESSAGE( "Querying Livestatus...");
+
+	std::vector<String> lines;
+	lines.push_back("GET services");
+	lines.push_back("Columns: host_name service_description");
+	lines.push_back("Filter: host_name = test-01");
+	lines.push_back("OutputFormat: json");
+	lines.push_back("\n");
+
+	/* uses the host_name index */
+	String output = LivestatusQueryHelper(lines);
+
+	Array::Ptr query_result = JsonDecode(output);
+
+	BOOST_CHECK(query_result->GetLength() == 1);
+
+	Array::Ptr res1 = query_result->Get(0);
+
+	BOOST_CHECK(res1->Contains("test-01"));
+	BOOST_CHECK(res1->Contains("livestatus"));
+
+	lines.clear();
+	lines.push_back("GET services");
+	lines.push_back("Columns: host_name service_description");
+	lines.push_back("Filter: host_name ~ ^test");
+	lines.push_back("Filter: host_name = test-02");
+	lines.push_back("Or: 2");
+	lines.push_back("OutputFormat: json");
+	lines.push_back("\n");
+
+	/* prefix lookups and Or filters use the index too */
+	output = LivestatusQueryHelper(lines);
+
+	query_result = JsonDecode(output);
+
+	BOOST_CHECK(query_result->GetLength() == 2);
+
+	BOOST_MESSAGE("Done with testing livestatus services...");
+}
+
+static Filter::Ptr ThrukServiceFilter(void)
+{
+	OrFilter::Ptr states = new OrFilter();
+	states->AddSubFilter(new AttributeFilter("state", "=", "0"));
+	states->AddSubFilter(new AttributeFilter("state", "=", "1"));
+
+	AndFilter::Ptr filter = new AndFilter();
+	filter->AddSubFilter(new AttributeFilter("host_name", "~", "^test"));
+	filter->AddSubFilter(states);
+	filter->AddSubFilter(new AttributeFilter("acknowledged", "=", "0"));
+	filter->AddSubFilter(new AttributeFilter("scheduled_downtime_depth", "=", "0"));
+	filter->AddSubFilter(new NegateFilter(new AttributeFilter("description", "~~", "^ping")));
+
+	return filter;
+}
+
+BOOST_AUTO_TEST_CASE(filter_benchmark)
+{
+	Table::Ptr table = Table::GetByName("services");
+
+	std::vector<LivestatusRowValue> rows = table->FilterRows(Filter::Ptr());
+
+	BOOST_CHECK(rows.size() == 2);
+
+	const int iterations = 20000;
+
+	/* a fresh filter has to resolve its columns and regexes on the first
+	 * row it is applied to, which is what every row used to cost */
+	std::vector<Filter::Ptr> fresh;
+	fresh.reserve(iterations * rows.size());
+
+	for (size_t i = 0; i < iterations * rows.size(); i++)
+		fresh.push_back(ThrukServiceFilter());
+
+	int uncompiledMatches = 0;
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (size_t k = 0; k < rows.size(); k++) {
+			if (fresh[i * rows.size() + k]->Apply(table, rows[k].Row))
+				uncompiledMatches++;
+		}
+	}
+
+	double uncompiled = Utility::GetTime() - start;
+
+	Filter::Ptr filter = ThrukServiceFilter();
+	filter->Compile(table);
+
+	int compiledMatches = 0;
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		BOOST_FOREACH(const LivestatusRowValue& row, rows) {
+			if (filter->Apply(table, row.Row))
+				compiledMatches++;
+		}
+	}
+
+	double compiled = Utility::GetTime() - start;
+
+	BOOST_TEST_MESSAGE(iterations * rows.size() << " filter evaluations: per-row lookups " << uncompiled << "s, compiled " << compiled << "s");
+
+	BOOST_CHECK(compiledMatches == iterations * 2);
+	BOOST_CHECK(uncompiledMatches == compiledMatches);
+}
 //____________________________________________________________________________//
 
 BOOST_AUTO_TEST_SUITE_END()
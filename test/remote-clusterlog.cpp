@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2015 Icinga Development Team (http://www.icinga.org)    *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/clusterlog.hpp"
+#include "base/netstring.hpp"
+#include "base/stdiostream.hpp"
+#include "base/json.hpp"
+#include "base/convert.hpp"
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace icinga;
+
+static String l_ClusterLogPath = "remote-clusterlog.test";
+
+static void WriteClusterLog(bool compress)
+{
+	(void) unlink(l_ClusterLogPath.CStr());
+	(void) unlink(ClusterLogWriter::GetIndexPath(l_ClusterLogPath).CStr());
+
+	ClusterLogWriter::Ptr writer = new ClusterLogWriter(l_ClusterLogPath, compress);
+	BOOST_REQUIRE(writer->IsGood());
+
+	for (int i = 1; i <= 1000; i++)
+		writer->WriteMessage(i, "Host", "host" + Convert::ToString(i), boost::make_shared<String>("{\"id\":" + Convert::ToString(i) + "}"));
+
+	BOOST_CHECK(writer->GetMessageCount() == 1000);
+
+	writer->Close();
+}
+
+static void CheckClusterLog(double ts)
+{
+	ClusterLogReader::Ptr reader = new ClusterLogReader(l_ClusterLogPath);
+	reader->Seek(ts);
+
+	ClusterLogMessage message;
+	int count = 0;
+	double last = 0;
+
+	while (reader->ReadMessage(&message)) {
+		BOOST_CHECK(message.Timestamp == last + 1 || last == 0);
+		BOOST_CHECK(message.SecobjType == "Host");
+		BOOST_CHECK(message.SecobjName == "host" + Convert::ToString(message.Timestamp));
+		BOOST_CHECK(*message.Message == "{\"id\":" + Convert::ToString(message.Timestamp) + "}");
+
+		last = message.Timestamp;
+		count++;
+	}
+
+	BOOST_CHECK(last == 1000);
+
+	/* The reader must not skip any messages newer than ts. */
+	BOOST_CHECK(count >= 1000 - ts);
+
+	(void) unlink(l_ClusterLogPath.CStr());
+	(void) unlink(ClusterLogWriter::GetIndexPath(l_ClusterLogPath).CStr());
+}
+
+BOOST_AUTO_TEST_SUITE(remote_clusterlog)
+
+BOOST_AUTO_TEST_CASE(readwrite)
+{
+	WriteClusterLog(false);
+	CheckClusterLog(0);
+}
+
+BOOST_AUTO_TEST_CASE(seek)
+{
+	WriteClusterLog(false);
+
+	ClusterLogReader::Ptr reader = new ClusterLogReader(l_ClusterLogPath);
+	reader->Seek(800.5);
+
+	ClusterLogMessage message;
+	BOOST_REQUIRE(reader->ReadMessage(&message));
+	BOOST_CHECK(message.Timestamp > 512 && message.Timestamp <= 801);
+
+	CheckClusterLog(800.5);
+}
+
+BOOST_AUTO_TEST_CASE(compression)
+{
+	WriteClusterLog(true);
+	CheckClusterLog(300);
+}
+
+BOOST_AUTO_TEST_CASE(legacy)
+{
+	std::fstream *fp = new std::fstream(l_ClusterLogPath.CStr(), std::fstream::out | std::fstream::trunc);
+	StdioStream::Ptr stream = new StdioStream(fp, true);
+
+	for (int i = 1; i <= 1000; i++) {
+		Dictionary::Ptr secname = new Dictionary();
+		secname->Set("type", "Host");
+		secname->Set("name", "host" + Convert::ToString(i));
+
+		Dictionary::Ptr pmessage = new Dictionary();
+		pmessage->Set("timestamp", i);
+		pmessage->Set("message", "{\"id\":" + Convert::ToString(i) + "}");
+		pmessage->Set("secobj", secname);
+
+		NetString::WriteStringToStream(stream, JsonEncode(pmessage));
+	}
+
+	stream->Close();
+
+	CheckClusterLog(0);
+}
+
+BOOST_AUTO_TEST_CASE(cache)
+{
+	WriteClusterLog(false);
+
+	ClusterLogCache cache(1024 * 1024);
+
+	ClusterLogCache::Segment segment = cache.GetSegment(l_ClusterLogPath, 1);
+	BOOST_CHECK(segment->size() == 1000);
+	BOOST_CHECK(cache.GetSegment(l_ClusterLogPath, 1) == segment);
+	BOOST_CHECK(cache.FindSegment(1) == segment);
+	BOOST_CHECK(!cache.FindSegment(2));
+
+	/* Partial reads skip older messages and aren't cached. */
+	segment = ClusterLogCache::ReadSegment(l_ClusterLogPath, 800.5);
+	BOOST_REQUIRE(segment->size() == 200);
+	BOOST_CHECK((*segment)[0].Timestamp == 801);
+
+	/* The segment is larger than the cache, so older entries get evicted. */
+	ClusterLogCache smallCache(1);
+
+	segment = smallCache.GetSegment(l_ClusterLogPath, 1);
+	smallCache.GetSegment(l_ClusterLogPath, 2);
+	BOOST_CHECK(smallCache.GetSegment(l_ClusterLogPath, 1) != segment);
+}
+
+BOOST_AUTO_TEST_SUITE_END()